@@ -0,0 +1,293 @@
+#include "AESNI.h"
+#include <string.h>
+
+#ifdef SAES_X86
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+#if defined(SAES_X86) && defined(__GNUC__)
+#define AESNI_TARGET __attribute__((target("aes,ssse3")))
+#else
+#define AESNI_TARGET
+#endif
+
+// SAES keeps its state row-major, AES-NI column-major; this index map transposes one 4x4 block
+static const byte transposeIndex[SAES_BLOCK_BYTES] = { 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15 };
+
+// as transposeIndex, for a register holding the nonce in bytes 0-7 and a little-endian counter in bytes 8-15
+static const byte counterTransposeIndex[SAES_BLOCK_BYTES] = { 0, 4, 15, 11, 1, 5, 14, 10, 2, 6, 13, 9, 3, 7, 12, 8 };
+
+// constructor
+AESNI::AESNI() : numRounds(0) {
+
+	memset(roundKeys, 0, SAES_MAX_ROUND_KEY_BYTES);
+
+}
+
+/**
+Check whether the CPU supports AES-NI.
+
+@return True if AESENC/AESENCLAST and PSHUFB are available.
+*/
+bool AESNI::isSupported() {
+
+	return CPUFeatures::hasAESNI();
+
+}
+
+/**
+Load key schedule from SAES::keyExpansion() round keys, transposed into AES-NI column-major layout.
+
+@param expandedKey (IN) Round keys, 16 bytes per round.
+@param _numRounds (IN) Number of rounds, {10, 12, 14}.
+*/
+void AESNI::loadRoundKeys(const byte* expandedKey, const int _numRounds) {
+
+	numRounds = _numRounds;
+
+	// transpose each round key
+	for (int round = 0; round <= numRounds; round++)
+		for (int i = 0; i < SAES_BLOCK_BYTES; i++)
+			roundKeys[round * SAES_BLOCK_BYTES + i] = expandedKey[round * SAES_BLOCK_BYTES + transposeIndex[i]];
+
+}
+
+#ifdef SAES_X86
+
+/*
+sbox differs from the standard AES s-box at index 0x01 (0x7f instead of 0x7c). Sub bytes is the only non-linear
+step, so the hardware round is corrected by xoring in the linear image of the 0x03 difference for every state byte
+equal to 0x01. The difference d is pushed through the hardware round by encrypting invSBox(d) with a zero key;
+invSBox(0x00) = 0x52 and invSBox(0x03) = 0xd5.
+*/
+#define AESNI_SBOX_QUIRK_INDEX 0x01
+#define AESNI_INV_SBOX_ZERO 0x52
+#define AESNI_INV_SBOX_DELTA (0x52 ^ 0xd5)
+
+AESNI_TARGET static inline __m128i quirkDelta(const __m128i state) {
+	__m128i mask = _mm_cmpeq_epi8(state, _mm_set1_epi8(AESNI_SBOX_QUIRK_INDEX));
+	return _mm_xor_si128(_mm_set1_epi8(AESNI_INV_SBOX_ZERO), _mm_and_si128(mask, _mm_set1_epi8((char)AESNI_INV_SBOX_DELTA)));
+}
+
+AESNI_TARGET static inline __m128i encRound(const __m128i state, const __m128i roundKey) {
+	return _mm_xor_si128(_mm_aesenc_si128(state, roundKey), _mm_aesenc_si128(quirkDelta(state), _mm_setzero_si128()));
+}
+
+AESNI_TARGET static inline __m128i encLastRound(const __m128i state, const __m128i roundKey) {
+	return _mm_xor_si128(_mm_aesenclast_si128(state, roundKey), _mm_aesenclast_si128(quirkDelta(state), _mm_setzero_si128()));
+}
+
+AESNI_TARGET static inline void encryptPipeline(__m128i* state, const __m128i* keys, const int numRounds) {
+	int round, i;
+
+	for (i = 0; i < SAES_PIPELINE_BLOCKS; i++)
+		state[i] = _mm_xor_si128(state[i], keys[0]);
+
+	for (round = 1; round < numRounds; round++)
+		for (i = 0; i < SAES_PIPELINE_BLOCKS; i++)
+			state[i] = encRound(state[i], keys[round]);
+
+	for (i = 0; i < SAES_PIPELINE_BLOCKS; i++)
+		state[i] = encLastRound(state[i], keys[numRounds]);
+}
+
+AESNI_TARGET static inline __m128i encryptSingle(__m128i state, const __m128i* keys, const int numRounds) {
+	state = _mm_xor_si128(state, keys[0]);
+
+	for (int round = 1; round < numRounds; round++)
+		state = encRound(state, keys[round]);
+
+	return encLastRound(state, keys[numRounds]);
+}
+
+/**
+Encrypt blocks with AES-NI, SAES_PIPELINE_BLOCKS at a time to keep the AES unit pipeline full.
+
+@param plaintextBlocks (IN) Blocks to encrypt.
+@param cipherBlocks (OUT) Encrypted blocks.
+@param numBlocks (IN) Number of 16-byte blocks.
+*/
+AESNI_TARGET void AESNI::encryptBlocks(const byte* plaintextBlocks, byte* cipherBlocks, const _saes64 numBlocks) const {
+
+	__m128i keys[SAES_MAX_ROUND_KEY_BYTES / SAES_BLOCK_BYTES];
+	__m128i transpose = _mm_loadu_si128((const __m128i*)transposeIndex);
+	_saes64 block = 0;
+	int i;
+
+	// load key schedule
+	for (i = 0; i <= numRounds; i++)
+		keys[i] = _mm_load_si128((const __m128i*)(roundKeys + i * SAES_BLOCK_BYTES));
+
+	// pipelined blocks
+	for (; block + SAES_PIPELINE_BLOCKS <= numBlocks; block += SAES_PIPELINE_BLOCKS) {
+
+		__m128i state[SAES_PIPELINE_BLOCKS];
+
+		for (i = 0; i < SAES_PIPELINE_BLOCKS; i++)
+			state[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(plaintextBlocks + (block + i) * SAES_BLOCK_BYTES)), transpose);
+
+		encryptPipeline(state, keys, numRounds);
+
+		for (i = 0; i < SAES_PIPELINE_BLOCKS; i++)
+			_mm_storeu_si128((__m128i*)(cipherBlocks + (block + i) * SAES_BLOCK_BYTES), _mm_shuffle_epi8(state[i], transpose));
+
+	}
+
+	// remaining blocks
+	for (; block < numBlocks; block++) {
+
+		__m128i state = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(plaintextBlocks + block * SAES_BLOCK_BYTES)), transpose);
+		_mm_storeu_si128((__m128i*)(cipherBlocks + block * SAES_BLOCK_BYTES), _mm_shuffle_epi8(encryptSingle(state, keys, numRounds), transpose));
+
+	}
+
+}
+
+/**
+Generate CTR keystream with AES-NI. The counter is kept little-endian in the high half of a register and byte-swapped
+into SAES::concatNonceCounter() order by the same shuffle that transposes the block.
+
+@param nonce (IN) Nonce, SAES_NONCE_SIZE_BYTES.
+@param startCounter (IN) Counter of first block.
+@param numBlocks (IN) Number of 16-byte keystream blocks.
+@param keystream (OUT) Buffer receiving keystream.
+*/
+AESNI_TARGET void AESNI::generateKeystream(const byte* nonce, const _saes64 startCounter, const _saes64 numBlocks, byte* keystream) const {
+
+	__m128i keys[SAES_MAX_ROUND_KEY_BYTES / SAES_BLOCK_BYTES];
+	__m128i transpose = _mm_loadu_si128((const __m128i*)transposeIndex);
+	__m128i counterShuffle = _mm_loadu_si128((const __m128i*)counterTransposeIndex);
+	__m128i one = _mm_set_epi64x(1, 0);
+	__m128i counter;
+	long long nonceWord;
+	_saes64 block = 0;
+	int i;
+
+	// load key schedule
+	for (i = 0; i <= numRounds; i++)
+		keys[i] = _mm_load_si128((const __m128i*)(roundKeys + i * SAES_BLOCK_BYTES));
+
+	// nonce in low half, counter in high half
+	memcpy(&nonceWord, nonce, SAES_NONCE_SIZE_BYTES);
+	counter = _mm_set_epi64x((long long)startCounter, nonceWord);
+
+	// pipelined blocks
+	for (; block + SAES_PIPELINE_BLOCKS <= numBlocks; block += SAES_PIPELINE_BLOCKS) {
+
+		__m128i state[SAES_PIPELINE_BLOCKS];
+
+		for (i = 0; i < SAES_PIPELINE_BLOCKS; i++) {
+			state[i] = _mm_shuffle_epi8(counter, counterShuffle);
+			counter = _mm_add_epi64(counter, one);
+		}
+
+		encryptPipeline(state, keys, numRounds);
+
+		for (i = 0; i < SAES_PIPELINE_BLOCKS; i++)
+			_mm_storeu_si128((__m128i*)(keystream + (block + i) * SAES_BLOCK_BYTES), _mm_shuffle_epi8(state[i], transpose));
+
+	}
+
+	// remaining blocks
+	for (; block < numBlocks; block++) {
+
+		__m128i state = encryptSingle(_mm_shuffle_epi8(counter, counterShuffle), keys, numRounds);
+		_mm_storeu_si128((__m128i*)(keystream + block * SAES_BLOCK_BYTES), _mm_shuffle_epi8(state, transpose));
+		counter = _mm_add_epi64(counter, one);
+
+	}
+
+}
+
+/**
+Encrypt/decrypt data in CTR mode with AES-NI. Keystream is XORed into the data while still in registers.
+
+@param nonce (IN) Nonce, SAES_NONCE_SIZE_BYTES.
+@param startCounter (IN) Counter of the block at in[0].
+@param in (IN) Data to XOR with keystream.
+@param out (OUT) Result, may be the same buffer as in.
+@param len (IN) Bytes of data, need not be a multiple of SAES_BLOCK_BYTES.
+*/
+AESNI_TARGET void AESNI::applyKeystream(const byte* nonce, const _saes64 startCounter, const byte* in, byte* out, const _saes64 len) const {
+
+	__m128i keys[SAES_MAX_ROUND_KEY_BYTES / SAES_BLOCK_BYTES];
+	__m128i transpose = _mm_loadu_si128((const __m128i*)transposeIndex);
+	__m128i counterShuffle = _mm_loadu_si128((const __m128i*)counterTransposeIndex);
+	__m128i one = _mm_set_epi64x(1, 0);
+	__m128i counter;
+	long long nonceWord;
+	_saes64 numFullBlocks = len / SAES_BLOCK_BYTES;
+	_saes64 block = 0;
+	int i;
+
+	// load key schedule
+	for (i = 0; i <= numRounds; i++)
+		keys[i] = _mm_load_si128((const __m128i*)(roundKeys + i * SAES_BLOCK_BYTES));
+
+	// nonce in low half, counter in high half
+	memcpy(&nonceWord, nonce, SAES_NONCE_SIZE_BYTES);
+	counter = _mm_set_epi64x((long long)startCounter, nonceWord);
+
+	// pipelined blocks
+	for (; block + SAES_PIPELINE_BLOCKS <= numFullBlocks; block += SAES_PIPELINE_BLOCKS) {
+
+		__m128i state[SAES_PIPELINE_BLOCKS];
+
+		for (i = 0; i < SAES_PIPELINE_BLOCKS; i++) {
+			state[i] = _mm_shuffle_epi8(counter, counterShuffle);
+			counter = _mm_add_epi64(counter, one);
+		}
+
+		encryptPipeline(state, keys, numRounds);
+
+		for (i = 0; i < SAES_PIPELINE_BLOCKS; i++) {
+			_saes64 offset = (block + i) * SAES_BLOCK_BYTES;
+			__m128i blockData = _mm_loadu_si128((const __m128i*)(in + offset));
+			_mm_storeu_si128((__m128i*)(out + offset), _mm_xor_si128(blockData, _mm_shuffle_epi8(state[i], transpose)));
+		}
+
+	}
+
+	// remaining full blocks
+	for (; block < numFullBlocks; block++) {
+
+		__m128i blockData = _mm_loadu_si128((const __m128i*)(in + block * SAES_BLOCK_BYTES));
+		__m128i state = encryptSingle(_mm_shuffle_epi8(counter, counterShuffle), keys, numRounds);
+		_mm_storeu_si128((__m128i*)(out + block * SAES_BLOCK_BYTES), _mm_xor_si128(blockData, _mm_shuffle_epi8(state, transpose)));
+		counter = _mm_add_epi64(counter, one);
+
+	}
+
+	// partial last block
+	if (len % SAES_BLOCK_BYTES) {
+
+		byte keystream[SAES_BLOCK_BYTES];
+		__m128i state = encryptSingle(_mm_shuffle_epi8(counter, counterShuffle), keys, numRounds);
+		_mm_storeu_si128((__m128i*)keystream, _mm_shuffle_epi8(state, transpose));
+		for (_saes64 index = numFullBlocks * SAES_BLOCK_BYTES; index < len; index++)
+			out[index] = in[index] ^ keystream[index % SAES_BLOCK_BYTES];
+
+	}
+
+}
+
+#else
+
+/**
+Encrypt blocks with AES-NI. Unavailable on this architecture; isSupported() always returns false.
+*/
+void AESNI::encryptBlocks(const byte* plaintextBlocks, byte* cipherBlocks, const _saes64 numBlocks) const {}
+
+/**
+Generate CTR keystream with AES-NI. Unavailable on this architecture; isSupported() always returns false.
+*/
+void AESNI::generateKeystream(const byte* nonce, const _saes64 startCounter, const _saes64 numBlocks, byte* keystream) const {}
+
+/**
+Encrypt/decrypt data in CTR mode with AES-NI. Unavailable on this architecture; isSupported() always returns false.
+*/
+void AESNI::applyKeystream(const byte* nonce, const _saes64 startCounter, const byte* in, byte* out, const _saes64 len) const {}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef AESNI_H
+#define AESNI_H
+
+#ifdef __linux__
+#include <inttypes.h>
+#endif
+#include "SAESconstants.h"
+#include "CPUFeatures.h"
+
+// AES-NI hardware backend
+class AESNI {
+
+public:
+
+	// constructor
+	AESNI();
+
+	// check cpu support
+	static bool isSupported();
+
+	// load key schedule
+	void loadRoundKeys(const byte*, const int);
+
+	// encryption
+	void encryptBlocks(const byte*, byte*, const _saes64) const;
+	void generateKeystream(const byte*, const _saes64, const _saes64, byte*) const;
+	void applyKeystream(const byte*, const _saes64, const byte*, byte*, const _saes64) const;
+
+private:
+
+	int numRounds;
+	alignas(16) byte roundKeys[SAES_MAX_ROUND_KEY_BYTES];
+
+};
+
+#endif
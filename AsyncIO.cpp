@@ -0,0 +1,425 @@
+#include "AsyncIO.h"
+#include "FileIO.h"
+#include <string.h>
+
+#ifdef SAES_IO_URING
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// constructor
+AsyncIO::AsyncIO(const unsigned int numSlots) :
+	requests(numSlots),
+	ioUringEnabled(false),
+	stopping(false)
+{
+
+	// idle slots
+	for (Request& request : requests)
+		request = {};
+
+	// prefer io_uring, fall back to read-ahead/write-behind threads
+	if (setupRing(numSlots))
+		ioUringEnabled = true;
+	else {
+		ioThreads.push_back(std::thread(&AsyncIO::ioThreadLoop, this, false));
+		ioThreads.push_back(std::thread(&AsyncIO::ioThreadLoop, this, true));
+	}
+
+}
+
+// destructor
+AsyncIO::~AsyncIO() {
+
+	// finish requests still in flight, buffers may be freed after this
+	drain();
+
+	// stop threads
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		stopping = true;
+	}
+	requestQueued.notify_all();
+	for (std::thread& ioThread : ioThreads)
+		ioThread.join();
+
+	closeRing();
+
+}
+
+/**
+Queue read into buffer. The slot must be idle.
+
+@param slot (IN) Slot index.
+@param fd (IN) File descriptor.
+@param buffer (OUT) Buffer receiving data, must stay valid until wait().
+@param len (IN) Bytes to read.
+@param offset (IN) File offset.
+*/
+void AsyncIO::submitRead(const unsigned int slot, const int fd, byte* buffer, const _saes64 len, const _saes64 offset) {
+	submit(slot, false, fd, buffer, len, offset);
+}
+
+/**
+Queue write of buffer. The slot must be idle.
+
+@param slot (IN) Slot index.
+@param fd (IN) File descriptor.
+@param buffer (IN) Data to write, must stay valid until wait().
+@param len (IN) Bytes to write.
+@param offset (IN) File offset.
+*/
+void AsyncIO::submitWrite(const unsigned int slot, const int fd, const byte* buffer, const _saes64 len, const _saes64 offset) {
+	submit(slot, true, fd, (byte*)buffer, len, offset);
+}
+
+/**
+Wait for slot request to finish. Returns at once if the slot is idle.
+
+@param slot (IN) Slot index.
+
+@return Bytes transferred, less than requested only for a read reaching end of file.
+
+@throw Throws FileException() if request failed.
+*/
+_saes64 AsyncIO::wait(const unsigned int slot) {
+
+	Request& request = requests[slot];
+
+	// io_uring
+	if (ioUringEnabled) {
+		while (request.pending)
+			reapCompletions(true);
+	}
+	// threads
+	else {
+		std::unique_lock<std::mutex> guard(stateLock);
+		requestDone.wait(guard, [&request]() { return !request.pending; });
+	}
+
+	// report result once
+	if (request.failed) {
+		request.failed = false;
+		if (request.isWrite)
+			throw FileException("Failed to write file. Exiting program.\n");
+		throw FileException("Failed to read file. Exiting program.\n");
+	}
+
+	return request.done;
+
+}
+
+/**
+Wait for the requests of all slots, dropping their errors. Afterwards every slot is idle and its buffer may be freed;
+used to unwind after a failure.
+*/
+void AsyncIO::drain() {
+
+	for (unsigned int slot = 0; slot < requests.size(); slot++) {
+		try {
+			wait(slot);
+		}
+		catch (FileException&) {}
+	}
+
+}
+
+/**
+Check backend in use.
+
+@return True if requests go through io_uring, false if through I/O threads.
+*/
+bool AsyncIO::usingIOUring() const {
+	return ioUringEnabled;
+}
+
+/**
+Queue request on slot.
+
+@param slot (IN) Slot index.
+@param isWrite (IN) True for write, false for read.
+@param fd (IN) File descriptor.
+@param buffer (IN/OUT) Request buffer.
+@param len (IN) Bytes to transfer.
+@param offset (IN) File offset.
+*/
+void AsyncIO::submit(const unsigned int slot, const bool isWrite, const int fd, byte* buffer, const _saes64 len, const _saes64 offset) {
+
+	Request& request = requests[slot];
+
+	// io_uring
+	if (ioUringEnabled) {
+		request = { true, isWrite, false, fd, buffer, len, offset, 0 };
+		pushRequest(slot);
+		return;
+	}
+
+	// threads
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		request = { true, isWrite, false, fd, buffer, len, offset, 0 };
+		if (isWrite)
+			writeQueue.push_back(slot);
+		else
+			readQueue.push_back(slot);
+	}
+	requestQueued.notify_all();
+
+}
+
+/**
+I/O thread body, serves reads or writes in submission order.
+
+@param isWriter (IN) True to serve writes, false to serve reads.
+*/
+void AsyncIO::ioThreadLoop(const bool isWriter) {
+
+	std::deque<unsigned int>& queue = isWriter ? writeQueue : readQueue;
+
+	while (true) {
+
+		unsigned int slot;
+		Request request;
+		bool failed = false;
+		_saes64 done = 0;
+
+		// take next request
+		{
+			std::unique_lock<std::mutex> guard(stateLock);
+			requestQueued.wait(guard, [this, &queue]() { return stopping || !queue.empty(); });
+			if (queue.empty())
+				return;
+			slot = queue.front();
+			queue.pop_front();
+			request = requests[slot];
+		}
+
+		// transfer
+		try {
+			if (isWriter) {
+				FileIO::writeAt(request.fd, request.buffer, request.len, request.offset);
+				done = request.len;
+			}
+			else
+				done = FileIO::readAt(request.fd, request.buffer, request.len, request.offset);
+		}
+		catch (FileException&) {
+			failed = true;
+		}
+
+		// mark done
+		{
+			std::lock_guard<std::mutex> guard(stateLock);
+			requests[slot].done = done;
+			requests[slot].failed = failed;
+			requests[slot].pending = false;
+		}
+		requestDone.notify_all();
+
+	}
+
+}
+
+#ifdef SAES_IO_URING
+
+/**
+Create io_uring instance and map its rings.
+
+@param numEntries (IN) Submission queue entries, one per slot.
+
+@return True if io_uring is usable, false if the kernel refused it.
+*/
+bool AsyncIO::setupRing(const unsigned int numEntries) {
+
+	struct io_uring_params params;
+	byte* sqBase;
+	byte* cqBase;
+
+	ringFd = -1;
+	sqRing = cqRing = sqEntries = MAP_FAILED;
+	iovecs.resize(requests.size());
+
+	// create ring
+	memset(&params, 0, sizeof(params));
+	ringFd = (int)syscall(__NR_io_uring_setup, numEntries, &params);
+	if (ringFd < 0)
+		return false;
+
+	// map submission and completion rings, shared in one mapping on newer kernels
+	sqRingSize = params.sq_off.array + (params.sq_entries * sizeof(unsigned int));
+	cqRingSize = params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		sqRingSize = cqRingSize = (sqRingSize > cqRingSize) ? sqRingSize : cqRingSize;
+	sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+	if (sqRing == MAP_FAILED) {
+		closeRing();
+		return false;
+	}
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		cqRing = sqRing;
+	else {
+		cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+		if (cqRing == MAP_FAILED) {
+			closeRing();
+			return false;
+		}
+	}
+
+	// map submission entries
+	sqEntriesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	sqEntries = mmap(nullptr, sqEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+	if (sqEntries == MAP_FAILED) {
+		closeRing();
+		return false;
+	}
+
+	// ring fields
+	sqBase = (byte*)sqRing;
+	cqBase = (byte*)cqRing;
+	sqHead = (unsigned int*)(sqBase + params.sq_off.head);
+	sqTail = (unsigned int*)(sqBase + params.sq_off.tail);
+	sqMask = (unsigned int*)(sqBase + params.sq_off.ring_mask);
+	sqArray = (unsigned int*)(sqBase + params.sq_off.array);
+	cqHead = (unsigned int*)(cqBase + params.cq_off.head);
+	cqTail = (unsigned int*)(cqBase + params.cq_off.tail);
+	cqMask = (unsigned int*)(cqBase + params.cq_off.ring_mask);
+	cqEntries = cqBase + params.cq_off.cqes;
+
+	return true;
+
+}
+
+/**
+Unmap rings and close io_uring instance.
+*/
+void AsyncIO::closeRing() {
+
+	if (sqEntries != MAP_FAILED)
+		munmap(sqEntries, sqEntriesSize);
+	if ((cqRing != MAP_FAILED) && (cqRing != sqRing))
+		munmap(cqRing, cqRingSize);
+	if (sqRing != MAP_FAILED)
+		munmap(sqRing, sqRingSize);
+	if (ringFd >= 0)
+		close(ringFd);
+	sqRing = cqRing = sqEntries = MAP_FAILED;
+	ringFd = -1;
+
+}
+
+/**
+Submit the remaining part of a slot request to the kernel.
+
+@param slot (IN) Slot index.
+
+@throw Throws FileException() if the kernel rejected the submission.
+*/
+void AsyncIO::pushRequest(const unsigned int slot) {
+
+	Request& request = requests[slot];
+	unsigned int tail = *sqTail;
+	unsigned int index = tail & *sqMask;
+	struct io_uring_sqe* entry = (struct io_uring_sqe*)sqEntries + index;
+
+	// describe transfer, resuming after any partial completion
+	iovecs[slot].iov_base = request.buffer + request.done;
+	iovecs[slot].iov_len = (size_t)(request.len - request.done);
+	memset(entry, 0, sizeof(*entry));
+	entry->opcode = request.isWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+	entry->fd = request.fd;
+	entry->addr = (unsigned long long)&iovecs[slot];
+	entry->len = 1;
+	entry->off = request.offset + request.done;
+	entry->user_data = slot;
+
+	// publish entry and submit
+	sqArray[index] = index;
+	__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+	while (syscall(__NR_io_uring_enter, ringFd, 1, 0, 0, nullptr, 0) < 0) {
+		if (errno != EINTR) {
+			request.pending = false;
+			request.failed = true;
+			return;
+		}
+	}
+
+}
+
+/**
+Process completed requests, resubmitting short transfers.
+
+@param block (IN) True to sleep until at least one completion arrives.
+*/
+void AsyncIO::reapCompletions(const bool block) {
+
+	unsigned int head = *cqHead;
+	unsigned int tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+	// sleep for a completion
+	if ((head == tail) && block) {
+		if ((syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0) && (errno != EINTR))
+			throw FileException("Failed to wait for file I/O. Exiting program.\n");
+		tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+	}
+
+	// handle completions
+	for (; head != tail; head++) {
+
+		struct io_uring_cqe* completion = (struct io_uring_cqe*)cqEntries + (head & *cqMask);
+		Request& request = requests[completion->user_data];
+		int result = completion->res;
+
+		if ((result == -EINTR) || (result == -EAGAIN))
+			result = 0;
+		else if (result < 0) {
+			request.pending = false;
+			request.failed = true;
+			continue;
+		}
+		else if (result == 0) {
+			// end of file on a read, a write that makes no progress would resubmit forever
+			request.pending = false;
+			request.failed = request.isWrite;
+			continue;
+		}
+
+		// advance, resubmit remainder of short transfer
+		request.done += result;
+		if (request.done >= request.len)
+			request.pending = false;
+		else
+			pushRequest((unsigned int)completion->user_data);
+
+	}
+	__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+}
+
+#else
+
+/**
+Create io_uring instance. Unavailable on this platform; requests go through I/O threads.
+*/
+bool AsyncIO::setupRing(const unsigned int numEntries) {
+	return false;
+}
+
+/**
+Close io_uring instance. Unavailable on this platform.
+*/
+void AsyncIO::closeRing() {}
+
+/**
+Submit request to io_uring. Unavailable on this platform.
+*/
+void AsyncIO::pushRequest(const unsigned int slot) {}
+
+/**
+Process io_uring completions. Unavailable on this platform.
+*/
+void AsyncIO::reapCompletions(const bool block) {}
+
+#endif
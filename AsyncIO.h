@@ -0,0 +1,114 @@
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+#ifdef __linux__
+#include <inttypes.h>
+#endif
+#include "SAESconstants.h"
+#include "Exceptions.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// io_uring is used where the kernel headers provide it, define SAES_DISABLE_IO_URING to build without it
+#if defined(__linux__) && !defined(SAES_DISABLE_IO_URING)
+#if __has_include(<linux/io_uring.h>)
+#define SAES_IO_URING
+#endif
+#endif
+
+#ifdef SAES_IO_URING
+#include <sys/uio.h>
+#endif
+
+// asynchronous positional file I/O over a fixed set of slots, each slot holding at most one request in flight.
+// Backed by io_uring when the kernel supports it, otherwise by a reader thread and a writer thread.
+class AsyncIO {
+
+public:
+
+	// constructor
+	AsyncIO(const unsigned int);
+
+	// destructor
+	~AsyncIO();
+
+	// queue request on slot
+	void submitRead(const unsigned int, const int, byte*, const _saes64, const _saes64);
+	void submitWrite(const unsigned int, const int, const byte*, const _saes64, const _saes64);
+
+	// wait for slot request
+	_saes64 wait(const unsigned int);
+	void drain();
+
+	// backend
+	bool usingIOUring() const;
+
+private:
+
+	// request held by a slot
+	struct Request {
+		bool pending;
+		bool isWrite;
+		bool failed;
+		int fd;
+		byte* buffer;
+		_saes64 len;
+		_saes64 offset;
+		_saes64 done;
+	};
+
+	// not copyable, owns threads and ring
+	AsyncIO(const AsyncIO&);
+	AsyncIO& operator=(const AsyncIO&);
+
+	// queue request
+	void submit(const unsigned int, const bool, const int, byte*, const _saes64, const _saes64);
+
+	// thread backend
+	void ioThreadLoop(const bool);
+
+	// io_uring backend
+	bool setupRing(const unsigned int);
+	void closeRing();
+	void pushRequest(const unsigned int);
+	void reapCompletions(const bool);
+
+	std::vector<Request> requests;
+	bool ioUringEnabled;
+
+	// thread backend state
+	std::mutex stateLock;
+	std::condition_variable requestQueued;
+	std::condition_variable requestDone;
+	std::deque<unsigned int> readQueue;
+	std::deque<unsigned int> writeQueue;
+	std::vector<std::thread> ioThreads;
+	bool stopping;
+
+#ifdef SAES_IO_URING
+	// io_uring ring state
+	int ringFd;
+	void* sqRing;
+	void* cqRing;
+	void* sqEntries;
+	size_t sqRingSize;
+	size_t cqRingSize;
+	size_t sqEntriesSize;
+	unsigned int* sqHead;
+	unsigned int* sqTail;
+	unsigned int* sqMask;
+	unsigned int* sqArray;
+	unsigned int* cqHead;
+	unsigned int* cqTail;
+	unsigned int* cqMask;
+	void* cqEntries;
+	std::vector<struct iovec> iovecs;
+#endif
+
+};
+
+#endif
@@ -0,0 +1,514 @@
+#include "BatchScheduler.h"
+#include "SAESStream.h"
+#include "FileIO.h"
+#include "CTimer.h"
+#include <algorithm>
+
+// constructor
+BatchScheduler::BatchScheduler(ThreadPool& _pool, const OPCODE _status, byte* _password, const int _iKeylength, const int _formatVersion, const byte _authFlag, const bool _verbose) :
+	pool(_pool),
+	status(_status),
+	password(_password),
+	iKeylength(_iKeylength),
+	formatVersion(_formatVersion),
+	authFlag(_authFlag),
+	verbose(_verbose),
+	elapsedTime(0),
+	numDone(0),
+	numFailed(0),
+	bytesDone(0)
+{
+
+	// nonce and key schedules are shared by every file
+	SAES::calculateNonce(nonce, password);
+
+}
+
+/**
+Run all files on the pool. Failing files are skipped, and reported if verbose.
+
+@param numFiles (IN) Number of files.
+@param files (IN) File names.
+*/
+void BatchScheduler::run(const int numFiles, const byte(*files)[SAES_MAX_FILENAME_BUFFER_SIZE]) {
+
+	CTimer timer = {};
+
+	timer.start();
+
+	// hand out files in fixed groups, groups yield their tail back to the pool as they go
+	for (int first = 0; first < numFiles; first += SAES_BATCH_TASK_FILES) {
+		int last = std::min(first + SAES_BATCH_TASK_FILES, numFiles);
+		pool.submit([this, files, first, last]() { runFiles(files, first, last); });
+	}
+	pool.wait();
+
+	elapsedTime = timer.end();
+
+}
+
+/**
+Get number of files that failed.
+
+@return Files reported and skipped.
+*/
+unsigned int BatchScheduler::getNumFailed() const {
+	return numFailed.load();
+}
+
+/**
+Print aggregate throughput of the last run.
+*/
+void BatchScheduler::printSummary() const {
+
+	double seconds = std::max((double)elapsedTime, 1.0) / 1000.0;
+	double megabytes = (double)bytesDone.load() / (1024 * 1024);
+
+	printf("Batch completed: %u files, %u failed, %.1f MB in %zu ms, %.1f MB/s, %.1f files/s \n",
+		numDone.load(), numFailed.load(), megabytes, elapsedTime, megabytes / seconds, (double)numDone.load() / seconds);
+
+}
+
+/**
+Print that a file was skipped. The batch goes on, so the exit notice is dropped from the message.
+
+@param filename (IN) Name of file.
+@param error (IN) Error message.
+*/
+void BatchScheduler::printSkipped(const char* filename, const char* error) {
+
+	const char* suffix = strstr(error, " Exiting program.");
+
+	printf("Skipping '%s': %.*s\n", filename, suffix ? (int)(suffix - error) : (int)strcspn(error, "\n"), error);
+
+}
+
+/**
+Batch task, runs files [first, last) until SAES_BATCH_TASK_BYTES are done, then requeues the rest.
+
+@param files (IN) File names.
+@param first (IN) First file of task.
+@param last (IN) End of task files.
+*/
+void BatchScheduler::runFiles(const byte(*files)[SAES_MAX_FILENAME_BUFFER_SIZE], const int first, const int last) {
+
+	_saes64 bytes = 0;
+
+	for (int i = first; i < last; i++) {
+
+		bytes += runFile((const char*)files[i]);
+
+		// let idle workers steal the rest
+		if ((bytes >= SAES_BATCH_TASK_BYTES) && (i + 1 < last)) {
+			int next = i + 1;
+			pool.submit([this, files, next, last]() { runFiles(files, next, last); });
+			return;
+		}
+
+	}
+
+}
+
+/**
+Run one file, whole on this worker if small, else split into chunk tasks.
+
+@param filename (IN) Name of file.
+
+@return Bytes ciphered on this worker.
+*/
+_saes64 BatchScheduler::runFile(const char* filename) {
+
+	std::shared_ptr<FileJob> job = std::make_shared<FileJob>();
+
+	memcpy(job->filename, filename, strlen(filename) + 1);
+	job->newFilename[0] = 0x00;
+	memset(job->filenameFormat, 0, sizeof(job->filenameFormat));
+	job->saes = nullptr;
+	job->inFd = job->outFd = -1;
+	job->paddingLen = 0;
+	job->inputFilesize = job->bodySize = job->cipherSize = 0;
+	job->chunked = false;
+	job->chunksLeft = 0;
+	job->failed = false;
+
+	try {
+		// framed files decrypt front to back
+		if (openJob(*job)) {
+			SAESStream::decrypt(*job->saes, nonce, job->inFd, job->outFd);
+			job->bodySize = job->inputFilesize;
+		}
+		// large file, finished by its last chunk
+		else if (job->bodySize >= SAES_BATCH_SPLIT_SIZE) {
+			splitFile(job);
+			return 0;
+		}
+		else
+			cipherWholeFile(*job);
+	}
+	catch (FileException& e) {
+		reportFailure(*job, e.getError());
+	}
+
+	finishJob(*job);
+
+	return job->bodySize;
+
+}
+
+/**
+Open input, read SAES header data if decrypting, and create output.
+
+@param job (IN/OUT) File job.
+
+@return True if input is a framed stream file, positioned at its first frame.
+
+@throw Throws FileException() if a file could not be opened or the input is not an SAES file.
+*/
+bool BatchScheduler::openJob(FileJob& job) {
+
+	bool framed = false;
+
+	job.inFd = FileIO::openFile(job.filename, FILECODE::FILE_INPUT);
+	job.inputFilesize = FileIO::getFileSize(job.inFd);
+
+	if (status == OPCODE::ENCRYPTION) {
+		SAES::setNewFilename((byte*)job.filename, (byte*)job.newFilename, job.filenameFormat);
+		SAES::setNewFilesize(job.inputFilesize, job.paddingLen, job.bodySize);
+		job.saes = &getCipher(iKeylength);
+
+		// version 2 chunks are not padded
+		if (formatVersion == SAES_FORMAT_VERSION_2) {
+			job.chunked = true;
+			job.index = SAESChunkIndex(job.inputFilesize, SAES_CHUNK_SIZE);
+			job.paddingLen = 0;
+			job.bodySize = job.inputFilesize;
+		}
+		job.cipherSize = job.bodySize;
+
+		// salt and headers are fixed before the body, the tag or checksums follow it
+		if ((authFlag != 0) && !job.chunked) {
+			byte padding[SAES_MAX_PADDING_BYTES] = { 0x00 };
+			byte keylength[SAES_MAX_KEYLENGTH_BYTES] = { 0x00 };
+			padding[2] = authFlag;
+			if (authFlag & SAES_HEADER_FLAG_AUTH)
+				SAESAuth::generateSalt(job.authBlocks);
+			SAES::writeHeaders(job.authBlocks + SAESAuth::getAuthBytes(padding), padding, job.paddingLen, job.filenameFormat, keylength, iKeylength);
+			job.auth = std::unique_ptr<SAESAuth>(new SAESAuth(*job.saes, status, job.authBlocks, job.authBlocks + SAESAuth::getAuthBytes(padding)));
+		}
+	}
+	else {
+		byte streamHeader[SAES_STREAM_HEADER_BYTES] = { 0x00 };
+		byte padding[SAES_MAX_PADDING_BYTES] = { 0x00 };
+		byte keylength[SAES_MAX_KEYLENGTH_BYTES] = { 0x00 };
+		int fileKeylength = -1;
+
+		// framed header in front, else trailing headers
+		if ((job.inputFilesize >= SAES_STREAM_HEADER_BYTES) && (FileIO::readStream(job.inFd, streamHeader, SAES_STREAM_HEADER_BYTES) == SAES_STREAM_HEADER_BYTES))
+			framed = SAESStream::readHeader(streamHeader, fileKeylength, job.filenameFormat);
+		if (!framed) {
+			job.bodySize = SAES::extractFileSAESHeader(job.inFd, padding, job.filenameFormat, keylength);
+			fileKeylength = (keylength[1] << 8) | (keylength[0] << 0);
+			job.chunked = SAESChunkIndex::isChunked(padding);
+			if (job.chunked)
+				job.index.read(job.inFd, job.inputFilesize, padding);
+		}
+		job.saes = &getCipher(fileKeylength);
+		job.cipherSize = job.bodySize;
+
+		// authenticated or checksummed body is hashed with its padding
+		if (!framed && SAESAuth::hasAuthBlocks(padding)) {
+			_saes64 authLen = SAESAuth::getAuthBytes(padding) + (SAES_HEADERS * SAES_BLOCK_BYTES);
+			if (FileIO::readAt(job.inFd, job.authBlocks, authLen, job.inputFilesize - authLen) != authLen)
+				throw FileException("Error reading SAES header padding. Exiting program.\n");
+			job.auth = std::unique_ptr<SAESAuth>(new SAESAuth(*job.saes, status, job.authBlocks, job.authBlocks + SAESAuth::getAuthBytes(padding)));
+			job.cipherSize = job.bodySize + padding[0];
+		}
+
+		// set output filename
+		SAES::setDecryptedFilename((const byte*)job.filename, (byte*)job.newFilename, job.filenameFormat);
+	}
+
+	job.outFd = FileIO::openFile(job.newFilename, FILECODE::FILE_OUTPUT);
+
+	return framed;
+
+}
+
+/**
+Cipher a small file in one read and one write.
+
+@param job (IN/OUT) File job.
+
+@throw Throws FileException() if read or write fails.
+*/
+void BatchScheduler::cipherWholeFile(FileJob& job) {
+
+	// file buffer allocated once per worker thread, grown to the largest file seen
+	static thread_local std::unique_ptr<byte[]> fileBuffer = nullptr;
+	static thread_local _saes64 fileBufferSize = 0;
+	_saes64 writeLen = job.bodySize + ((status == OPCODE::ENCRYPTION) ? getTrailerSize(job) : 0);
+	_saes64 bufferLen = std::max(writeLen, job.cipherSize);
+	_saes64 readLen;
+
+	if (bufferLen > fileBufferSize) {
+		fileBuffer = std::unique_ptr<byte[]>(new byte[bufferLen]);
+		fileBufferSize = bufferLen;
+	}
+
+	// read body, zero padding past end of input; compressed chunks make the input smaller than its plaintext
+	readLen = readBody(job, fileBuffer.get(), readsPlaintext(job) ? job.cipherSize : std::min(job.inputFilesize, job.cipherSize), 0);
+	memset(fileBuffer.get() + readLen, 0, (size_t)(job.cipherSize - readLen));
+
+	// cipher in place, checking the tag before anything is written
+	if (job.auth) {
+		job.auth->applyKeystream(nonce, 0, fileBuffer.get(), fileBuffer.get(), job.cipherSize);
+		if (status == OPCODE::DECRYPTION)
+			job.auth->verifyTag(job.authBlocks);
+	}
+	else if (!readsPlaintext(job))
+		job.saes->applyKeystream(nonce, 0, fileBuffer.get(), job.cipherSize);
+
+	// append SAES headers, version 2 with the checksums of its chunks
+	if (status == OPCODE::ENCRYPTION) {
+		if (job.chunked)
+			job.index.updateChecksums(0, fileBuffer.get(), job.bodySize);
+		storeTrailer(job, fileBuffer.get() + job.bodySize);
+	}
+
+	FileIO::writeAt(job.outFd, fileBuffer.get(), writeLen, 0);
+
+}
+
+/**
+Queue chunk tasks of a large file. The last chunk to finish joins the chunk hash states, writes the SAES headers or
+checks the tag, and finishes the file.
+
+@param job (IN) File job, kept alive by its chunk tasks.
+*/
+void BatchScheduler::splitFile(std::shared_ptr<FileJob> job) {
+
+	_saes64 numChunks = (job->cipherSize + SAES_PARALLEL_CHUNK_SIZE - 1) / SAES_PARALLEL_CHUNK_SIZE;
+
+	job->chunksLeft = numChunks;
+	if (job->auth) {
+		job->chunkStates = std::unique_ptr<byte[]>(new byte[numChunks * SAES_BLOCK_BYTES]);
+		memset(job->chunkStates.get(), 0, (size_t)(numChunks * SAES_BLOCK_BYTES));
+	}
+
+	for (_saes64 offset = 0; offset < job->cipherSize; offset += SAES_PARALLEL_CHUNK_SIZE) {
+
+		pool.submit([this, job, offset]() {
+
+			cipherChunk(*job, offset);
+			if (--job->chunksLeft != 0)
+				return;
+
+			// last chunk, append SAES headers or check tag
+			if (!job->failed) {
+				try {
+					if (job->auth) {
+						for (_saes64 chunk = 0; chunk < job->cipherSize; chunk += SAES_PARALLEL_CHUNK_SIZE)
+							job->auth->append(job->chunkStates.get() + ((chunk / SAES_PARALLEL_CHUNK_SIZE) * SAES_BLOCK_BYTES), std::min((_saes64)SAES_PARALLEL_CHUNK_SIZE, job->cipherSize - chunk));
+						if (status == OPCODE::DECRYPTION)
+							job->auth->verifyTag(job->authBlocks);
+					}
+					if (readsPlaintext(*job))
+						FileIO::setFileSize(job->outFd, job->bodySize);
+					if (status == OPCODE::ENCRYPTION) {
+						std::unique_ptr<byte[]> trailer = std::unique_ptr<byte[]>(new byte[getTrailerSize(*job)]);
+						storeTrailer(*job, trailer.get());
+						FileIO::writeAt(job->outFd, trailer.get(), getTrailerSize(*job), job->bodySize);
+					}
+				}
+				catch (FileException& e) {
+					reportFailure(*job, e.getError());
+				}
+			}
+			finishJob(*job);
+
+		});
+
+	}
+
+}
+
+/**
+Cipher one chunk of a split file at its own offset.
+
+@param job (IN/OUT) File job.
+@param offset (IN) Body offset of chunk.
+*/
+void BatchScheduler::cipherChunk(FileJob& job, const _saes64 offset) {
+
+	// chunk buffer allocated once per worker thread
+	static thread_local std::unique_ptr<byte[]> chunkBuffer = std::unique_ptr<byte[]>(new byte[SAES_PARALLEL_CHUNK_SIZE]);
+	_saes64 chunkLen = std::min((_saes64)SAES_PARALLEL_CHUNK_SIZE, job.cipherSize - offset);
+	_saes64 writeLen = (offset < job.bodySize) ? std::min(chunkLen, job.bodySize - offset) : 0;
+	_saes64 readLen;
+
+	// another chunk already failed
+	if (job.failed)
+		return;
+
+	try {
+		// holes of version 2 input stay holes, the last chunk sizes the output
+		if (readsPlaintext(job) && job.index.isHole(offset, chunkLen))
+			return;
+
+		// read chunk, zero padding past end of input
+		readLen = std::min(readBody(job, chunkBuffer.get(), chunkLen, offset), chunkLen);
+		memset(chunkBuffer.get() + readLen, 0, (size_t)(chunkLen - readLen));
+
+		// cipher and write chunk at its offset, padding of a checked file is hashed but not written
+		if (job.auth)
+			job.auth->applyKeystream(nonce, offset / SAES_BLOCK_BYTES, chunkBuffer.get(), chunkBuffer.get(), chunkLen, job.chunkStates.get() + ((offset / SAES_PARALLEL_CHUNK_SIZE) * SAES_BLOCK_BYTES));
+		else if (!readsPlaintext(job))
+			job.saes->applyKeystream(nonce, offset / SAES_BLOCK_BYTES, chunkBuffer.get(), chunkLen);
+		if ((status == OPCODE::ENCRYPTION) && job.chunked)
+			job.index.updateChecksums(offset, chunkBuffer.get(), writeLen);
+		if (writeLen)
+			FileIO::writeAt(job.outFd, chunkBuffer.get(), writeLen, offset);
+	}
+	catch (FileException& e) {
+		reportFailure(job, e.getError());
+	}
+
+}
+
+/**
+Read input body bytes. Version 2 input is decrypted through its chunk index, see readsPlaintext().
+
+@param job (IN/OUT) File job.
+@param buffer (OUT) Buffer of len bytes.
+@param len (IN) Bytes to read.
+@param offset (IN) Body offset.
+
+@return Bytes read, short at end of input.
+
+@throw Throws FileException() if read fails.
+*/
+_saes64 BatchScheduler::readBody(FileJob& job, byte* buffer, const _saes64 len, const _saes64 offset) {
+
+	if ((status == OPCODE::DECRYPTION) && job.chunked) {
+		job.index.decryptRange(job.inFd, *job.saes, nonce, offset, buffer, len);
+		return len;
+	}
+
+	return FileIO::readAt(job.inFd, buffer, len, offset);
+
+}
+
+/**
+Check whether readBody() returns plaintext, as it does for version 2 input whose chunks may be compressed.
+
+@param job (IN) File job.
+
+@return True if the body needs no further ciphering.
+*/
+bool BatchScheduler::readsPlaintext(const FileJob& job) const {
+	return (status == OPCODE::DECRYPTION) && job.chunked;
+}
+
+/**
+Get size of data following an encrypted body.
+
+@param job (IN) File job.
+
+@return Bytes of chunk index or salt, tag or checksum blocks, if any, and SAES headers.
+*/
+_saes64 BatchScheduler::getTrailerSize(const FileJob& job) const {
+	return (job.chunked ? job.index.getIndexBytes() : 0) + (job.auth ? job.auth->getAuthBytes() : 0) + (SAES_HEADERS * SAES_BLOCK_BYTES);
+}
+
+/**
+Build data following an encrypted body: chunk index for version 2, or salt and tag blocks or a checksum block, then SAES
+headers.
+
+@param job (IN) File job, its body already ciphered.
+@param trailer (OUT) Buffer of getTrailerSize() bytes.
+*/
+void BatchScheduler::storeTrailer(const FileJob& job, byte* trailer) const {
+
+	byte padding[SAES_MAX_PADDING_BYTES] = { 0x00 };
+	byte keylength[SAES_MAX_KEYLENGTH_BYTES] = { 0x00 };
+
+	// headers were written with the salt
+	if (job.auth) {
+		memcpy(trailer, job.authBlocks, (size_t)getTrailerSize(job));
+		job.auth->storeTag(trailer);
+		return;
+	}
+
+	if (job.chunked) {
+		job.index.write(trailer);
+		job.index.storeTrailer(padding);
+	}
+	SAES::writeHeaders(trailer + getTrailerSize(job) - (SAES_HEADERS * SAES_BLOCK_BYTES), padding, job.paddingLen, job.filenameFormat, keylength, iKeylength);
+
+}
+
+/**
+Close files. A finished file replaces its input; a failed one has its partial output removed.
+
+@param job (IN/OUT) File job.
+*/
+void BatchScheduler::finishJob(FileJob& job) {
+
+	if (job.inFd >= 0)
+		FileIO::closeFile(job.inFd);
+	if (job.outFd >= 0)
+		FileIO::closeFile(job.outFd);
+
+	if (job.failed) {
+		if (job.outFd >= 0)
+			SAES::deleteFile(job.newFilename);
+		numFailed++;
+	}
+	else {
+		SAES::deleteFile(job.filename);
+		bytesDone += job.bodySize;
+		numDone++;
+	}
+	job.inFd = job.outFd = -1;
+
+}
+
+/**
+Report first failure of a file and mark it failed. The batch goes on.
+
+@param job (IN/OUT) File job.
+@param error (IN) Error message.
+*/
+void BatchScheduler::reportFailure(FileJob& job, const char* error) {
+
+	if (job.failed.exchange(true))
+		return;
+
+	if (verbose)
+		printSkipped(job.filename, error);
+
+}
+
+/**
+Get cipher context for a key length, building its key schedule on first use.
+
+@param keylength (IN) Key size in integer form.
+
+@return Cipher context shared by all workers.
+
+@throw Throws FileException() if key length is not 128, 192 or 256.
+*/
+const SAES& BatchScheduler::getCipher(const int keylength) {
+
+	std::lock_guard<std::mutex> guard(cipherLock);
+
+	if ((keylength != SAES_KEY_SIZE_128) && (keylength != SAES_KEY_SIZE_192) && (keylength != SAES_KEY_SIZE_256))
+		throw FileException("Unsupported SAES key length. Exiting program.\n");
+
+	std::unique_ptr<SAES>& cipher = ciphers[keylength];
+	if (!cipher)
+		cipher = std::unique_ptr<SAES>(new SAES(keylength, password));
+
+	return *cipher;
+
+}
@@ -0,0 +1,101 @@
+#ifndef BATCHSCHEDULER_H
+#define BATCHSCHEDULER_H
+
+#ifdef __linux__
+#include <inttypes.h>
+#endif
+#include "SAESconstants.h"
+#include "Exceptions.h"
+#include "SAES.h"
+#include "SAESChunkIndex.h"
+#include "SAESAuth.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// runs a file list concurrently on a thread pool.
+// Files are handed out in tasks of SAES_BATCH_TASK_FILES; a task yields the rest of its files back to the pool once it has
+// done SAES_BATCH_TASK_BYTES, and a file of SAES_BATCH_SPLIT_SIZE or more is split into chunks that compete for the same workers.
+// A failing file is reported and skipped, its partial output removed and its input kept. Chunks of an authenticated or
+// checksummed file hash into states of their own, joined in order by the last chunk.
+class BatchScheduler {
+
+public:
+
+	// constructor
+	BatchScheduler(ThreadPool&, const OPCODE, byte*, const int, const int, const byte, const bool);
+
+	// run all files
+	void run(const int, const byte(*)[SAES_MAX_FILENAME_BUFFER_SIZE]);
+
+	// results
+	unsigned int getNumFailed() const;
+	void printSummary() const;
+	static void printSkipped(const char*, const char*);
+
+private:
+
+	// state of one file
+	struct FileJob {
+		char filename[SAES_MAX_FILENAME_BUFFER_SIZE];
+		char newFilename[SAES_MAX_FILENAME_BUFFER_SIZE];
+		byte filenameFormat[SAES_MAX_FILENAME_BUFFER_SIZE];
+		const SAES* saes;
+		int inFd;
+		int outFd;
+		int paddingLen;
+		_saes64 inputFilesize;
+		_saes64 bodySize;
+		_saes64 cipherSize;
+		bool chunked;
+		SAESChunkIndex index;
+		std::unique_ptr<SAESAuth> auth;
+		byte authBlocks[(SAES_AUTH_BLOCKS + SAES_HEADERS) * SAES_BLOCK_BYTES];
+		std::unique_ptr<byte[]> chunkStates;
+		std::atomic<_saes64> chunksLeft;
+		std::atomic<bool> failed;
+	};
+
+	// not copyable
+	BatchScheduler(const BatchScheduler&);
+	BatchScheduler& operator=(const BatchScheduler&);
+
+	// tasks
+	void runFiles(const byte(*)[SAES_MAX_FILENAME_BUFFER_SIZE], const int, const int);
+	_saes64 runFile(const char*);
+
+	// file stages
+	bool openJob(FileJob&);
+	void cipherWholeFile(FileJob&);
+	void splitFile(std::shared_ptr<FileJob>);
+	void cipherChunk(FileJob&, const _saes64);
+	_saes64 readBody(FileJob&, byte*, const _saes64, const _saes64);
+	bool readsPlaintext(const FileJob&) const;
+	_saes64 getTrailerSize(const FileJob&) const;
+	void storeTrailer(const FileJob&, byte*) const;
+	void finishJob(FileJob&);
+	void reportFailure(FileJob&, const char*);
+
+	// cipher context per key length
+	const SAES& getCipher(const int);
+
+	ThreadPool& pool;
+	OPCODE status;
+	byte* password;
+	int iKeylength;
+	int formatVersion;
+	byte authFlag;
+	bool verbose;
+	size_t elapsedTime;
+	byte nonce[SAES_NONCE_SIZE_BYTES];
+	std::mutex cipherLock;
+	std::map<int, std::unique_ptr<SAES>> ciphers;
+	std::atomic<unsigned int> numDone;
+	std::atomic<unsigned int> numFailed;
+	std::atomic<_saes64> bytesDone;
+
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "CPUFeatures.h"
+
+#ifdef SAES_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// cpuid leaf 1 ecx feature bits
+#define CPUID_1_ECX_PCLMUL (1 << 1)
+#define CPUID_1_ECX_SSSE3 (1 << 9)
+#define CPUID_1_ECX_SSE42 (1 << 20)
+#define CPUID_1_ECX_AES (1 << 25)
+#define CPUID_1_ECX_OSXSAVE (1 << 27)
+#define CPUID_1_ECX_AVX (1 << 28)
+
+// cpuid leaf 7 ebx feature bits
+#define CPUID_7_EBX_AVX2 (1 << 5)
+
+// xgetbv XCR0 bits for SSE and AVX register state
+#define XCR0_SSE_AVX_STATE 0x6
+
+#ifdef SAES_X86
+
+// run cpuid for leaf/subleaf
+static void cpuid(const unsigned int leaf, const unsigned int subleaf, unsigned int* regs) {
+
+#ifdef _MSC_VER
+	int info[4];
+	__cpuidex(info, (int)leaf, (int)subleaf);
+	for (int i = 0; i < 4; i++)
+		regs[i] = (unsigned int)info[i];
+#else
+	if (!__get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3]))
+		regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#endif
+
+}
+
+// read XCR0
+static unsigned long long xgetbv0() {
+
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((unsigned long long)edx << 32) | eax;
+#endif
+
+}
+
+#endif
+
+// constructor
+CPUFeatures::CPUFeatures() : aesni(false), avx2(false), pclmul(false), sse42(false) {
+
+#ifdef SAES_X86
+	unsigned int regs[4];
+	unsigned int maxLeaf, leaf1Ecx;
+
+	// highest leaf
+	cpuid(0, 0, regs);
+	maxLeaf = regs[0];
+	if (maxLeaf < 1)
+		return;
+
+	// leaf 1
+	cpuid(1, 0, regs);
+	leaf1Ecx = regs[2];
+	aesni = ((leaf1Ecx & CPUID_1_ECX_AES) != 0) && ((leaf1Ecx & CPUID_1_ECX_SSSE3) != 0);
+	pclmul = ((leaf1Ecx & CPUID_1_ECX_PCLMUL) != 0) && ((leaf1Ecx & CPUID_1_ECX_SSSE3) != 0);
+	sse42 = (leaf1Ecx & CPUID_1_ECX_SSE42) != 0;
+
+	// leaf 7, only if OS saves AVX state
+	if ((maxLeaf >= 7) && (leaf1Ecx & CPUID_1_ECX_OSXSAVE) && (leaf1Ecx & CPUID_1_ECX_AVX) && ((xgetbv0() & XCR0_SSE_AVX_STATE) == XCR0_SSE_AVX_STATE)) {
+		cpuid(7, 0, regs);
+		avx2 = (regs[1] & CPUID_7_EBX_AVX2) != 0;
+	}
+#endif
+
+}
+
+/**
+Get probed features, running CPUID on first use.
+
+@return Feature set of this CPU.
+*/
+const CPUFeatures& CPUFeatures::get() {
+
+	static const CPUFeatures features;
+	return features;
+
+}
+
+/**
+Check for AES-NI.
+
+@return True if AESENC/AESENCLAST and PSHUFB are available.
+*/
+bool CPUFeatures::hasAESNI() {
+	return get().aesni;
+}
+
+/**
+Check for AVX2.
+
+@return True if AVX2 instructions and YMM state are available.
+*/
+bool CPUFeatures::hasAVX2() {
+	return get().avx2;
+}
+
+/**
+Check for PCLMULQDQ.
+
+@return True if carry-less multiply and PSHUFB are available.
+*/
+bool CPUFeatures::hasPCLMUL() {
+	return get().pclmul;
+}
+
+/**
+Check for SSE4.2.
+
+@return True if the CRC32 instruction is available.
+*/
+bool CPUFeatures::hasSSE42() {
+	return get().sse42;
+}
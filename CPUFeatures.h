@@ -0,0 +1,40 @@
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SAES_X86
+#endif
+
+// runtime CPU feature detection, probed once via CPUID
+class CPUFeatures {
+
+public:
+
+	// AES-NI and SSSE3
+	static bool hasAESNI();
+
+	// AVX2 with OS support for YMM state
+	static bool hasAVX2();
+
+	// PCLMULQDQ and SSSE3
+	static bool hasPCLMUL();
+
+	// SSE4.2 CRC32
+	static bool hasSSE42();
+
+private:
+
+	// constructor
+	CPUFeatures();
+
+	// probe once
+	static const CPUFeatures& get();
+
+	bool aesni;
+	bool avx2;
+	bool pclmul;
+	bool sse42;
+
+};
+
+#endif
@@ -0,0 +1,224 @@
+#include "CRC32C.h"
+#include <string.h>
+
+#ifdef SAES_X86
+#include <nmmintrin.h>
+#endif
+
+#if defined(SAES_X86) && defined(__GNUC__)
+#define CRC32C_TARGET __attribute__((target("sse4.2")))
+#else
+#define CRC32C_TARGET
+#endif
+
+// Castagnoli polynomial, bit-reflected
+#define CRC32C_POLY 0x82F63B78
+
+// load little-endian 64-bit word
+static uint64_t loadLE(const byte* in) {
+
+	uint64_t value = 0;
+	for (int i = 7; i >= 0; i--)
+		value = (value << 8) | in[i];
+	return value;
+
+}
+
+// constructor
+CRC32C::CRC32C() : sse42Enabled(CPUFeatures::hasSSE42()) {
+
+	// one byte at a time
+	for (uint32_t n = 0; n < 256; n++) {
+		uint32_t crc = n;
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+		table[0][n] = crc;
+	}
+
+	// byte n followed by k zero bytes
+	for (int k = 1; k < 8; k++)
+		for (uint32_t n = 0; n < 256; n++)
+			table[k][n] = (table[k - 1][n] >> 8) ^ table[0][table[k - 1][n] & 0xFF];
+
+	// x^(2^i) mod P, starting from x
+	powers[0] = 1u << 30;
+	for (int i = 1; i < CRC32C_POWERS; i++)
+		powers[i] = multiply(powers[i - 1], powers[i - 1]);
+
+}
+
+/**
+Get tables, building them on first use.
+
+@return Shared tables.
+*/
+const CRC32C& CRC32C::get() {
+
+	static const CRC32C tables;
+	return tables;
+
+}
+
+/**
+Check whether the CPU has the CRC32 instruction.
+
+@return True if SSE4.2 is available.
+*/
+bool CRC32C::isSupported() {
+
+	return CPUFeatures::hasSSE42();
+
+}
+
+/**
+Continue a checksum over more data.
+
+@param crc (IN) Checksum of the data so far, 0 to start.
+@param data (IN) Data.
+@param len (IN) Bytes of data.
+
+@return Checksum of the data so far followed by data.
+*/
+uint32_t CRC32C::update(const uint32_t crc, const byte* data, const _saes64 len) {
+
+	const CRC32C& tables = get();
+
+	if (tables.sse42Enabled)
+		return hardwareUpdate(crc, data, len);
+	return tables.tableUpdate(crc, data, len);
+
+}
+
+/**
+Join checksums of two consecutive pieces: crc1 * x^(8 * len2) + crc2 modulo the polynomial.
+
+@param crc1 (IN) Checksum of the first piece.
+@param crc2 (IN) Checksum of the second piece, started from 0.
+@param len2 (IN) Bytes of the second piece.
+
+@return Checksum of both pieces.
+*/
+uint32_t CRC32C::combine(const uint32_t crc1, const uint32_t crc2, const _saes64 len2) {
+
+	return multiply(get().shift(len2), crc1) ^ crc2;
+
+}
+
+/**
+Continue a checksum with slicing-by-8, 8 table lookups per 8 bytes.
+
+@param crc (IN) Checksum so far.
+@param data (IN) Data.
+@param len (IN) Bytes of data.
+
+@return Checksum.
+*/
+uint32_t CRC32C::tableUpdate(uint32_t crc, const byte* data, _saes64 len) const {
+
+	crc = ~crc;
+
+	for (; len >= 8; data += 8, len -= 8) {
+		uint64_t word = loadLE(data) ^ crc;
+		crc = table[7][word & 0xFF] ^ table[6][(word >> 8) & 0xFF] ^ table[5][(word >> 16) & 0xFF] ^ table[4][(word >> 24) & 0xFF] ^
+			table[3][(word >> 32) & 0xFF] ^ table[2][(word >> 40) & 0xFF] ^ table[1][(word >> 48) & 0xFF] ^ table[0][word >> 56];
+	}
+	for (; len > 0; data++, len--)
+		crc = (crc >> 8) ^ table[0][(crc ^ *data) & 0xFF];
+
+	return ~crc;
+
+}
+
+#ifdef SAES_X86
+
+/**
+Continue a checksum with the SSE4.2 CRC32 instruction.
+
+@param crc (IN) Checksum so far.
+@param data (IN) Data.
+@param len (IN) Bytes of data.
+
+@return Checksum.
+*/
+CRC32C_TARGET uint32_t CRC32C::hardwareUpdate(uint32_t crc, const byte* data, _saes64 len) {
+
+	crc = ~crc;
+
+#if defined(__x86_64__) || defined(_M_X64)
+	uint64_t crc64 = crc;
+	for (; len >= 8; data += 8, len -= 8) {
+		uint64_t word;
+		memcpy(&word, data, 8);
+		crc64 = _mm_crc32_u64(crc64, word);
+	}
+	crc = (uint32_t)crc64;
+#endif
+	for (; len >= 4; data += 4, len -= 4) {
+		uint32_t word;
+		memcpy(&word, data, 4);
+		crc = _mm_crc32_u32(crc, word);
+	}
+	for (; len > 0; data++, len--)
+		crc = _mm_crc32_u8(crc, *data);
+
+	return ~crc;
+
+}
+
+#else
+
+/**
+Continue a checksum with the SSE4.2 CRC32 instruction. Unavailable on this architecture; isSupported() always returns
+false.
+*/
+uint32_t CRC32C::hardwareUpdate(uint32_t crc, const byte* data, _saes64 len) { return crc; }
+
+#endif
+
+/**
+Multiply two polynomials modulo the CRC polynomial, bit-reflected.
+
+@param a (IN) First factor, not 0.
+@param b (IN) Second factor.
+
+@return Product.
+*/
+uint32_t CRC32C::multiply(uint32_t a, uint32_t b) {
+
+	uint32_t mask = 1u << 31;
+	uint32_t product = 0;
+
+	for (;;) {
+		if (a & mask) {
+			product ^= b;
+			if ((a & (mask - 1)) == 0)
+				break;
+		}
+		mask >>= 1;
+		b = (b & 1) ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+	}
+
+	return product;
+
+}
+
+/**
+Get x^(8 * len) modulo the CRC polynomial, the factor that moves a checksum past len zero bytes.
+
+@param len (IN) Bytes.
+
+@return Shift factor.
+*/
+uint32_t CRC32C::shift(const _saes64 len) const {
+
+	uint32_t result = 1u << 31;
+	_saes64 n = len;
+
+	// x^8 = x^(2^3), so bit i of len selects x^(2^(i + 3))
+	for (int i = 3; n != 0; n >>= 1, i++)
+		if (n & 1)
+			result = multiply(powers[i], result);
+
+	return result;
+
+}
@@ -0,0 +1,50 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#ifdef __linux__
+#include <inttypes.h>
+#endif
+#include "SAESconstants.h"
+#include "CPUFeatures.h"
+#include <stdint.h>
+
+// x^(2^i) for every bit of a 64-bit length in bytes, shifted up by the 3 bits of a byte
+#define CRC32C_POWERS (64 + 3)
+
+// CRC32C (Castagnoli) checksum.
+// SSE4.2 CRC32 consumes 8 bytes per instruction; CPUs without it use slicing-by-8 tables. Checksums of consecutive
+// pieces hashed on different threads are joined with combine(), so each piece starts from 0.
+class CRC32C {
+
+public:
+
+	// check cpu support
+	static bool isSupported();
+
+	// checksum
+	static uint32_t update(const uint32_t, const byte*, const _saes64);
+	static uint32_t combine(const uint32_t, const uint32_t, const _saes64);
+
+private:
+
+	// constructor
+	CRC32C();
+
+	// tables built once
+	static const CRC32C& get();
+
+	// backends
+	static uint32_t hardwareUpdate(uint32_t, const byte*, _saes64);
+	uint32_t tableUpdate(uint32_t, const byte*, _saes64) const;
+
+	// polynomial arithmetic
+	static uint32_t multiply(uint32_t, uint32_t);
+	uint32_t shift(const _saes64) const;
+
+	uint32_t table[8][256];
+	uint32_t powers[CRC32C_POWERS];
+	bool sse42Enabled;
+
+};
+
+#endif
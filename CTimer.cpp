@@ -1,7 +1,8 @@
 #include "CTimer.h"
+#include <stdio.h>
 
 // constructor
-CTimer::CTimer() : startPoint({}), endPoint({}), elapsedTime(0) {}
+CTimer::CTimer() : startPoint(), endPoint(), elapsedTime(0) {}
 
 // start timer
 void CTimer::start() {
@@ -46,6 +47,14 @@ size_t CTimer::getElapsedTime() {
 void CTimer::printTime() {
 
 	// print
-	printf("Timer completed in %d ms \n", getElapsedTime());
+	printf("Timer completed in %zu ms \n", getElapsedTime());
+
+}
+
+// print time with run description
+void CTimer::printTime(const char* description) {
+
+	// print
+	printf("Timer completed in %zu ms (%s) \n", getElapsedTime(), description);
 
 }
\ No newline at end of file
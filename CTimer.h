@@ -24,6 +24,7 @@ public:
 
 	// print time
 	void printTime();
+	void printTime(const char*);
 
 private:
 
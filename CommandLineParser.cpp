@@ -8,7 +8,8 @@ bool CommandLineParser::parseArguments(
 	byte* password,
 	int& iKeylength,
 	int& numFiles,
-	std::unique_ptr<byte[][SAES_MAX_FILENAME_BUFFER_SIZE]>& files) {
+	std::unique_ptr<byte[][SAES_MAX_FILENAME_BUFFER_SIZE]>& files,
+	CommandLineOptions& options) {
 
 	bool forceCPU = false;
 
@@ -18,7 +19,7 @@ bool CommandLineParser::parseArguments(
 
 	/* Help command */
 	if ((argv[1][0] == '-') && (argv[1][1] == 'h') && (argv[1][2] == 'e') && (argv[1][3] == 'l') && (argv[1][4] == 'p')) {
-		printf("Format structure:\nOperation type: -{e,d}\nPassword: -p password\nKey size(Required only if encryption): -k {128, 192, 256}\nFiles: -f files\nExample: -e -b 64 -p loop -k 128 -f *.*\n");
+		printf("Format structure:\nOperation type: -{e,d}\nPassword: -p password\nKey size(Required only if encryption): -k {128, 192, 256}\nThreads(Optional, 0 = all cores): -t threads\nBuffer size in KB(Optional, power of 2 in [64, 65536]): -b size\nMemory map files(Optional): -m\nPage cache bypass(Optional, not with -m): -c {direct, dropbehind}\nFile format version(Optional, encryption only, 2 = chunked): -v {1, 2}\nAuthenticate(Optional, encryption only, version 1): -a\nIntegrity checksum(Optional, encryption only, version 1, not with -a): -i\nCompression(Optional, encryption only, version 2): -z\nIncremental update of changed chunks, keeping input(Optional, encryption only, version 2, not with -z): -u\nDecrypt byte range to standard output(Optional, decryption only): -r offset length\nFiles(- for standard input/output): -f files\nExample: -e -p loop -k 128 -b 64 -f *.*\n");
 		exit(EXIT_FAILURE);
 	}
 
@@ -55,13 +56,125 @@ bool CommandLineParser::parseArguments(
 
 	printf("Key size: '%i'\n", iKeylength);
 
-	/* Get all files */
+	/* Get optional settings */
 	int indexBeginFiles = -1;
 	if (status == OPCODE::ENCRYPTION)
 		indexBeginFiles = 6;
 	else
 		indexBeginFiles = 4;
-	if ((argv[indexBeginFiles][0] == '-') && (argv[indexBeginFiles][1] == 'f')) {
+	while ((indexBeginFiles < argc) && !((argv[indexBeginFiles][0] == '-') && (argv[indexBeginFiles][1] == 'f'))) {
+		if ((argv[indexBeginFiles][0] == '-') && (argv[indexBeginFiles][1] == 't') && (indexBeginFiles + 1 < argc)) {
+			options.numThreads = atoi(argv[indexBeginFiles + 1]);
+			printf("Threads: '%i'\n", options.numThreads);
+			indexBeginFiles += 2;
+		}
+		else if ((argv[indexBeginFiles][0] == '-') && (argv[indexBeginFiles][1] == 'b') && (indexBeginFiles + 1 < argc)) {
+			_saes64 bufferSize = (_saes64)atoi(argv[indexBeginFiles + 1]) * 1024;
+			if ((bufferSize < SAES_CPU_BUFFER_MIN_SIZE) || (bufferSize > SAES_CPU_BUFFER_MAX_SIZE) || (bufferSize & (bufferSize - 1))) {
+				printf("Error in command line: Near -b BUFFER command.\n");
+				exit(EXIT_FAILURE);
+			}
+			options.bufferSize = bufferSize;
+			printf("Buffer size: '%i KB'\n", (int)(bufferSize / 1024));
+			indexBeginFiles += 2;
+		}
+		else if ((argv[indexBeginFiles][0] == '-') && (argv[indexBeginFiles][1] == 'm')) {
+			options.memoryMap = true;
+			printf("Memory mapped I/O enabled.\n");
+			indexBeginFiles += 1;
+		}
+		else if ((argv[indexBeginFiles][0] == '-') && (argv[indexBeginFiles][1] == 'c') && (indexBeginFiles + 1 < argc)) {
+			if (strcmp(argv[indexBeginFiles + 1], "direct") == 0)
+				options.cacheMode = CACHECODE::CACHE_DIRECT;
+			else if (strcmp(argv[indexBeginFiles + 1], "dropbehind") == 0)
+				options.cacheMode = CACHECODE::CACHE_DROP_BEHIND;
+			else {
+				printf("Error in command line: Near -c CACHE command.\n");
+				exit(EXIT_FAILURE);
+			}
+			printf("Page cache mode: '%s'\n", argv[indexBeginFiles + 1]);
+			indexBeginFiles += 2;
+		}
+		else if ((argv[indexBeginFiles][0] == '-') && (argv[indexBeginFiles][1] == 'v') && (status == OPCODE::ENCRYPTION) && (indexBeginFiles + 1 < argc)) {
+			options.formatVersion = atoi(argv[indexBeginFiles + 1]);
+			if ((options.formatVersion != SAES_FORMAT_VERSION_1) && (options.formatVersion != SAES_FORMAT_VERSION_2)) {
+				printf("Error in command line: Near -v VERSION command.\n");
+				exit(EXIT_FAILURE);
+			}
+			printf("File format version: '%i'\n", options.formatVersion);
+			indexBeginFiles += 2;
+		}
+		else if ((argv[indexBeginFiles][0] == '-') && (argv[indexBeginFiles][1] == 'a') && (status == OPCODE::ENCRYPTION)) {
+			options.authenticate = true;
+			printf("Authentication enabled.\n");
+			indexBeginFiles += 1;
+		}
+		else if ((argv[indexBeginFiles][0] == '-') && (argv[indexBeginFiles][1] == 'i') && (status == OPCODE::ENCRYPTION)) {
+			options.checksum = true;
+			printf("Integrity checksum enabled.\n");
+			indexBeginFiles += 1;
+		}
+		else if ((argv[indexBeginFiles][0] == '-') && (argv[indexBeginFiles][1] == 'z') && (status == OPCODE::ENCRYPTION)) {
+			options.compress = true;
+			printf("Compression enabled.\n");
+			indexBeginFiles += 1;
+		}
+		else if ((argv[indexBeginFiles][0] == '-') && (argv[indexBeginFiles][1] == 'u') && (status == OPCODE::ENCRYPTION)) {
+			options.incremental = true;
+			printf("Incremental update enabled.\n");
+			indexBeginFiles += 1;
+		}
+		else if ((argv[indexBeginFiles][0] == '-') && (argv[indexBeginFiles][1] == 'r') && (status == OPCODE::DECRYPTION) && (indexBeginFiles + 2 < argc)) {
+			options.range = true;
+			options.rangeOffset = (_saes64)strtoull(argv[indexBeginFiles + 1], nullptr, 10);
+			options.rangeLength = (_saes64)strtoull(argv[indexBeginFiles + 2], nullptr, 10);
+			printf("Range: '%llu' bytes at offset '%llu'\n", (unsigned long long)options.rangeLength, (unsigned long long)options.rangeOffset);
+			indexBeginFiles += 3;
+		}
+		else {
+			printf("Error in command line: Near optional settings.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	/* Memory mapped files always go through the page cache */
+	if (options.memoryMap && (options.cacheMode != CACHECODE::CACHE_DEFAULT)) {
+		printf("Error in command line: -m cannot be combined with -c.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Tags and checksums are only stored in version 1 files */
+	if (options.authenticate && (options.formatVersion != SAES_FORMAT_VERSION_1)) {
+		printf("Error in command line: -a cannot be combined with -v 2.\n");
+		exit(EXIT_FAILURE);
+	}
+	if (options.checksum && (options.formatVersion != SAES_FORMAT_VERSION_1)) {
+		printf("Error in command line: -i cannot be combined with -v 2.\n");
+		exit(EXIT_FAILURE);
+	}
+	if (options.checksum && options.authenticate) {
+		printf("Error in command line: -i cannot be combined with -a.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Compressed chunk sizes are kept in the version 2 chunk index */
+	if (options.compress && (options.formatVersion != SAES_FORMAT_VERSION_2)) {
+		printf("Error in command line: -z needs -v 2.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Incremental updates rewrite chunks in place, at their plaintext offsets */
+	if (options.incremental && (options.formatVersion != SAES_FORMAT_VERSION_2)) {
+		printf("Error in command line: -u needs -v 2.\n");
+		exit(EXIT_FAILURE);
+	}
+	if (options.incremental && options.compress) {
+		printf("Error in command line: -u cannot be combined with -z.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Get all files */
+	if ((indexBeginFiles < argc) && (argv[indexBeginFiles][0] == '-') && (argv[indexBeginFiles][1] == 'f')) {
 		numFiles = argc - (indexBeginFiles + 1);
 		printf("Num of files: '%i'\n", numFiles);
 		// allocate space for files
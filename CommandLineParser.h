@@ -2,15 +2,23 @@
 #define COMMANDLINEPARSER_H
 
 #include "SAESconstants.h"
+#include "SAESFileEngine.h"
 #include <memory>
 #include <iostream>
 
+// optional command line settings, engine settings plus client-only ones
+struct CommandLineOptions : SAESEngineOptions {
+	bool range = false; // decrypt only a byte range to standard output, keeping the file
+	_saes64 rangeOffset = 0; // plaintext offset of range
+	_saes64 rangeLength = 0; // bytes in range
+};
+
 class CommandLineParser {
 
 public:
 
 	// parser
-	static bool parseArguments(const int, const char**, OPCODE&, byte*, int&, int&, std::unique_ptr<byte[][SAES_MAX_FILENAME_BUFFER_SIZE]>&);
+	static bool parseArguments(const int, const char**, OPCODE&, byte*, int&, int&, std::unique_ptr<byte[][SAES_MAX_FILENAME_BUFFER_SIZE]>&, CommandLineOptions&);
 
 private:
 
@@ -0,0 +1,83 @@
+#include "FastXOR.h"
+#include "CPUFeatures.h"
+
+#ifdef SAES_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+#if defined(SAES_X86) && defined(__GNUC__)
+#define FASTXOR_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define FASTXOR_AVX2_TARGET
+#endif
+
+#define FASTXOR_SSE2_BYTES 16
+#define FASTXOR_AVX2_BYTES 32
+
+#ifdef SAES_X86
+
+// XOR 32 bytes at a time, unrolled four times
+FASTXOR_AVX2_TARGET static _saes64 xorAVX2(const byte* in, const byte* keystream, byte* out, const _saes64 len) {
+
+	_saes64 index = 0;
+
+	for (; index + (4 * FASTXOR_AVX2_BYTES) <= len; index += 4 * FASTXOR_AVX2_BYTES) {
+		for (int i = 0; i < 4; i++) {
+			__m256i d = _mm256_loadu_si256((const __m256i*)(in + index + (i * FASTXOR_AVX2_BYTES)));
+			__m256i k = _mm256_loadu_si256((const __m256i*)(keystream + index + (i * FASTXOR_AVX2_BYTES)));
+			_mm256_storeu_si256((__m256i*)(out + index + (i * FASTXOR_AVX2_BYTES)), _mm256_xor_si256(d, k));
+		}
+	}
+	for (; index + FASTXOR_AVX2_BYTES <= len; index += FASTXOR_AVX2_BYTES) {
+		__m256i d = _mm256_loadu_si256((const __m256i*)(in + index));
+		__m256i k = _mm256_loadu_si256((const __m256i*)(keystream + index));
+		_mm256_storeu_si256((__m256i*)(out + index), _mm256_xor_si256(d, k));
+	}
+	_mm256_zeroupper();
+
+	return index;
+
+}
+
+// XOR 16 bytes at a time
+static _saes64 xorSSE2(const byte* in, const byte* keystream, byte* out, const _saes64 len) {
+
+	_saes64 index = 0;
+
+	for (; index + FASTXOR_SSE2_BYTES <= len; index += FASTXOR_SSE2_BYTES) {
+		__m128i d = _mm_loadu_si128((const __m128i*)(in + index));
+		__m128i k = _mm_loadu_si128((const __m128i*)(keystream + index));
+		_mm_storeu_si128((__m128i*)(out + index), _mm_xor_si128(d, k));
+	}
+
+	return index;
+
+}
+
+#endif
+
+/**
+XOR keystream with data.
+
+@param in (IN) Data to XOR.
+@param keystream (IN) Keystream, at least len bytes.
+@param out (OUT) Result, may be the same buffer as in.
+@param len (IN) Bytes to XOR.
+*/
+void FastXOR::xorBuffer(const byte* in, const byte* keystream, byte* out, const _saes64 len) {
+
+	_saes64 index = 0;
+
+	// vector body
+#ifdef SAES_X86
+	if ((len >= FASTXOR_AVX2_BYTES) && CPUFeatures::hasAVX2())
+		index = xorAVX2(in, keystream, out, len);
+	index += xorSSE2(in + index, keystream + index, out + index, len - index);
+#endif
+
+	// scalar tail
+	for (; index < len; index++)
+		out[index] = in[index] ^ keystream[index];
+
+}
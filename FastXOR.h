@@ -0,0 +1,24 @@
+#ifndef FASTXOR_H
+#define FASTXOR_H
+
+#ifdef __linux__
+#include <inttypes.h>
+#endif
+#include "SAESconstants.h"
+
+// SIMD buffer XOR, AVX2 or SSE2 selected at runtime
+class FastXOR {
+
+public:
+
+	// XOR keystream with data
+	static void xorBuffer(const byte*, const byte*, byte*, const _saes64);
+
+private:
+
+	// constructor
+	FastXOR();
+
+};
+
+#endif
@@ -0,0 +1,422 @@
+#include "FileIO.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <limits.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#include <winioctl.h>
+#else
+#include <unistd.h>
+#endif
+
+/**
+Open file for positional I/O.
+
+@param filename (IN) Name of file to open.
+@param fileCode (IN) Mode of operation, input/output/update. Output files are created or truncated; update opens an
+existing file for reading and writing in place.
+@param cacheCode (IN) Page cache use. CACHE_DIRECT bypasses the cache, offsets, lengths and buffers must then be
+aligned to SAES_DIRECT_IO_ALIGNMENT. CACHE_DROP_BEHIND reads ahead sequentially; callers drop completed ranges.
+Both fall back to ordinary cached I/O where the platform has no equivalent.
+
+@return File descriptor.
+
+@throw Throws FileException() if there was a problem opening file.
+*/
+int FileIO::openFile(const char* filename, const FILECODE fileCode, const CACHECODE cacheCode) {
+
+	int fd;
+	int cacheFlags = 0;
+
+	// open file
+#ifdef _WIN32
+	if (fileCode == FILECODE::FILE_INPUT)
+		fd = _open(filename, _O_RDONLY | _O_BINARY);
+	else if (fileCode == FILECODE::FILE_UPDATE)
+		fd = _open(filename, _O_RDWR | _O_BINARY);
+	else
+		fd = _open(filename, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+#ifdef O_DIRECT
+	if (cacheCode == CACHECODE::CACHE_DIRECT)
+		cacheFlags = O_DIRECT;
+#endif
+	if (fileCode == FILECODE::FILE_INPUT)
+		fd = open(filename, O_RDONLY | cacheFlags);
+	else if (fileCode == FILECODE::FILE_UPDATE)
+		fd = open(filename, O_RDWR | cacheFlags);
+	else
+		fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | cacheFlags, 0644);
+
+	// file system without direct I/O, aligned transfers still work cached
+	if ((fd < 0) && (errno == EINVAL) && (cacheFlags != 0)) {
+		if (fileCode == FILECODE::FILE_INPUT)
+			fd = open(filename, O_RDONLY);
+		else if (fileCode == FILECODE::FILE_UPDATE)
+			fd = open(filename, O_RDWR);
+		else
+			fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+#endif
+	if (fd < 0)
+		throw FileException("Failed to open file. Exiting program.\n");
+
+	// cache hints
+#if defined(F_NOCACHE) && !defined(O_DIRECT)
+	if (cacheCode == CACHECODE::CACHE_DIRECT)
+		fcntl(fd, F_NOCACHE, 1);
+#endif
+#if !defined(_WIN32) && defined(POSIX_FADV_SEQUENTIAL)
+	if (cacheCode == CACHECODE::CACHE_DROP_BEHIND)
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	return fd;
+
+}
+
+/**
+Close file.
+
+@param fd (IN) File descriptor.
+*/
+void FileIO::closeFile(const int fd) {
+
+#ifdef _WIN32
+	_close(fd);
+#else
+	close(fd);
+#endif
+
+}
+
+/**
+Get file size.
+
+@param fd (IN) File descriptor.
+
+@return Size of file.
+
+@throw Throws FileException() if file is empty.
+*/
+_saes64 FileIO::getFileSize(const int fd) {
+
+	_saes64 fileSize;
+
+	// stat file
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_fstat64(fd, &info) != 0)
+		throw FileException("Failed to stat file. Exiting program.\n");
+#else
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+		throw FileException("Failed to stat file. Exiting program.\n");
+#endif
+	fileSize = info.st_size;
+	if (fileSize == 0)
+		throw FileException("Cannot encrypt an empty file. Exiting program.\n");
+
+	return fileSize;
+
+}
+
+/**
+Set file size, truncating or zero extending it.
+
+@param fd (IN) File descriptor.
+@param fileSize (IN) New size of file.
+
+@throw Throws FileException() if file could not be resized.
+*/
+void FileIO::setFileSize(const int fd, const _saes64 fileSize) {
+
+#ifdef _WIN32
+	if (_chsize_s(fd, fileSize) != 0)
+		throw FileException("Failed to write file. Exiting program.\n");
+#else
+	if (ftruncate(fd, (off_t)fileSize) != 0)
+		throw FileException("Failed to write file. Exiting program.\n");
+#endif
+
+}
+
+/**
+Find the next data in a sparse file, so holes can be skipped without reading them. File systems that do not report holes
+make every byte data.
+
+@param fd (IN) File descriptor. Its sequential file position may move.
+@param offset (IN) Offset to search from.
+@param fileSize (IN) Size of file.
+
+@return Offset of the first data byte at or after offset, fileSize if only a hole follows.
+*/
+_saes64 FileIO::seekData(const int fd, const _saes64 offset, const _saes64 fileSize) {
+
+	if (offset >= fileSize)
+		return fileSize;
+
+#ifdef _WIN32
+	FILE_ALLOCATED_RANGE_BUFFER query, range;
+	DWORD bytes = 0;
+	query.FileOffset.QuadPart = (LONGLONG)offset;
+	query.Length.QuadPart = (LONGLONG)(fileSize - offset);
+	if (DeviceIoControl((HANDLE)_get_osfhandle(fd), FSCTL_QUERY_ALLOCATED_RANGES, &query, sizeof(query), &range, sizeof(range), &bytes, NULL) || (GetLastError() == ERROR_MORE_DATA)) {
+		if (bytes < sizeof(range))
+			return fileSize;
+		return ((_saes64)range.FileOffset.QuadPart > offset) ? (_saes64)range.FileOffset.QuadPart : offset;
+	}
+#elif defined(SEEK_DATA)
+	off_t data = lseek(fd, (off_t)offset, SEEK_DATA);
+	if (data >= 0)
+		return std::min((_saes64)data, fileSize);
+	if (errno == ENXIO)
+		return fileSize;
+#endif
+
+	return offset;
+
+}
+
+/**
+Return a file opened with CACHE_DIRECT to cached I/O, so unaligned data such as the SAES headers can be written.
+
+@param fd (IN) File descriptor.
+*/
+void FileIO::clearDirect(const int fd) {
+
+#if !defined(_WIN32) && defined(O_DIRECT)
+	int flags = fcntl(fd, F_GETFL);
+	if (flags >= 0)
+		fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+#elif defined(F_NOCACHE)
+	fcntl(fd, F_NOCACHE, 0);
+#endif
+
+}
+
+/**
+Start writeback of a written range without waiting for it, so a later dropCache() finds it clean.
+
+@param fd (IN) File descriptor.
+@param offset (IN) Start of range.
+@param len (IN) Bytes in range, 0 for end of file.
+*/
+void FileIO::startWriteback(const int fd, const _saes64 offset, const _saes64 len) {
+
+#if defined(__linux__) && defined(SYNC_FILE_RANGE_WRITE)
+	sync_file_range(fd, (off_t)offset, (off_t)len, SYNC_FILE_RANGE_WRITE);
+#endif
+
+}
+
+/**
+Drop a completed range from the page cache.
+
+@param fd (IN) File descriptor.
+@param offset (IN) Start of range.
+@param len (IN) Bytes in range, 0 for end of file.
+@param written (IN) True if range was written and must reach disk before its pages can be dropped.
+*/
+void FileIO::dropCache(const int fd, const _saes64 offset, const _saes64 len, const bool written) {
+
+#ifndef _WIN32
+	// dirty pages are only dropped once clean
+	if (written) {
+#if defined(__linux__) && defined(SYNC_FILE_RANGE_WRITE)
+		sync_file_range(fd, (off_t)offset, (off_t)len, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#else
+		fsync(fd);
+#endif
+	}
+#ifdef POSIX_FADV_DONTNEED
+	posix_fadvise(fd, (off_t)offset, (off_t)len, POSIX_FADV_DONTNEED);
+#endif
+#endif
+
+}
+
+/**
+Start reading a range into the page cache ahead of use, without waiting for it.
+
+@param fd (IN) File descriptor.
+@param offset (IN) Start of range.
+@param len (IN) Bytes in range.
+*/
+void FileIO::prefetch(const int fd, const _saes64 offset, const _saes64 len) {
+
+#if !defined(_WIN32) && defined(POSIX_FADV_WILLNEED)
+	posix_fadvise(fd, (off_t)offset, (off_t)len, POSIX_FADV_WILLNEED);
+#endif
+
+}
+
+/**
+Read up to len bytes at offset without moving the file position.
+
+@param fd (IN) File descriptor.
+@param buffer (OUT) Buffer receiving data.
+@param len (IN) Bytes to read.
+@param offset (IN) File offset.
+
+@return Bytes read, less than len only at end of file.
+
+@throw Throws FileException() if read fails.
+*/
+_saes64 FileIO::readAt(const int fd, void* buffer, const _saes64 len, const _saes64 offset) {
+
+	_saes64 total = 0;
+
+	while (total < len) {
+
+#ifdef _WIN32
+		OVERLAPPED overlapped = {};
+		DWORD bytesRead = 0;
+		DWORD request = ((len - total) > MAXDWORD) ? MAXDWORD : (DWORD)(len - total);
+		_saes64 position = offset + total;
+		overlapped.Offset = (DWORD)(position & 0xFFFFFFFF);
+		overlapped.OffsetHigh = (DWORD)(position >> 32);
+		if (!ReadFile((HANDLE)_get_osfhandle(fd), (byte*)buffer + total, request, &bytesRead, &overlapped)) {
+			if (GetLastError() == ERROR_HANDLE_EOF)
+				break;
+			throw FileException("Failed to read file. Exiting program.\n");
+		}
+		if (bytesRead == 0)
+			break;
+		total += bytesRead;
+#else
+		ssize_t bytesRead = pread(fd, (byte*)buffer + total, len - total, offset + total);
+		if (bytesRead < 0) {
+			if (errno == EINTR)
+				continue;
+			throw FileException("Failed to read file. Exiting program.\n");
+		}
+		if (bytesRead == 0)
+			break;
+		total += bytesRead;
+#endif
+
+	}
+
+	return total;
+
+}
+
+/**
+Write len bytes at offset without moving the file position.
+
+@param fd (IN) File descriptor.
+@param buffer (IN) Data to write.
+@param len (IN) Bytes to write.
+@param offset (IN) File offset.
+
+@throw Throws FileException() if write fails.
+*/
+void FileIO::writeAt(const int fd, const void* buffer, const _saes64 len, const _saes64 offset) {
+
+	_saes64 total = 0;
+
+	while (total < len) {
+
+#ifdef _WIN32
+		OVERLAPPED overlapped = {};
+		DWORD bytesWritten = 0;
+		DWORD request = ((len - total) > MAXDWORD) ? MAXDWORD : (DWORD)(len - total);
+		_saes64 position = offset + total;
+		overlapped.Offset = (DWORD)(position & 0xFFFFFFFF);
+		overlapped.OffsetHigh = (DWORD)(position >> 32);
+		if (!WriteFile((HANDLE)_get_osfhandle(fd), (const byte*)buffer + total, request, &bytesWritten, &overlapped) || (bytesWritten == 0))
+			throw FileException("Failed to write file. Exiting program.\n");
+		total += bytesWritten;
+#else
+		ssize_t bytesWritten = pwrite(fd, (const byte*)buffer + total, len - total, offset + total);
+		if (bytesWritten < 0) {
+			if (errno == EINTR)
+				continue;
+			throw FileException("Failed to write file. Exiting program.\n");
+		}
+		// a call writing nothing would repeat forever
+		if (bytesWritten == 0)
+			throw FileException("Failed to write file. Exiting program.\n");
+		total += bytesWritten;
+#endif
+
+	}
+
+}
+
+/**
+Read up to len bytes from the current file position, waiting on pipes until len bytes arrive or input ends.
+
+@param fd (IN) File descriptor.
+@param buffer (OUT) Buffer receiving data.
+@param len (IN) Bytes to read.
+
+@return Bytes read, less than len only at end of input.
+
+@throw Throws FileException() if read fails.
+*/
+_saes64 FileIO::readStream(const int fd, void* buffer, const _saes64 len) {
+
+	_saes64 total = 0;
+
+	while (total < len) {
+
+#ifdef _WIN32
+		unsigned int request = ((len - total) > INT_MAX) ? INT_MAX : (unsigned int)(len - total);
+		int bytesRead = _read(fd, (byte*)buffer + total, request);
+#else
+		ssize_t bytesRead = read(fd, (byte*)buffer + total, len - total);
+#endif
+		if (bytesRead < 0) {
+			if (errno == EINTR)
+				continue;
+			throw FileException("Failed to read file. Exiting program.\n");
+		}
+		if (bytesRead == 0)
+			break;
+		total += bytesRead;
+
+	}
+
+	return total;
+
+}
+
+/**
+Write len bytes at the current file position.
+
+@param fd (IN) File descriptor.
+@param buffer (IN) Data to write.
+@param len (IN) Bytes to write.
+
+@throw Throws FileException() if write fails.
+*/
+void FileIO::writeStream(const int fd, const void* buffer, const _saes64 len) {
+
+	_saes64 total = 0;
+
+	while (total < len) {
+
+#ifdef _WIN32
+		unsigned int request = ((len - total) > INT_MAX) ? INT_MAX : (unsigned int)(len - total);
+		int bytesWritten = _write(fd, (const byte*)buffer + total, request);
+#else
+		ssize_t bytesWritten = write(fd, (const byte*)buffer + total, len - total);
+#endif
+		if (bytesWritten < 0) {
+			if (errno == EINTR)
+				continue;
+			throw FileException("Failed to write file. Exiting program.\n");
+		}
+		if (bytesWritten == 0)
+			throw FileException("Failed to write file. Exiting program.\n");
+		total += bytesWritten;
+
+	}
+
+}
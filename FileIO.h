@@ -0,0 +1,47 @@
+#ifndef FILEIO_H
+#define FILEIO_H
+
+#ifdef __linux__
+#include <inttypes.h>
+#endif
+#include "SAESconstants.h"
+#include "Exceptions.h"
+
+// positional file I/O safe for concurrent use on one descriptor
+class FileIO {
+
+public:
+
+	// open/close
+	static int openFile(const char*, const FILECODE, const CACHECODE = CACHECODE::CACHE_DEFAULT);
+	static void closeFile(const int);
+
+	// size
+	static _saes64 getFileSize(const int);
+	static void setFileSize(const int, const _saes64);
+
+	// sparse files
+	static _saes64 seekData(const int, const _saes64, const _saes64);
+
+	// page cache control
+	static void clearDirect(const int);
+	static void startWriteback(const int, const _saes64, const _saes64);
+	static void dropCache(const int, const _saes64, const _saes64, const bool);
+	static void prefetch(const int, const _saes64, const _saes64);
+
+	// positional read/write
+	static _saes64 readAt(const int, void*, const _saes64, const _saes64);
+	static void writeAt(const int, const void*, const _saes64, const _saes64);
+
+	// sequential read/write, for pipes
+	static _saes64 readStream(const int, void*, const _saes64);
+	static void writeStream(const int, const void*, const _saes64);
+
+private:
+
+	// constructor
+	FileIO();
+
+};
+
+#endif
@@ -0,0 +1,372 @@
+#include "GHASH.h"
+#include <string.h>
+
+#ifdef SAES_X86
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+#if defined(SAES_X86) && defined(__GNUC__)
+#define GHASH_TARGET __attribute__((target("pclmul,ssse3")))
+#else
+#define GHASH_TARGET
+#endif
+
+// reduction polynomial x^128 + x^7 + x^2 + x + 1, in the bit-reflected order of GCM
+#define GHASH_R 0xE100000000000000ULL
+
+// reductions of the 4 bits shifted out by one table step
+static const uint64_t tableReduce[SAES_BLOCK_BYTES] = {
+	0x0000, 0x1C20, 0x3840, 0x2460, 0x7080, 0x6CA0, 0x48C0, 0x54E0,
+	0xE100, 0xFD20, 0xD940, 0xC560, 0x9180, 0x8DA0, 0xA9C0, 0xB5E0
+};
+
+// load big-endian 64-bit word
+static uint64_t loadBE(const byte* in) {
+
+	uint64_t value = 0;
+	for (int i = 0; i < 8; i++)
+		value = (value << 8) | in[i];
+	return value;
+
+}
+
+// store big-endian 64-bit word
+static void storeBE(byte* out, const uint64_t value) {
+
+	for (int i = 0; i < 8; i++)
+		out[i] = (byte)(value >> (56 - (8 * i)));
+
+}
+
+// constructor
+GHASH::GHASH() : pclmulEnabled(false) {
+
+	memset(powers, 0, sizeof(powers));
+	memset(hashKey, 0, sizeof(hashKey));
+	memset(tableHigh, 0, sizeof(tableHigh));
+	memset(tableLow, 0, sizeof(tableLow));
+
+}
+
+/**
+Check whether the CPU supports carry-less multiply.
+
+@return True if PCLMULQDQ and PSHUFB are available.
+*/
+bool GHASH::isSupported() {
+
+	return CPUFeatures::hasPCLMUL();
+
+}
+
+/**
+Load hash key and build the tables of the selected backend: byte-reversed powers H^1..H^SAES_PIPELINE_BLOCKS for
+PCLMULQDQ, multiples of H by every 4-bit value for the table.
+
+@param key (IN) Hash key H, SAES_BLOCK_BYTES.
+*/
+void GHASH::loadKey(const byte* key) {
+
+	byte keyPower[SAES_BLOCK_BYTES];
+	uint64_t high, low;
+
+	memcpy(hashKey, key, SAES_BLOCK_BYTES);
+	pclmulEnabled = isSupported();
+
+	// powers, highest last, each byte reversed
+	memcpy(keyPower, hashKey, SAES_BLOCK_BYTES);
+	for (int i = 0; i < SAES_PIPELINE_BLOCKS; i++) {
+		for (int j = 0; j < SAES_BLOCK_BYTES; j++)
+			powers[(i * SAES_BLOCK_BYTES) + j] = keyPower[SAES_BLOCK_BYTES - 1 - j];
+		multiply(keyPower, hashKey, keyPower);
+	}
+
+	// table entry 8 is H, halving towards entry 1
+	high = loadBE(hashKey);
+	low = loadBE(hashKey + 8);
+	tableHigh[0] = tableLow[0] = 0;
+	tableHigh[8] = high;
+	tableLow[8] = low;
+	for (int i = 4; i > 0; i >>= 1) {
+		uint64_t carry = (low & 1) ? GHASH_R : 0;
+		low = (high << 63) | (low >> 1);
+		high = (high >> 1) ^ carry;
+		tableHigh[i] = high;
+		tableLow[i] = low;
+	}
+
+	// remaining entries are sums of those
+	for (int i = 2; i <= 8; i <<= 1) {
+		for (int j = 1; j < i; j++) {
+			tableHigh[i + j] = tableHigh[i] ^ tableHigh[j];
+			tableLow[i + j] = tableLow[i] ^ tableLow[j];
+		}
+	}
+
+}
+
+/**
+Absorb data into a hash state.
+
+@param state (IN/OUT) Hash state, SAES_BLOCK_BYTES, zero to start.
+@param data (IN) Data to hash.
+@param len (IN) Bytes of data. A final partial block is zero padded, so only the last call may pass a length that is not
+a multiple of SAES_BLOCK_BYTES.
+*/
+void GHASH::update(byte* state, const byte* data, const _saes64 len) const {
+
+	_saes64 numBlocks = len / SAES_BLOCK_BYTES;
+
+	// full blocks
+	if (pclmulEnabled)
+		clmulUpdate(state, data, numBlocks);
+	else {
+		for (_saes64 block = 0; block < numBlocks; block++) {
+			for (int i = 0; i < SAES_BLOCK_BYTES; i++)
+				state[i] ^= data[(block * SAES_BLOCK_BYTES) + i];
+			tableMultiply(state);
+		}
+	}
+
+	// partial last block, zero padded
+	if (len % SAES_BLOCK_BYTES) {
+		byte lastBlock[SAES_BLOCK_BYTES] = { 0x00 };
+		memcpy(lastBlock, data + (numBlocks * SAES_BLOCK_BYTES), (size_t)(len % SAES_BLOCK_BYTES));
+		update(state, lastBlock, SAES_BLOCK_BYTES);
+	}
+
+}
+
+/**
+Append the hash of a following chunk, hashed on its own from a zero state, to a hash state. Chunks of one message may so
+be hashed on several threads and joined in order.
+
+@param state (IN/OUT) Hash state of all data before the chunk.
+@param chunkState (IN) Hash state of the chunk alone.
+@param chunkLen (IN) Bytes hashed into chunkState.
+*/
+void GHASH::combine(byte* state, const byte* chunkState, const _saes64 chunkLen) const {
+
+	byte keyPower[SAES_BLOCK_BYTES];
+
+	// shift state past the chunk blocks
+	power((chunkLen + SAES_BLOCK_BYTES - 1) / SAES_BLOCK_BYTES, keyPower);
+	multiply(state, keyPower, state);
+
+	for (int i = 0; i < SAES_BLOCK_BYTES; i++)
+		state[i] ^= chunkState[i];
+
+}
+
+/**
+Absorb the GCM length block, leaving the final hash in state.
+
+@param state (IN/OUT) Hash state.
+@param aadLen (IN) Bytes of authenticated data hashed before the ciphertext.
+@param dataLen (IN) Bytes of ciphertext.
+*/
+void GHASH::finish(byte* state, const _saes64 aadLen, const _saes64 dataLen) const {
+
+	byte lengths[SAES_BLOCK_BYTES];
+
+	storeBE(lengths, aadLen * SAES_BYTE_SIZE);
+	storeBE(lengths + 8, dataLen * SAES_BYTE_SIZE);
+	update(state, lengths, SAES_BLOCK_BYTES);
+
+}
+
+/**
+Multiply two field elements bit by bit. Used for key setup and combining chunks, not for bulk data.
+
+@param x (IN) First factor.
+@param y (IN) Second factor.
+@param product (OUT) Product, may be x or y.
+*/
+void GHASH::multiply(const byte* x, const byte* y, byte* product) {
+
+	uint64_t xHigh = loadBE(x), xLow = loadBE(x + 8);
+	uint64_t vHigh = loadBE(y), vLow = loadBE(y + 8);
+	uint64_t zHigh = 0, zLow = 0;
+
+	for (int i = 0; i < 128; i++) {
+		uint64_t bit = (i < 64) ? (xHigh >> (63 - i)) : (xLow >> (127 - i));
+		uint64_t carry = (vLow & 1) ? GHASH_R : 0;
+		if (bit & 1) {
+			zHigh ^= vHigh;
+			zLow ^= vLow;
+		}
+		vLow = (vHigh << 63) | (vLow >> 1);
+		vHigh = (vHigh >> 1) ^ carry;
+	}
+
+	storeBE(product, zHigh);
+	storeBE(product + 8, zLow);
+
+}
+
+/**
+Raise hash key to a power by square and multiply.
+
+@param exponent (IN) Power.
+@param result (OUT) H^exponent.
+*/
+void GHASH::power(const _saes64 exponent, byte* result) const {
+
+	byte base[SAES_BLOCK_BYTES];
+	_saes64 remaining = exponent;
+
+	// one is the leftmost bit in GCM bit order
+	memset(result, 0, SAES_BLOCK_BYTES);
+	result[0] = 0x80;
+	memcpy(base, hashKey, SAES_BLOCK_BYTES);
+
+	while (remaining) {
+		if (remaining & 1)
+			multiply(result, base, result);
+		multiply(base, base, base);
+		remaining >>= 1;
+	}
+
+}
+
+/**
+Multiply hash state by H with the 4-bit table, one nibble at a time from the last byte.
+
+@param state (IN/OUT) Hash state.
+*/
+void GHASH::tableMultiply(byte* state) const {
+
+	uint64_t high, low;
+	byte nibble = state[SAES_BLOCK_BYTES - 1] & 0x0F;
+
+	high = tableHigh[nibble];
+	low = tableLow[nibble];
+
+	for (int i = SAES_BLOCK_BYTES - 1; i >= 0; i--) {
+
+		byte lowNibble = state[i] & 0x0F;
+		byte highNibble = (state[i] >> 4) & 0x0F;
+		byte shifted;
+
+		if (i != SAES_BLOCK_BYTES - 1) {
+			shifted = low & 0x0F;
+			low = (high << 60) | (low >> 4);
+			high = (high >> 4) ^ (tableReduce[shifted] << 48);
+			high ^= tableHigh[lowNibble];
+			low ^= tableLow[lowNibble];
+		}
+
+		shifted = low & 0x0F;
+		low = (high << 60) | (low >> 4);
+		high = (high >> 4) ^ (tableReduce[shifted] << 48);
+		high ^= tableHigh[highNibble];
+		low ^= tableLow[highNibble];
+
+	}
+
+	storeBE(state, high);
+	storeBE(state + 8, low);
+
+}
+
+#ifdef SAES_X86
+
+// 256-bit carry-less product of two byte-reversed elements, added to lo:hi unreduced
+GHASH_TARGET static inline void clmulAccumulate(const __m128i a, const __m128i b, __m128i& lo, __m128i& hi) {
+
+	__m128i middle = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+
+	lo = _mm_xor_si128(lo, _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x00), _mm_slli_si128(middle, 8)));
+	hi = _mm_xor_si128(hi, _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x11), _mm_srli_si128(middle, 8)));
+
+}
+
+// shift a 256-bit product left one bit for the reflected order, then reduce it modulo the GCM polynomial
+GHASH_TARGET static inline __m128i clmulReduce(__m128i lo, __m128i hi) {
+
+	__m128i carryLo = _mm_srli_epi32(lo, 31);
+	__m128i carryHi = _mm_srli_epi32(hi, 31);
+	__m128i carryOut = _mm_srli_si128(carryLo, 12);
+	__m128i t1, t2, t3;
+
+	// shift left by one bit across the 256-bit value
+	lo = _mm_or_si128(_mm_slli_epi32(lo, 1), _mm_slli_si128(carryLo, 4));
+	hi = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(hi, 1), _mm_slli_si128(carryHi, 4)), carryOut);
+
+	// first phase
+	t1 = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+	t2 = _mm_srli_si128(t1, 4);
+	lo = _mm_xor_si128(lo, _mm_slli_si128(t1, 12));
+
+	// second phase
+	t3 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+	t3 = _mm_xor_si128(t3, t2);
+	lo = _mm_xor_si128(lo, t3);
+
+	return _mm_xor_si128(hi, lo);
+
+}
+
+/**
+Absorb full blocks with PCLMULQDQ. Each group of SAES_PIPELINE_BLOCKS blocks is multiplied by descending key powers
+and summed before a single reduction: Y = (Y + X1)H^n + X2H^(n-1) + ... + XnH.
+
+@param state (IN/OUT) Hash state.
+@param data (IN) Data to hash.
+@param numBlocks (IN) Number of full blocks.
+*/
+GHASH_TARGET void GHASH::clmulUpdate(byte* state, const byte* data, const _saes64 numBlocks) const {
+
+	__m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	__m128i keys[SAES_PIPELINE_BLOCKS];
+	__m128i y = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)state), reverse);
+	_saes64 block = 0;
+	int i;
+
+	// load key powers
+	for (i = 0; i < SAES_PIPELINE_BLOCKS; i++)
+		keys[i] = _mm_load_si128((const __m128i*)(powers + i * SAES_BLOCK_BYTES));
+
+	// aggregated blocks
+	for (; block + SAES_PIPELINE_BLOCKS <= numBlocks; block += SAES_PIPELINE_BLOCKS) {
+
+		__m128i lo = _mm_setzero_si128();
+		__m128i hi = _mm_setzero_si128();
+
+		for (i = 0; i < SAES_PIPELINE_BLOCKS; i++) {
+			__m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + (block + i) * SAES_BLOCK_BYTES)), reverse);
+			if (i == 0)
+				x = _mm_xor_si128(x, y);
+			clmulAccumulate(x, keys[SAES_PIPELINE_BLOCKS - 1 - i], lo, hi);
+		}
+
+		y = clmulReduce(lo, hi);
+
+	}
+
+	// remaining blocks
+	for (; block < numBlocks; block++) {
+
+		__m128i lo = _mm_setzero_si128();
+		__m128i hi = _mm_setzero_si128();
+		__m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + block * SAES_BLOCK_BYTES)), reverse);
+
+		clmulAccumulate(_mm_xor_si128(x, y), keys[0], lo, hi);
+		y = clmulReduce(lo, hi);
+
+	}
+
+	_mm_storeu_si128((__m128i*)state, _mm_shuffle_epi8(y, reverse));
+
+}
+
+#else
+
+/**
+Absorb full blocks with PCLMULQDQ. Unavailable on this architecture; isSupported() always returns false.
+*/
+void GHASH::clmulUpdate(byte* state, const byte* data, const _saes64 numBlocks) const {}
+
+#endif
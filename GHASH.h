@@ -0,0 +1,50 @@
+#ifndef GHASH_H
+#define GHASH_H
+
+#ifdef __linux__
+#include <inttypes.h>
+#endif
+#include "SAESconstants.h"
+#include "CPUFeatures.h"
+#include <stdint.h>
+
+// GHASH universal hash over GF(2^128), as in GCM.
+// PCLMULQDQ folds SAES_PIPELINE_BLOCKS blocks per reduction with precomputed powers of the hash key, so hashing keeps
+// pace with the pipelined cipher; CPUs without it use a 4-bit table. The key is read-only once loaded, so one object
+// serves several threads, each with its own SAES_BLOCK_BYTES hash state.
+class GHASH {
+
+public:
+
+	// constructor
+	GHASH();
+
+	// check cpu support
+	static bool isSupported();
+
+	// load hash key
+	void loadKey(const byte*);
+
+	// hash
+	void update(byte*, const byte*, const _saes64) const;
+	void combine(byte*, const byte*, const _saes64) const;
+	void finish(byte*, const _saes64, const _saes64) const;
+
+private:
+
+	// field arithmetic
+	static void multiply(const byte*, const byte*, byte*);
+	void power(const _saes64, byte*) const;
+	void tableMultiply(byte*) const;
+
+	// carry-less multiply
+	void clmulUpdate(byte*, const byte*, const _saes64) const;
+
+	alignas(16) byte powers[SAES_PIPELINE_BLOCKS * SAES_BLOCK_BYTES];
+	byte hashKey[SAES_BLOCK_BYTES];
+	uint64_t tableHigh[SAES_BLOCK_BYTES], tableLow[SAES_BLOCK_BYTES];
+	bool pclmulEnabled;
+
+};
+
+#endif
@@ -1,14 +1,31 @@
 #include "GPU.h"
+#include "XXHash64.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
 ////////////
 /* PUBLIC */
 ////////////
 
-// constructor
-GPU::GPU(const char* _filename) : 
-	filename(_filename), 
+// constructor, nothing touches the device before findDevice()
+GPU::GPU(const char* _source, const size_t _sourceSize) :
+	source(_source),
+	sourceSize(_sourceSize),
 	platformIds(nullptr), 
-	fileBuffer(nullptr), 
+	kernelName(nullptr),
+	streamBytes(0),
+	streamBufferArgNum(0),
+	localWorkSize(0),
+	unitsPerWorkItem(1),
+	launchTuned(false),
+	deviceName(),
 	deviceGPUId(NULL), 
 	commandQueue(NULL), 
 	program(NULL),
@@ -16,41 +33,35 @@ GPU::GPU(const char* _filename) :
 	kernel(NULL),
 	retNumPlatforms(-1),
 	retNumDevices(-1),
-	retVal(-1),
-	filesize(-1)
-{
-	
-	// check if file exists
-	if (!fileExists()) {
-		printf("Program file does not exist. Exiting now.\n");
-		exit(EXIT_FAILURE);
-	}
-
-
-	// set filesize
-	filesize = getFilesize();
-
-	// allocate file buffer
-	fileBuffer = std::unique_ptr<char[]>(new char[filesize]);
-
-	// read file to buffer
-	readFileToBuffer();
-
-}
+	retVal(-1)
+{}
 
 // destructor
 GPU::~GPU(){
 
 	// free
-	clReleaseKernel(kernel);
-	clReleaseContext(context);
-	clReleaseProgram(program);
-	clReleaseCommandQueue(commandQueue);
+	releaseStreams();
+	releasePool();
+	if (kernel)
+		clReleaseKernel(kernel);
+	if (context)
+		clReleaseContext(context);
+	if (program)
+		clReleaseProgram(program);
+	if (commandQueue)
+		clReleaseCommandQueue(commandQueue);
 
 }
 
-// build program from file
-void GPU::buildProgram(std::unique_ptr<byte[]>& gpuName) {
+/**
+Find the first GPU device of any platform. Only enumerates, so it is cheap enough to decide the backend with; the
+context and program are made by buildProgram() once a file actually runs on the GPU.
+
+@param gpuName (OUT) Device name.
+
+@throw Throws GPUException() if there is no GPU device.
+*/
+void GPU::findDevice(std::unique_ptr<byte[]>& gpuName) {
 
 	cl_uint platformIndexWithGPU = -1;
 
@@ -67,7 +78,7 @@ void GPU::buildProgram(std::unique_ptr<byte[]>& gpuName) {
 
 	// Get 1st platform with GPU device and allocate device space
 	for (int i = 0; i < retNumPlatforms; i++) { // auto range platforms
-		retVal = clGetDeviceIDs(platformIds.get()[i], CL_DEVICE_TYPE_GPU, NULL, NULL, &retNumDevices);
+		retVal = clGetDeviceIDs(platformIds.get()[i], CL_DEVICE_TYPE_GPU, 0, NULL, &retNumDevices);
 		if (retVal != 0)
 			throw GPUException("Error: Finding size of devices in clGetDeviceIDs() failed.\n");
 
@@ -87,26 +98,7 @@ void GPU::buildProgram(std::unique_ptr<byte[]>& gpuName) {
 	// Set GPU name
 	gpuName = std::unique_ptr<byte[]>(new byte[GPU_MAX_NAME_SIZE]);
 	CL_CHECK(clGetDeviceInfo(deviceGPUId, CL_DEVICE_NAME, GPU_MAX_NAME_SIZE, gpuName.get(), NULL));
-
-	// Create context
-	context = clCreateContext(NULL, GPU_NUM_GPUS, &deviceGPUId, NULL, NULL, &retVal);
-	if (retVal != 0)
-		throw GPUException("Error: Creating context in clCreateContext() failed.\n");
-
-	// Create command queue
-	commandQueue = clCreateCommandQueue(context, deviceGPUId, NULL, &retVal);
-	if (retVal != 0)
-		throw GPUException("Error: Creating command queue in clCreateCommandQueue() failed.\n");
-
-	// Create program from file
-	program = clCreateProgramWithSource(context, 1, (const char**)&fileBuffer, &filesize, &retVal);
-	if (retVal != 0)
-		throw GPUException("Error: Creating program from source in clCreateProgramWithSource() failed.\n");
-
-	// Build program
-	retVal = clBuildProgram(program, 1, &deviceGPUId, NULL, NULL, NULL);
-	if (retVal != 0)
-		throw GPUException("Error: Creating program in clBuildProgram() failed.\n");
+	snprintf(deviceName, sizeof(deviceName), "%s", (const char*)gpuName.get());
 
 	// debug
 	#ifdef _DEBUG
@@ -165,23 +157,85 @@ void GPU::buildProgram(std::unique_ptr<byte[]>& gpuName) {
 
 }
 
+/**
+Create context and command queue and build the program for the device found by findDevice(). The device build is
+cached in the per-user cache directory, named after a hash of device name, driver version and kernel source, so a
+later run loads it with clCreateProgramWithBinary() instead of compiling. A missing, stale or rejected binary falls
+back to compiling the source, and the new build replaces it.
+
+@throw Throws GPUException() if the context, queue or program could not be created.
+*/
+void GPU::buildProgram() {
+
+	char driverVersion[GPU_MAX_NAME_SIZE] = {};
+	char cacheName[GPU_MAX_NAME_SIZE];
+	char cachePath[GPU_MAX_PATH_SIZE];
+	bool cached;
+	uint64_t key;
+
+	// Create context
+	context = clCreateContext(NULL, GPU_NUM_GPUS, &deviceGPUId, NULL, NULL, &retVal);
+	if (retVal != 0)
+		throw GPUException("Error: Creating context in clCreateContext() failed.\n");
+
+	// Create command queue
+	commandQueue = clCreateCommandQueue(context, deviceGPUId, 0, &retVal);
+	if (retVal != 0)
+		throw GPUException("Error: Creating command queue in clCreateCommandQueue() failed.\n");
+
+	// Cache key of device, driver and kernel source
+	clGetDeviceInfo(deviceGPUId, CL_DRIVER_VERSION, sizeof(driverVersion) - 1, driverVersion, NULL);
+	key = XXHash64::hash((const byte*)source, sourceSize, 0);
+	key = XXHash64::hash((const byte*)deviceName, strlen(deviceName), key);
+	key = XXHash64::hash((const byte*)driverVersion, strlen(driverVersion), key);
+	snprintf(cacheName, sizeof(cacheName), GPU_BINARY_FILENAME_FORMAT, (unsigned long long)key);
+	cached = getCachePath(cacheName, cachePath, sizeof(cachePath));
+
+	// Load program from cache
+	if (cached && loadProgramBinary(cachePath))
+		return;
+
+	// Create program from source
+	program = clCreateProgramWithSource(context, 1, &source, &sourceSize, &retVal);
+	if (retVal != 0)
+		throw GPUException("Error: Creating program from source in clCreateProgramWithSource() failed.\n");
+
+	// Build program
+	retVal = clBuildProgram(program, 1, &deviceGPUId, NULL, NULL, NULL);
+	if (retVal != 0)
+		throw GPUException("Error: Creating program in clBuildProgram() failed.\n");
+
+	// Cache device build
+	if (cached)
+		saveProgramBinary(cachePath);
+
+}
+
+/**
+Check if the program is ready.
+
+@return True once buildProgram() and createKernelFromProgram() succeeded.
+*/
+bool GPU::isProgramBuilt() const {
+	return kernel != NULL;
+}
+
 // create kernel from program
 void GPU::createKernelFromProgram(const char* kernelFunc) {
 
-	// Create kernel
+	// Create kernel, streams create their own from the same function
 	kernel = clCreateKernel(program, kernelFunc, &retVal);
 	if (retVal != 0)
 		throw GPUException("Error: Creating kernel from function in clCreateKernel() failed.\n");
+	kernelName = kernelFunc;
 
 }
 
 // write data to mem buffer
 void GPU::writeMemBuffer(cl_mem& memBuffer, const void* data, size_t bytesToAllocate, int flags) {
 
-	// Create memory buffer
-	memBuffer = clCreateBuffer(context, flags, bytesToAllocate, NULL, &retVal);
-	if (retVal != 0)
-		throw GPUException("Error: Creating memory buffer in clCreateBuffer() failed.\n");
+	// Take memory buffer from pool
+	memBuffer = acquireBuffer(bytesToAllocate, flags);
 
 	// if NULL, skip write to buffer
 	if (!data)
@@ -214,16 +268,22 @@ void GPU::addKernelParam(const int argNum, const cl_mem& memBuffer) {
 
 }
 
-// execute 1d kernel
-void GPU::execute1DKernel(const int outputFilesize) {
+// add scalar kernel parameter
+void GPU::addKernelParam(const int argNum, const size_t argSize, const void* arg) {
 
-	size_t* localWorkSize = new size_t[GPU_ONE_DIMENSION];
-	size_t* globalWorkSize = new size_t[GPU_ONE_DIMENSION];
+	// Set kernel params
+	retVal = clSetKernelArg(kernel, argNum, argSize, arg);
+	if (retVal != 0)
+		throw GPUException("Error: Setting of argument to kernel in clSetKernelArg() failed.\n");
 
-	localWorkSize[0] = 1;
-	globalWorkSize[0] = outputFilesize;
+}
+
+// execute 1d kernel, one work-item per unit of work with the work-group size left to the runtime
+void GPU::execute1DKernel(const size_t numWorkItems) {
 
-	retVal = clEnqueueNDRangeKernel(commandQueue, kernel, GPU_ONE_DIMENSION, NULL, globalWorkSize, localWorkSize, 0, NULL, NULL);
+	size_t globalWorkSize[GPU_ONE_DIMENSION] = { numWorkItems };
+
+	retVal = clEnqueueNDRangeKernel(commandQueue, kernel, GPU_ONE_DIMENSION, NULL, globalWorkSize, NULL, 0, NULL, NULL);
 	if (retVal != 0)
 		throw GPUException("Error: Execution of 1-dim kernel in clEnqueueNDRangeKernel() failed.\n");
 
@@ -238,12 +298,344 @@ void GPU::execute2DKernel(const int* globalWorkSize, const int* localWorkSize) {
 
 }
 
-// free mem object
+// free mem object, returning it to the pool
 void GPU::freeMemObject(cl_mem& memObject) {
 
-	retVal = clReleaseMemObject(memObject);
+	releaseBuffer(memObject);
+	memObject = NULL;
+
+}
+
+/**
+Set a buffer parameter of every kernel. The contents are uploaded only if they differ from the last upload, into a
+buffer from the pool, and the kernels are rebound only if the buffer changed, so constant tables go up once per process
+and round keys once per key.
+
+@param argNum (IN) Kernel argument number.
+@param data (IN) Contents.
+@param len (IN) Bytes of contents.
+
+@throw Throws GPUException() if the buffer could not be created or written.
+*/
+void GPU::setBufferParam(const int argNum, const void* data, const size_t len) {
+
+	GPUParam* param = nullptr;
+	cl_mem previous = NULL;
+
+	for (GPUParam& existing : params)
+		if (existing.argNum == argNum)
+			param = &existing;
+	if (!param) {
+		params.push_back({ argNum, NULL, std::vector<byte>() });
+		param = &params.back();
+	}
+
+	// unchanged
+	if (param->buffer && (param->value.size() == len) && (memcmp(param->value.data(), data, len) == 0))
+		return;
+
+	// new size needs another buffer
+	if (param->buffer && (param->value.size() != len)) {
+		previous = param->buffer;
+		param->buffer = NULL;
+	}
+	if (!param->buffer)
+		param->buffer = acquireBuffer(len, CL_MEM_READ_ONLY);
+	if (previous)
+		releaseBuffer(previous);
+
+	retVal = clEnqueueWriteBuffer(commandQueue, param->buffer, CL_TRUE, 0, len, data, 0, NULL, NULL);
+	if (retVal != 0)
+		throw GPUException("Error: Queueing write to buffer in clEnqueueWriteBuffer() failed.\n");
+	param->value.assign((const byte*)data, (const byte*)data + len);
+
+	bindParam(argNum, sizeof(cl_mem), &param->buffer);
+
+}
+
+/**
+Set a scalar parameter of every kernel, binding it only if the value changed.
+
+@param argNum (IN) Kernel argument number.
+@param argSize (IN) Bytes of value.
+@param arg (IN) Value.
+
+@throw Throws GPUException() if the parameter could not be set.
+*/
+void GPU::setScalarParam(const int argNum, const size_t argSize, const void* arg) {
+
+	GPUParam* param = nullptr;
+
+	for (GPUParam& existing : params)
+		if (existing.argNum == argNum)
+			param = &existing;
+	if (!param) {
+		params.push_back({ argNum, NULL, std::vector<byte>() });
+		param = &params.back();
+	}
+	else if ((param->value.size() == argSize) && (memcmp(param->value.data(), arg, argSize) == 0))
+		return;
+
+	param->value.assign((const byte*)arg, (const byte*)arg + argSize);
+	bindParam(argNum, argSize, arg);
+
+}
+
+/**
+Create the streaming pipeline: GPU_NUM_STREAMS command queues, each with its own kernel, a pinned host buffer and a
+device buffer of chunkBytes bound to the kernel. Host memory stays at a few chunks whatever the size of the data
+streamed. An existing pipeline with chunks at least as large is kept, so a batch of files builds it once.
+
+@param chunkBytes (IN) Bytes per chunk.
+@param bufferArgNum (IN) Kernel argument number of the data buffer.
+
+@throw Throws GPUException() if a queue, kernel or buffer could not be created.
+*/
+void GPU::createStreams(const size_t chunkBytes, const int bufferArgNum) {
+
+	size_t sizeClass = GPU_MIN_BUFFER_BYTES;
+
+	// chunks grow in powers of 2, so a batch of small files rebuilds the pipeline a few times at most
+	while (sizeClass < chunkBytes)
+		sizeClass <<= 1;
+	if (!streams.empty() && (streamBytes >= chunkBytes))
+		return;
+	releaseStreams();
+	streamBytes = sizeClass;
+	streamBufferArgNum = bufferArgNum;
+
+	for (int i = 0; i < GPU_NUM_STREAMS; i++) {
+		GPUStream stream = { NULL, NULL, NULL, NULL, nullptr, NULL };
+		streams.push_back(stream);
+		GPUStream& added = streams.back();
+
+		added.queue = clCreateCommandQueue(context, deviceGPUId, 0, &retVal);
+		if (retVal != 0)
+			throw GPUException("Error: Creating command queue in clCreateCommandQueue() failed.\n");
+		added.kernel = clCreateKernel(program, kernelName, &retVal);
+		if (retVal != 0)
+			throw GPUException("Error: Creating kernel from function in clCreateKernel() failed.\n");
+
+		// pinned staging buffer, mapped once so the host fills and drains it directly
+		added.pinnedBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, sizeClass, NULL, &retVal);
+		if (retVal != 0)
+			throw GPUException("Error: Creating memory buffer in clCreateBuffer() failed.\n");
+		added.hostData = (byte*)clEnqueueMapBuffer(added.queue, added.pinnedBuffer, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, sizeClass, 0, NULL, NULL, &retVal);
+		if (retVal != 0)
+			throw GPUException("Error: Mapping of memory buffer in clEnqueueMapBuffer() failed.\n");
+
+		// data buffer and the shared parameters set so far, bound once
+		added.deviceBuffer = acquireBuffer(sizeClass, CL_MEM_READ_WRITE);
+		retVal = clSetKernelArg(added.kernel, bufferArgNum, sizeof(cl_mem), &added.deviceBuffer);
+		if (retVal != 0)
+			throw GPUException("Error: Setting of argument to kernel in clSetKernelArg() failed.\n");
+		for (const GPUParam& param : params) {
+			if (param.buffer)
+				retVal = clSetKernelArg(added.kernel, param.argNum, sizeof(cl_mem), &param.buffer);
+			else
+				retVal = clSetKernelArg(added.kernel, param.argNum, param.value.size(), param.value.data());
+			if (retVal != 0)
+				throw GPUException("Error: Setting of argument to kernel in clSetKernelArg() failed.\n");
+		}
+	}
+
+}
+
+/**
+Get number of streams.
+
+@return Number of streams created, 0 before createStreams().
+*/
+int GPU::getNumStreams() const {
+	return (int)streams.size();
+}
+
+/**
+Get pinned host buffer of a stream. It must not be touched between enqueueStream() and finishStream().
+
+@param stream (IN) Stream number.
+
+@return Host buffer of the chunk size.
+*/
+byte* GPU::getStreamData(const int stream) {
+	return streams[stream].hostData;
+}
+
+/**
+Set a parameter of one stream's kernel only, such as the position of its next chunk.
+
+@param stream (IN) Stream number, not in flight.
+@param argNum (IN) Kernel argument number.
+@param argSize (IN) Bytes of value.
+@param arg (IN) Value.
+
+@throw Throws GPUException() if the parameter could not be set.
+*/
+void GPU::setStreamParam(const int stream, const int argNum, const size_t argSize, const void* arg) {
+
+	retVal = clSetKernelArg(streams[stream].kernel, argNum, argSize, arg);
+	if (retVal != 0)
+		throw GPUException("Error: Setting of argument to kernel in clSetKernelArg() failed.\n");
+
+}
+
+/**
+Queue upload of a stream's host buffer, the stream's kernel with the parameters currently bound, and download back into
+the host buffer, without waiting. Streams run on their own queues, so one stream's transfers overlap another's kernel.
+The kernel is launched with the tuned work-group size and units of work per work-item, see tuneLaunch().
+
+@param stream (IN) Stream number, not already in flight.
+@param len (IN) Bytes of host buffer to process.
+@param numWorkUnits (IN) Units of work in the host buffer, such as cipher blocks.
+
+@throw Throws GPUException() if a command could not be queued.
+*/
+void GPU::enqueueStream(const int stream, const size_t len, const size_t numWorkUnits) {
+
+	GPUStream& current = streams[stream];
+	size_t globalWorkSize[GPU_ONE_DIMENSION] = { getWorkItems(numWorkUnits, localWorkSize, unitsPerWorkItem) };
+	size_t localWorkSizes[GPU_ONE_DIMENSION] = { localWorkSize };
+
+	retVal = clEnqueueWriteBuffer(current.queue, current.deviceBuffer, CL_FALSE, 0, len, current.hostData, 0, NULL, NULL);
+	if (retVal != 0)
+		throw GPUException("Error: Queueing write to buffer in clEnqueueWriteBuffer() failed.\n");
+
+	retVal = clEnqueueNDRangeKernel(current.queue, current.kernel, GPU_ONE_DIMENSION, NULL, globalWorkSize, localWorkSize ? localWorkSizes : NULL, 0, NULL, NULL);
+	if (retVal != 0)
+		throw GPUException("Error: Execution of 1-dim kernel in clEnqueueNDRangeKernel() failed.\n");
+
+	retVal = clEnqueueReadBuffer(current.queue, current.deviceBuffer, CL_FALSE, 0, len, current.hostData, 0, NULL, &current.readEvent);
+	if (retVal != 0)
+		throw GPUException("Error: Queueing read of buffer in clEnqueueReadBuffer() failed.\n");
+
+	// start the queue without waiting on it
+	clFlush(current.queue);
+
+}
+
+/**
+Wait until a stream's download is complete, its host buffer then holds the result.
+
+@param stream (IN) Stream number, in flight.
+
+@throw Throws GPUException() if the stream failed.
+*/
+void GPU::finishStream(const int stream) {
+
+	GPUStream& current = streams[stream];
+
+	retVal = clWaitForEvents(1, &current.readEvent);
+	clReleaseEvent(current.readEvent);
+	current.readEvent = NULL;
+	if (retVal != 0)
+		throw GPUException("Error: Waiting for stream in clWaitForEvents() failed.\n");
+
+}
+
+/**
+Release all streams, waiting for any still in flight.
+*/
+void GPU::releaseStreams() {
+
+	for (GPUStream& stream : streams) {
+		if (stream.queue)
+			clFinish(stream.queue);
+		if (stream.readEvent)
+			clReleaseEvent(stream.readEvent);
+		if (stream.hostData)
+			clEnqueueUnmapMemObject(stream.queue, stream.pinnedBuffer, stream.hostData, 0, NULL, NULL);
+		if (stream.queue)
+			clFinish(stream.queue);
+		if (stream.pinnedBuffer)
+			clReleaseMemObject(stream.pinnedBuffer);
+		if (stream.deviceBuffer)
+			releaseBuffer(stream.deviceBuffer);
+		if (stream.kernel)
+			clReleaseKernel(stream.kernel);
+		if (stream.queue)
+			clReleaseCommandQueue(stream.queue);
+	}
+	streams.clear();
+	streamBytes = 0;
+
+}
+
+/**
+Check if the launch configuration has been tuned or loaded.
+
+@return True once tuneLaunch() has run.
+*/
+bool GPU::isLaunchTuned() const {
+	return launchTuned;
+}
+
+/**
+Pick the work-group size and units of work per work-item of the streamed kernel, once per device. A configuration
+cached for the device name is used if there is one. Otherwise each work-group size from the kernel's preferred multiple
+up to the device and kernel maximum, in powers of 2, is timed with 1 to GPU_TUNE_MAX_UNITS_PER_ITEM units per
+work-item, and the fastest is cached. The kernel must process its units in a grid-stride loop, so any global size
+covers the data. Stream 0's kernel runs the sample with the parameters bound to it, which must describe sampleBytes.
+
+@param sampleBytes (IN) Bytes of sample data.
+@param numWorkUnits (IN) Units of work in the sample.
+
+@throw Throws GPUException() if the device limits could not be queried or no configuration ran.
+*/
+void GPU::tuneLaunch(const size_t sampleBytes, const size_t numWorkUnits) {
+
+	size_t maxDeviceSize = 0, maxKernelSize = 0, multiple = 0, maxSize;
+	size_t bestLocal = 0, bestUnits = 1;
+	double fastest = -1, elapsed;
+	cl_command_queue tuneQueue;
+	cl_mem sample;
+
+	if (launchTuned)
+		return;
+	launchTuned = true;
+	if (loadLaunchConfig())
+		return;
+
+	// work-group sizes allowed by device and kernel
+	retVal = clGetDeviceInfo(deviceGPUId, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &maxDeviceSize, NULL);
 	if (retVal != 0)
-		throw GPUException("Error: Freeing of memory object in clReleaseMemObject() failed.\n");
+		throw GPUException("Error: Getting maximum work-group size in clGetDeviceInfo() failed.\n");
+	retVal = clGetKernelWorkGroupInfo(streams[0].kernel, deviceGPUId, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &maxKernelSize, NULL);
+	if (retVal == 0)
+		retVal = clGetKernelWorkGroupInfo(streams[0].kernel, deviceGPUId, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, sizeof(size_t), &multiple, NULL);
+	if (retVal != 0)
+		throw GPUException("Error: Getting kernel work-group size in clGetKernelWorkGroupInfo() failed.\n");
+	maxSize = std::max((size_t)1, std::min(maxDeviceSize, maxKernelSize));
+	if ((multiple == 0) || (multiple > maxSize))
+		multiple = maxSize;
+
+	// time on a profiling queue, with a sample buffer bound in place of the stream's own
+	tuneQueue = clCreateCommandQueue(context, deviceGPUId, CL_QUEUE_PROFILING_ENABLE, &retVal);
+	if (retVal != 0)
+		throw GPUException("Error: Creating command queue in clCreateCommandQueue() failed.\n");
+	sample = acquireBuffer(sampleBytes, CL_MEM_READ_WRITE);
+	retVal = clSetKernelArg(streams[0].kernel, streamBufferArgNum, sizeof(cl_mem), &sample);
+	for (size_t local = multiple; (retVal == 0) && (local <= maxSize); local <<= 1) {
+		for (size_t units = 1; units <= GPU_TUNE_MAX_UNITS_PER_ITEM; units <<= 1) {
+			elapsed = timeLaunch(tuneQueue, numWorkUnits, local, units);
+			if ((elapsed >= 0) && ((fastest < 0) || (elapsed < fastest))) {
+				fastest = elapsed;
+				bestLocal = local;
+				bestUnits = units;
+			}
+		}
+	}
+	if (retVal == 0)
+		retVal = clSetKernelArg(streams[0].kernel, streamBufferArgNum, sizeof(cl_mem), &streams[0].deviceBuffer);
+	releaseBuffer(sample);
+	clReleaseCommandQueue(tuneQueue);
+	if (retVal != 0)
+		throw GPUException("Error: Setting of argument to kernel in clSetKernelArg() failed.\n");
+	if (fastest < 0)
+		throw GPUException("Error: Tuning of 1-dim kernel in clEnqueueNDRangeKernel() failed.\n");
+
+	localWorkSize = bestLocal;
+	unitsPerWorkItem = bestUnits;
+	saveLaunchConfig();
 
 }
 
@@ -251,45 +643,316 @@ void GPU::freeMemObject(cl_mem& memObject) {
 /* PRIVATE */
 /////////////
 
-// check if file exists
-bool GPU::fileExists() {
-	struct stat buffer;
-	return (stat(filename, &buffer) == 0);
+/**
+Take a device buffer from the pool, creating one of the next power of 2 size if none is free.
+
+@param bytes (IN) Bytes needed.
+@param flags (IN) Memory flags.
+
+@return Buffer of at least bytes.
+
+@throw Throws GPUException() if the buffer could not be created.
+*/
+cl_mem GPU::acquireBuffer(const size_t bytes, const int flags) {
+
+	size_t sizeClass = GPU_MIN_BUFFER_BYTES;
+	cl_mem buffer;
+
+	while (sizeClass < bytes)
+		sizeClass <<= 1;
+
+	for (GPUPooledBuffer& pooled : bufferPool) {
+		if (!pooled.inUse && (pooled.size == sizeClass) && (pooled.flags == flags)) {
+			pooled.inUse = true;
+			return pooled.buffer;
+		}
+	}
+
+	buffer = clCreateBuffer(context, flags, sizeClass, NULL, &retVal);
+	if (retVal != 0)
+		throw GPUException("Error: Creating memory buffer in clCreateBuffer() failed.\n");
+	bufferPool.push_back({ buffer, sizeClass, flags, true });
+
+	return buffer;
+
+}
+
+/**
+Return a device buffer to the pool.
+
+@param buffer (IN) Buffer from acquireBuffer().
+*/
+void GPU::releaseBuffer(const cl_mem& buffer) {
+
+	for (GPUPooledBuffer& pooled : bufferPool)
+		if (pooled.buffer == buffer)
+			pooled.inUse = false;
+
+}
+
+/**
+Free all pooled buffers and the parameters held in them.
+*/
+void GPU::releasePool() {
+
+	for (GPUPooledBuffer& pooled : bufferPool)
+		clReleaseMemObject(pooled.buffer);
+	bufferPool.clear();
+	params.clear();
+
+}
+
+/**
+Bind a parameter to the kernel and the kernel of every stream.
+
+@param argNum (IN) Kernel argument number.
+@param argSize (IN) Bytes of value.
+@param arg (IN) Value.
+
+@throw Throws GPUException() if the parameter could not be set.
+*/
+void GPU::bindParam(const int argNum, const size_t argSize, const void* arg) {
+
+	addKernelParam(argNum, argSize, arg);
+	for (int stream = 0; stream < (int)streams.size(); stream++)
+		setStreamParam(stream, argNum, argSize, arg);
+
 }
 
-// get file size
-size_t GPU::getFilesize() {
+/**
+Get global work size of a launch: enough work-items for the units of work, rounded up to whole work-groups.
 
-	size_t size;
-	std::fstream fileStream;
+@param numWorkUnits (IN) Units of work.
+@param local (IN) Work-group size, 0 if left to the runtime.
+@param units (IN) Units of work per work-item.
 
-	// open file
-	fileStream.open(filename, std::fstream::in | std::fstream::binary);
+@return Number of work-items.
+*/
+size_t GPU::getWorkItems(const size_t numWorkUnits, const size_t local, const size_t units) const {
 
-	// get length of file
-	fileStream.seekg(0, fileStream.end);
-	size = fileStream.tellg();
-	fileStream.seekg(0, fileStream.beg);
+	size_t items = (numWorkUnits + units - 1) / units;
 
-	// close file
-	fileStream.close();
+	if (local)
+		items = (items + local - 1) / local * local;
+	return std::max(items, (size_t)1);
 
-	// return
-	return size;
 }
 
-// read file data to buffer
-void GPU::readFileToBuffer() {
+/**
+Time a launch configuration of stream 0's kernel, after one untimed warm-up run.
+
+@param queue (IN) Command queue with profiling enabled.
+@param numWorkUnits (IN) Units of work.
+@param local (IN) Work-group size.
+@param units (IN) Units of work per work-item.
+
+@return Fastest kernel time of GPU_TUNE_RUNS runs in nanoseconds, negative if the device rejected the configuration.
+*/
+double GPU::timeLaunch(cl_command_queue queue, const size_t numWorkUnits, const size_t local, const size_t units) {
+
+	size_t globalWorkSize[GPU_ONE_DIMENSION] = { getWorkItems(numWorkUnits, local, units) };
+	size_t localWorkSizes[GPU_ONE_DIMENSION] = { local };
+	double fastest = -1;
+	cl_ulong startTime, endTime;
+	cl_event event;
+	cl_int status;
+
+	for (int run = 0; run <= GPU_TUNE_RUNS; run++) {
+		status = clEnqueueNDRangeKernel(queue, streams[0].kernel, GPU_ONE_DIMENSION, NULL, globalWorkSize, localWorkSizes, 0, NULL, &event);
+		if (status != 0)
+			return -1;
+		status = clWaitForEvents(1, &event);
+		if (status == 0)
+			status = clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &startTime, NULL);
+		if (status == 0)
+			status = clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &endTime, NULL);
+		clReleaseEvent(event);
+		if (status != 0)
+			return -1;
+
+		// first run warms up
+		if ((run > 0) && ((fastest < 0) || ((double)(endTime - startTime) < fastest)))
+			fastest = (double)(endTime - startTime);
+	}
 
-	std::fstream fileStream = {};
+	return fastest;
 
-	// open file
-	fileStream.open(filename, std::fstream::in | std::fstream::binary);
-	fileStream.seekg(0, fileStream.beg);
+}
+
+/**
+Load the launch configuration cached for this device, the last line naming it.
+
+@return True if one was found.
+*/
+bool GPU::loadLaunchConfig() {
+
+	char path[GPU_MAX_PATH_SIZE];
+	char line[GPU_MAX_NAME_SIZE + 64];
+	char name[GPU_MAX_NAME_SIZE];
+	size_t local, units;
+	bool found = false;
+	FILE* file;
+
+	if (!getCachePath(GPU_TUNE_FILENAME, path, sizeof(path)) || !(file = fopen(path, "r")))
+		return false;
+
+	// lines of work-group size, units per work-item and device name
+	while (fgets(line, sizeof(line), file)) {
+		name[0] = 0;
+		if ((sscanf(line, "%zu %zu %255[^\n]", &local, &units, name) == 3) && (strcmp(name, deviceName) == 0) && (local > 0) && (units > 0)) {
+			localWorkSize = local;
+			unitsPerWorkItem = units;
+			found = true;
+		}
+	}
+	fclose(file);
+
+	return found;
+
+}
 
-	// read
-	fileStream.read(fileBuffer.get(), filesize);
+/**
+Append the launch configuration of this device to the cache. A cache that cannot be written only costs tuning again.
+*/
+void GPU::saveLaunchConfig() {
+
+	char path[GPU_MAX_PATH_SIZE];
+	FILE* file;
+
+	if (!getCachePath(GPU_TUNE_FILENAME, path, sizeof(path)) || !(file = fopen(path, "a")))
+		return;
+	fprintf(file, "%zu %zu %s\n", localWorkSize, unitsPerWorkItem, deviceName);
+	fclose(file);
+
+}
+
+/**
+Get path of a file in the per-user cache directory, creating the directory if needed: GPU_CACHE_DIRNAME in
+%LOCALAPPDATA% on Windows, in $XDG_CACHE_HOME or ~/.cache elsewhere.
+
+@param name (IN) Filename.
+@param path (OUT) Path.
+@param pathSize (IN) Bytes of path buffer.
+
+@return True if there is a cache directory.
+*/
+bool GPU::getCachePath(const char* name, char* path, const size_t pathSize) {
+
+	char dir[GPU_MAX_PATH_SIZE];
+	int len;
+
+#ifdef _WIN32
+	const char* base = getenv("LOCALAPPDATA");
+	if (!base || !*base)
+		return false;
+	len = snprintf(dir, sizeof(dir), "%s\\%s", base, GPU_CACHE_DIRNAME);
+	if ((len < 0) || (len >= (int)sizeof(dir)))
+		return false;
+	_mkdir(dir);
+	len = snprintf(path, pathSize, "%s\\%s", dir, name);
+#else
+	const char* base = getenv("XDG_CACHE_HOME");
+	const char* home = getenv("HOME");
+	if (base && *base)
+		len = snprintf(dir, sizeof(dir), "%s", base);
+	else if (home && *home)
+		len = snprintf(dir, sizeof(dir), "%s/.cache", home);
+	else
+		return false;
+	if ((len < 0) || (len >= (int)sizeof(dir)))
+		return false;
+	mkdir(dir, 0755);
+	len = snprintf(dir, sizeof(dir), "%s/%s", (base && *base) ? base : home, (base && *base) ? GPU_CACHE_DIRNAME : ".cache/" GPU_CACHE_DIRNAME);
+	if ((len < 0) || (len >= (int)sizeof(dir)))
+		return false;
+	mkdir(dir, 0755);
+	len = snprintf(path, pathSize, "%s/%s", dir, name);
+#endif
+
+	return (len > 0) && (len < (int)pathSize);
+
+}
+
+/**
+Create the program from a cached device build.
+
+@param path (IN) Cache file.
+
+@return True if the binary was accepted and built, false to compile the source instead.
+*/
+bool GPU::loadProgramBinary(const char* path) {
+
+	std::vector<byte> binary;
+	const byte* binaryData;
+	size_t binarySize;
+	cl_int binaryStatus = -1;
+	long fileSize;
+	FILE* file;
+
+	if (!(file = fopen(path, "rb")))
+		return false;
+	if ((fseek(file, 0, SEEK_END) == 0) && ((fileSize = ftell(file)) > 0) && (fseek(file, 0, SEEK_SET) == 0)) {
+		binary.resize((size_t)fileSize);
+		if (fread(binary.data(), 1, binary.size(), file) != binary.size())
+			binary.clear();
+	}
+	fclose(file);
+	if (binary.empty())
+		return false;
+
+	binaryData = binary.data();
+	binarySize = binary.size();
+	program = clCreateProgramWithBinary(context, 1, &deviceGPUId, &binarySize, &binaryData, &binaryStatus, &retVal);
+	if ((retVal != 0) || (binaryStatus != 0)) {
+		if (program)
+			clReleaseProgram(program);
+		program = NULL;
+		return false;
+	}
+
+	// a binary still has to be built, which only links it
+	retVal = clBuildProgram(program, 1, &deviceGPUId, NULL, NULL, NULL);
+	if (retVal != 0) {
+		clReleaseProgram(program);
+		program = NULL;
+		return false;
+	}
+
+	return true;
+
+}
+
+/**
+Save the device build of the program to the cache. It is written under a temporary name and renamed, so a concurrent
+run never loads half a binary; a cache that cannot be written only costs compiling again.
+
+@param path (IN) Cache file.
+*/
+void GPU::saveProgramBinary(const char* path) {
+
+	char tempPath[GPU_MAX_PATH_SIZE];
+	std::vector<byte> binary;
+	byte* binaryData;
+	size_t binarySize = 0;
+	bool written;
+	FILE* file;
+
+	if ((clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binarySize, NULL) != 0) || (binarySize == 0))
+		return;
+	binary.resize(binarySize);
+	binaryData = binary.data();
+	if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(byte*), &binaryData, NULL) != 0)
+		return;
+
+	if ((snprintf(tempPath, sizeof(tempPath), "%s.tmp", path) >= (int)sizeof(tempPath)) || !(file = fopen(tempPath, "wb")))
+		return;
+	written = fwrite(binary.data(), 1, binary.size(), file) == binary.size();
+	written = (fclose(file) == 0) && written;
+#ifdef _WIN32
+	if (written)
+		remove(path);
+#endif
+	if (!written || (rename(tempPath, path) != 0))
+		remove(tempPath);
 
-	// close file
-	fileStream.close();
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <fstream>
 #include <memory>
+#include <vector>
 #include <CL/cl.h>
 #include "Exceptions.h"
 
@@ -19,23 +20,63 @@
 #define GPU_ONE_DIMENSION 1
 #define GPU_TWO_DIMENSION 2
 #define GPU_MAX_NAME_SIZE 256
-#define GPU_KERNEL_FILENAME "kernel.cl"
 #define GPU_KERNEL_FUNC_NAME "encrypt"
+#define GPU_NUM_STREAMS 3 // chunks in flight: one uploading, one computing, one downloading
+#define GPU_STREAM_CHUNK_BYTES (16 * 1024 * 1024) // bytes per streamed chunk, a multiple of 16
+#define GPU_MIN_BUFFER_BYTES 4096 // smallest buffer size class of the pool, buffers are pooled in powers of 2
+#define GPU_MAX_PATH_SIZE 4096
+#define GPU_CACHE_DIRNAME "saes" // directory of the per-user cache, in the platform cache directory
+#define GPU_TUNE_FILENAME "launch.tune" // tuned launch configurations, one line per device name
+#define GPU_BINARY_FILENAME_FORMAT "kernel-%016llx.bin" // device build of the program, named by cache key
+#define GPU_TUNE_BYTES (4 * 1024 * 1024) // bytes of data per measured launch configuration
+#define GPU_TUNE_RUNS 3 // timed runs per launch configuration, the fastest counts
+#define GPU_TUNE_MAX_UNITS_PER_ITEM 8 // most units of work per work-item tried, in powers of 2
 
 typedef unsigned char byte;
 
+// one stage of the streaming pipeline: its own command queue and kernel, a pinned host buffer mapped for its lifetime and
+// a device buffer of the same size, bound to the kernel once
+struct GPUStream {
+	cl_command_queue queue;
+	cl_kernel kernel;
+	cl_mem pinnedBuffer;
+	cl_mem deviceBuffer;
+	byte* hostData;
+	cl_event readEvent;
+};
+
+// device buffer of the pool, kept for reuse by any request of the same size class and flags
+struct GPUPooledBuffer {
+	cl_mem buffer;
+	size_t size;
+	int flags;
+	bool inUse;
+};
+
+// kernel parameter shared by all kernels, bound once and changed only when its value does. A buffer parameter keeps a
+// host copy of its contents, so uploading the same table or key again costs a compare.
+struct GPUParam {
+	int argNum;
+	cl_mem buffer;
+	std::vector<byte> value;
+};
+
 class GPU {
 
 public:
 
 	// constructor
-	GPU(const char*);
+	GPU(const char*, const size_t);
 
 	//destructor
 	~GPU();
 
-	// build program from file
-	void buildProgram(std::unique_ptr<byte[]>&);
+	// find device
+	void findDevice(std::unique_ptr<byte[]>&);
+
+	// build program from cache or source
+	void buildProgram();
+	bool isProgramBuilt() const;
 
 	// create kernel from program
 	void createKernelFromProgram(const char*);
@@ -49,8 +90,11 @@ public:
 	// add kernel parameter
 	void addKernelParam(const int, const cl_mem&);
 
+	// add scalar kernel parameter
+	void addKernelParam(const int, const size_t, const void*);
+
 	// execute 1d kernel
-	void execute1DKernel(const int);
+	void execute1DKernel(const size_t);
 
 	// execute 2d kernel
 	void execute2DKernel(const int*, const int*);
@@ -58,29 +102,65 @@ public:
 	// free mem object
 	void freeMemObject(cl_mem&);
 
+	// persistent kernel parameters
+	void setBufferParam(const int, const void*, const size_t);
+	void setScalarParam(const int, const size_t, const void*);
+
+	// streaming pipeline
+	void createStreams(const size_t, const int);
+	int getNumStreams() const;
+	byte* getStreamData(const int);
+	void setStreamParam(const int, const int, const size_t, const void*);
+	void enqueueStream(const int, const size_t, const size_t);
+	void finishStream(const int);
+	void releaseStreams();
+
+	// launch configuration
+	bool isLaunchTuned() const;
+	void tuneLaunch(const size_t, const size_t);
+
 private:
 
-	// check if file exists
-	bool fileExists();
+	// buffer pool
+	cl_mem acquireBuffer(const size_t, const int);
+	void releaseBuffer(const cl_mem&);
+	void releasePool();
+
+	// bind a parameter to the kernel of every stream
+	void bindParam(const int, const size_t, const void*);
 
-	// get file size
-	size_t getFilesize();
+	// launch configuration
+	size_t getWorkItems(const size_t, const size_t, const size_t) const;
+	double timeLaunch(cl_command_queue, const size_t, const size_t, const size_t);
+	bool loadLaunchConfig();
+	void saveLaunchConfig();
+	bool getCachePath(const char*, char*, const size_t);
 
-	// read file data to buffer
-	void readFileToBuffer();
+	// program binary cache
+	bool loadProgramBinary(const char*);
+	void saveProgramBinary(const char*);
 
+	const char* source;
+	size_t sourceSize;
 	std::unique_ptr<cl_platform_id[]> platformIds;
-	std::unique_ptr<char[]> fileBuffer;
+	std::vector<GPUStream> streams;
+	std::vector<GPUPooledBuffer> bufferPool;
+	std::vector<GPUParam> params;
+	const char* kernelName;
+	size_t streamBytes;
+	int streamBufferArgNum;
+	size_t localWorkSize;
+	size_t unitsPerWorkItem;
+	bool launchTuned;
+	char deviceName[GPU_MAX_NAME_SIZE];
 	cl_device_id deviceGPUId;
 	cl_command_queue commandQueue;
 	cl_program program;
 	cl_context context;
 	cl_kernel kernel;
-	const char* filename;
 	cl_uint retNumPlatforms;
 	cl_uint retNumDevices;
 	cl_int retVal;
-	size_t filesize;
 
 };
 
@@ -0,0 +1,179 @@
+#ifndef GPUKERNEL_H
+#define GPUKERNEL_H
+
+// OpenCL source of the GPU cipher kernel, compiled into the program so no kernel file has to ship next to it. The
+// device build is cached per device, driver and source hash, see GPU::buildProgram().
+static const char gpuKernelSource[] = R"SAESCL(
+#define xtime(x) ((x<<1) ^ (((x>>7) & 1) * 0x1b))
+#define SAES_BLOCK_BYTES 16
+#define SAES_NONCE_SIZE_BYTES 8
+#define SAES_LOOKUP_TABLE_SIZE 256
+#define ROW_COL_LEN 4
+#define STATE_SIZE ROW_COL_LEN*ROW_COL_LEN
+
+/**
+Shift rows in state to the left with different offsets where offset is row number.
+
+@param stateMatrix (IN/OUT) State, row-major.
+*/
+void shiftRows(__private uchar* stateMatrix)
+{
+	__private int row2 = ROW_COL_LEN * 1;
+	__private int row3 = ROW_COL_LEN * 2;
+	__private int row4 = ROW_COL_LEN * 3;
+	__private uchar temp;
+
+	// rotate first row 1 columns to left
+	temp = stateMatrix[row2];
+	stateMatrix[row2] = stateMatrix[row2 + 1];
+	stateMatrix[row2 + 1] = stateMatrix[row2 + 2];
+	stateMatrix[row2 + 2] = stateMatrix[row2 + 3];
+	stateMatrix[row2 + 3] = temp;
+
+	// rotate second row 2 columns to left
+	temp = stateMatrix[row3];
+	stateMatrix[row3] = stateMatrix[row3 + 2];
+	stateMatrix[row3 + 2] = temp;
+
+	temp = stateMatrix[row3 + 1];
+	stateMatrix[row3 + 1] = stateMatrix[row3 + 3];
+	stateMatrix[row3 + 3] = temp;
+
+	// rotate third row 3 columns to left
+	temp = stateMatrix[row4];
+	stateMatrix[row4] = stateMatrix[row4 + 3];
+	stateMatrix[row4 + 3] = stateMatrix[row4 + 2];
+	stateMatrix[row4 + 2] = stateMatrix[row4 + 1];
+	stateMatrix[row4 + 1] = temp;
+
+}
+
+/**
+Add round key to current state.
+
+@param stateMatrix (IN/OUT) State, row-major.
+@param roundKeys (IN) Round keys, 16 bytes per round, row-major as the state.
+@param roundNum (IN) Index of round key to be added.
+*/
+void addRoundKey(__private uchar* stateMatrix, __constant const uchar* roundKeys, __private const int roundNum)
+{
+	for (int i = 0; i < STATE_SIZE; i++)
+		stateMatrix[i] ^= roundKeys[roundNum * STATE_SIZE + i];
+}
+
+/**
+Mix columns of the current state.
+
+@param stateMatrix (IN/OUT) State, row-major.
+*/
+void mixColumns(__private uchar* stateMatrix)
+{
+	__private int row1 = 0;
+	__private int row2 = ROW_COL_LEN * 1;
+	__private int row3 = ROW_COL_LEN * 2;
+	__private int row4 = ROW_COL_LEN * 3;
+	__private uchar Tmp, Tm, t;
+
+	// process all element's in columns
+	for (__private int i = 0; i < ROW_COL_LEN; i++)
+	{
+		t = stateMatrix[row1 + i];
+		Tmp = stateMatrix[row1 + i] ^ stateMatrix[row2 + i] ^ stateMatrix[row3 + i] ^ stateMatrix[row4 + i];
+
+		Tm = stateMatrix[row1 + i] ^ stateMatrix[row2 + i];
+		Tm = xtime(Tm);
+		stateMatrix[row1 + i] ^= Tm ^ Tmp;
+
+		Tm = stateMatrix[row2 + i] ^ stateMatrix[row3 + i];
+		Tm = xtime(Tm);
+		stateMatrix[row2 + i] ^= Tm ^ Tmp;
+
+		Tm = stateMatrix[row3 + i] ^ stateMatrix[row4 + i];
+		Tm = xtime(Tm);
+		stateMatrix[row3 + i] ^= Tm ^ Tmp;
+
+		Tm = stateMatrix[row4 + i] ^ t;
+		Tm = xtime(Tm);
+		stateMatrix[row4 + i] ^= Tm ^ Tmp;
+	}
+
+}
+
+/**
+Substitute bytes in current state with those at the same index in s-box.
+
+@param stateMatrix (IN/OUT) State, row-major.
+@param sBox (IN) S-box, in local memory.
+*/
+void subBytes(__private uchar* stateMatrix, __local const uchar* sBox)
+{
+	for (int i = 0; i < STATE_SIZE; i++)
+		stateMatrix[i] = sBox[stateMatrix[i]];
+}
+
+/**
+Encrypt/decrypt data in CTR mode, in a grid-stride loop over 16-byte blocks: work-item i takes blocks i, i + global
+size, i + 2 * global size and so on, so any global size covers the data and neighbouring work-items touch neighbouring
+blocks. Block b enciphers the nonce concatenated with the big-endian counter startCounter + b and XORs the result into
+the data, so only plaintext is uploaded and only ciphertext is read back. The state is row-major (row r = block bytes
+4r..4r+3), as on the host.
+
+@param data (IN/OUT) Data to XOR with keystream.
+@param sBox (IN) An AES substitution look-up table.
+@param roundKeys (IN) Round keys, 16 bytes per round.
+@param numRounds (IN) Number of AES rounds, based on key size.
+@param nonce (IN) Nonce derived from password.
+@param startCounter (IN) Counter of the first block of data.
+@param len (IN) Bytes of data, the last block may be partial.
+*/
+__kernel void encrypt(__global uchar* data, __constant uchar* sBox, __constant uchar* roundKeys, const int numRounds, __constant uchar* nonce, const ulong startCounter, const ulong len)
+{
+	__local uchar localSBox[SAES_LOOKUP_TABLE_SIZE];
+	__private ulong stride = (ulong)get_global_size(0);
+	__private ulong block, offset, counter;
+	__private uchar stateMatrix[STATE_SIZE];
+	__private int currentRound;
+
+	// s-box lookups are data dependent, serve them from local memory
+	for (int i = get_local_id(0); i < SAES_LOOKUP_TABLE_SIZE; i += get_local_size(0))
+		localSBox[i] = sBox[i];
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// work-items past the data only helped load the s-box
+	for (block = get_global_id(0); block * SAES_BLOCK_BYTES < len; block += stride)
+	{
+		offset = block * SAES_BLOCK_BYTES;
+		counter = startCounter + block;
+
+		// concatenate nonce and counter
+		for (int i = 0; i < SAES_NONCE_SIZE_BYTES; i++) {
+			stateMatrix[i] = nonce[i];
+			stateMatrix[STATE_SIZE - 1 - i] = (uchar)(counter >> (8 * i));
+		}
+
+		// Initial addition of round key
+		addRoundKey(stateMatrix, roundKeys, 0);
+
+		// Process all rounds except last
+		for (currentRound = 1; currentRound < numRounds; currentRound++)
+		{
+			subBytes(stateMatrix, localSBox);
+			shiftRows(stateMatrix);
+			mixColumns(stateMatrix);
+			addRoundKey(stateMatrix, roundKeys, currentRound);
+		}
+
+		// Process last round
+		subBytes(stateMatrix, localSBox);
+		shiftRows(stateMatrix);
+		addRoundKey(stateMatrix, roundKeys, currentRound);
+
+		// XOR keystream into data
+		for (int i = 0; (i < STATE_SIZE) && (offset + i < len); i++)
+			data[offset + i] ^= stateMatrix[i];
+	}
+
+}
+)SAESCL";
+
+#endif
@@ -0,0 +1,247 @@
+#include "LZ4Codec.h"
+#include <string.h>
+#include <math.h>
+
+// block format limits
+#define LZ4_MIN_MATCH 4 // shortest match, stored as match length - 4
+#define LZ4_LAST_LITERALS 5 // a block ends with at least this many literals
+#define LZ4_MATCH_FIND_LIMIT 12 // the last match starts at least this far from the end
+#define LZ4_MAX_DISTANCE 65535 // 16-bit match offset
+#define LZ4_RUN_MASK 15 // 4-bit length field in the token, 15 means more length bytes follow
+#define LZ4_HASH_BITS 14 // match finder table of 2^14 positions
+#define LZ4_SKIP_TRIGGER 6 // step grows by one every 2^6 bytes without a match
+
+// load 32-bit word for matching
+static uint32_t read32(const byte* in) {
+
+	uint32_t value;
+	memcpy(&value, in, sizeof(value));
+	return value;
+
+}
+
+// hash 4 bytes into the match finder table
+static uint32_t hash32(const uint32_t value) {
+	return (value * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+/**
+Estimate whether data is worth compressing from the Shannon entropy of byte values in a sample of it.
+
+@param data (IN) Data.
+@param len (IN) Bytes of data.
+
+@return False if the sample is close to random, such as already compressed or encrypted data.
+*/
+bool LZ4Codec::isCompressible(const byte* data, const _saes64 len) {
+
+	_saes64 counts[256] = { 0 };
+	_saes64 stride = (len > SAES_COMPRESS_SAMPLE_BYTES) ? len / SAES_COMPRESS_SAMPLE_BYTES : 1;
+	_saes64 samples = 0;
+	double entropy = 0.0;
+
+	if (len == 0)
+		return false;
+
+	// spread the sample over the whole buffer
+	for (_saes64 i = 0; i < len; i += stride, samples++)
+		counts[data[i]]++;
+
+	for (int value = 0; value < 256; value++) {
+		if (counts[value]) {
+			double p = (double)counts[value] / (double)samples;
+			entropy -= p * log2(p);
+		}
+	}
+
+	return entropy < SAES_COMPRESS_ENTROPY_LIMIT;
+
+}
+
+/**
+Compress data into an LZ4 block.
+
+@param src (IN) Data.
+@param srcLen (IN) Bytes of data.
+@param dst (OUT) Compressed block.
+@param dstCapacity (IN) Bytes available at dst.
+
+@return Bytes of compressed block, 0 if it would not fit in dstCapacity.
+*/
+_saes64 LZ4Codec::compress(const byte* src, const _saes64 srcLen, byte* dst, const _saes64 dstCapacity) {
+
+	// match finder table, positions of recent 4-byte sequences
+	static thread_local uint32_t table[1 << LZ4_HASH_BITS];
+	const byte* dstEnd = dst + dstCapacity;
+	byte* op = dst;
+	_saes64 ip = 0, anchor = 0;
+	_saes64 matchFindLimit = (srcLen > LZ4_MATCH_FIND_LIMIT) ? srcLen - LZ4_MATCH_FIND_LIMIT : 0;
+	_saes64 matchLimit = (srcLen > LZ4_LAST_LITERALS) ? srcLen - LZ4_LAST_LITERALS : 0;
+
+	// positions are 32-bit
+	if (srcLen > 0xFFFFFFFFULL)
+		return 0;
+	memset(table, 0, sizeof(table));
+
+	while (ip < matchFindLimit) {
+
+		uint32_t sequence = read32(src + ip);
+		uint32_t h = hash32(sequence);
+		_saes64 ref = table[h];
+
+		table[h] = (uint32_t)ip;
+
+		// no usable match, step further the longer nothing matched
+		if ((ref >= ip) || (ip - ref > LZ4_MAX_DISTANCE) || (read32(src + ref) != sequence)) {
+			ip += 1 + ((ip - anchor) >> LZ4_SKIP_TRIGGER);
+			continue;
+		}
+
+		// extend match backwards over pending literals, then forwards
+		while ((ip > anchor) && (ref > 0) && (src[ip - 1] == src[ref - 1])) {
+			ip--;
+			ref--;
+		}
+		_saes64 matchLen = LZ4_MIN_MATCH;
+		while ((ip + matchLen < matchLimit) && (src[ref + matchLen] == src[ip + matchLen]))
+			matchLen++;
+
+		// token, literals, offset, match length
+		_saes64 literalLen = ip - anchor;
+		if (op + 1 + (literalLen / 255) + 1 + literalLen + 2 + ((matchLen - LZ4_MIN_MATCH) / 255) + 1 > dstEnd)
+			return 0;
+		byte* token = op++;
+		*token = (byte)(((literalLen >= LZ4_RUN_MASK) ? LZ4_RUN_MASK : literalLen) << 4);
+		if ((literalLen >= LZ4_RUN_MASK) && !writeLength(op, dstEnd, literalLen - LZ4_RUN_MASK))
+			return 0;
+		memcpy(op, src + anchor, (size_t)literalLen);
+		op += literalLen;
+		*op++ = (byte)((ip - ref) & 0xFF);
+		*op++ = (byte)((ip - ref) >> 8);
+		*token |= (byte)(((matchLen - LZ4_MIN_MATCH) >= LZ4_RUN_MASK) ? LZ4_RUN_MASK : (matchLen - LZ4_MIN_MATCH));
+		if (((matchLen - LZ4_MIN_MATCH) >= LZ4_RUN_MASK) && !writeLength(op, dstEnd, matchLen - LZ4_MIN_MATCH - LZ4_RUN_MASK))
+			return 0;
+
+		ip += matchLen;
+		anchor = ip;
+
+		// index a position inside the match for the next search
+		if (ip - 2 < matchFindLimit)
+			table[hash32(read32(src + ip - 2))] = (uint32_t)(ip - 2);
+
+	}
+
+	// last literals
+	_saes64 literalLen = srcLen - anchor;
+	if (op + 1 + (literalLen / 255) + 1 + literalLen > dstEnd)
+		return 0;
+	byte* token = op++;
+	*token = (byte)(((literalLen >= LZ4_RUN_MASK) ? LZ4_RUN_MASK : literalLen) << 4);
+	if ((literalLen >= LZ4_RUN_MASK) && !writeLength(op, dstEnd, literalLen - LZ4_RUN_MASK))
+		return 0;
+	memcpy(op, src + anchor, (size_t)literalLen);
+	op += literalLen;
+
+	return op - dst;
+
+}
+
+/**
+Decompress an LZ4 block, checking every length and offset against both buffers.
+
+@param src (IN) Compressed block.
+@param srcLen (IN) Bytes of compressed block.
+@param dst (OUT) Data.
+@param dstLen (IN) Bytes of data the block must produce.
+
+@return True if the block is well formed and produced exactly dstLen bytes.
+*/
+bool LZ4Codec::decompress(const byte* src, const _saes64 srcLen, byte* dst, const _saes64 dstLen) {
+
+	_saes64 ip = 0, op = 0;
+
+	for (;;) {
+
+		if (ip >= srcLen)
+			return false;
+		byte token = src[ip++];
+
+		// literals
+		_saes64 literalLen = token >> 4;
+		if (literalLen == LZ4_RUN_MASK) {
+			byte next;
+			do {
+				if (ip >= srcLen)
+					return false;
+				next = src[ip++];
+				literalLen += next;
+			} while (next == 255);
+		}
+		if ((literalLen > srcLen - ip) || (literalLen > dstLen - op))
+			return false;
+		memcpy(dst + op, src + ip, (size_t)literalLen);
+		ip += literalLen;
+		op += literalLen;
+
+		// last sequence has no match
+		if (ip == srcLen)
+			break;
+
+		// match
+		if (srcLen - ip < 2)
+			return false;
+		_saes64 offset = src[ip] | ((_saes64)src[ip + 1] << 8);
+		ip += 2;
+		if ((offset == 0) || (offset > op))
+			return false;
+		_saes64 matchLen = token & LZ4_RUN_MASK;
+		if (matchLen == LZ4_RUN_MASK) {
+			byte next;
+			do {
+				if (ip >= srcLen)
+					return false;
+				next = src[ip++];
+				matchLen += next;
+			} while (next == 255);
+		}
+		matchLen += LZ4_MIN_MATCH;
+		if (matchLen > dstLen - op)
+			return false;
+
+		// copies may overlap their source, repeating it
+		if (offset >= matchLen)
+			memcpy(dst + op, dst + op - offset, (size_t)matchLen);
+		else
+			for (_saes64 i = 0; i < matchLen; i++)
+				dst[op + i] = dst[op - offset + i];
+		op += matchLen;
+
+	}
+
+	return op == dstLen;
+
+}
+
+/**
+Write the remainder of a length that did not fit in its token field.
+
+@param op (IN/OUT) Output position, advanced.
+@param end (IN) End of output.
+@param len (IN) Length beyond the token field.
+
+@return False if the output is full.
+*/
+bool LZ4Codec::writeLength(byte*& op, const byte* end, _saes64 len) {
+
+	for (; len >= 255; len -= 255) {
+		if (op >= end)
+			return false;
+		*op++ = 255;
+	}
+	if (op >= end)
+		return false;
+	*op++ = (byte)len;
+
+	return true;
+
+}
@@ -0,0 +1,34 @@
+#ifndef LZ4CODEC_H
+#define LZ4CODEC_H
+
+#ifdef __linux__
+#include <inttypes.h>
+#endif
+#include "SAESconstants.h"
+#include <stdint.h>
+
+// LZ4 block format codec, single pass greedy compressor and bounds-checked decompressor.
+// Blocks are raw LZ4 sequences with no frame; the caller keeps compressed and original lengths. Output is readable by
+// any LZ4 block decoder, and decompress() rejects malformed input instead of reading or writing out of bounds.
+class LZ4Codec {
+
+public:
+
+	// compression
+	static bool isCompressible(const byte*, const _saes64);
+	static _saes64 compress(const byte*, const _saes64, byte*, const _saes64);
+
+	// decompression
+	static bool decompress(const byte*, const _saes64, byte*, const _saes64);
+
+private:
+
+	// constructor
+	LZ4Codec();
+
+	// sequence output
+	static bool writeLength(byte*&, const byte*, _saes64);
+
+};
+
+#endif
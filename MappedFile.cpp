@@ -0,0 +1,207 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// largest mapping attempted by a 32-bit process, leaves room in its address space for everything else
+#define MAPPEDFILE_MAX_SIZE_32BIT ((_saes64)1024 * 1024 * 1024)
+
+// constructor
+MappedFile::MappedFile() :
+	data(nullptr),
+	size(0),
+#ifdef _WIN32
+	fileHandle(INVALID_HANDLE_VALUE),
+	mappingHandle(NULL)
+#else
+	fd(-1)
+#endif
+{}
+
+// destructor
+MappedFile::~MappedFile() {
+
+	unmap();
+
+}
+
+/**
+Map whole file read-only.
+
+@param filename (IN) Name of file to map.
+
+@throw Throws FileException() if file is empty or could not be mapped.
+*/
+void MappedFile::mapInput(const char* filename) {
+
+#ifdef _WIN32
+	LARGE_INTEGER fileSize;
+
+	// open file
+	fileHandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		throw FileException("Failed to open file. Exiting program.\n");
+	if (!GetFileSizeEx((HANDLE)fileHandle, &fileSize))
+		throw FileException("Failed to stat file. Exiting program.\n");
+	size = fileSize.QuadPart;
+	if (size == 0)
+		throw FileException("Cannot encrypt an empty file. Exiting program.\n");
+
+	// map file
+	mappingHandle = CreateFileMappingA((HANDLE)fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == NULL)
+		throw FileException("Failed to memory map file. Exiting program.\n");
+	data = (byte*)MapViewOfFile((HANDLE)mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+		throw FileException("Failed to memory map file. Exiting program.\n");
+#else
+	struct stat info;
+
+	// open file
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		throw FileException("Failed to open file. Exiting program.\n");
+	if (fstat(fd, &info) != 0)
+		throw FileException("Failed to stat file. Exiting program.\n");
+	size = info.st_size;
+	if (size == 0)
+		throw FileException("Cannot encrypt an empty file. Exiting program.\n");
+
+	// map file
+	void* mapping = mmap(nullptr, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+	if (mapping == MAP_FAILED)
+		throw FileException("Failed to memory map file. Exiting program.\n");
+	data = (byte*)mapping;
+#endif
+
+	adviseSequential();
+
+}
+
+/**
+Create or truncate file, presize it and map it read-write.
+
+@param filename (IN) Name of file to create.
+@param fileSize (IN) Size of file in bytes.
+
+@throw Throws FileException() if file could not be created, sized or mapped.
+*/
+void MappedFile::mapOutput(const char* filename, const _saes64 fileSize) {
+
+	size = fileSize;
+
+#ifdef _WIN32
+	// create file
+	fileHandle = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		throw FileException("Failed to open file. Exiting program.\n");
+
+	// map file, mapping size extends file
+	mappingHandle = CreateFileMappingA((HANDLE)fileHandle, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)(size & 0xFFFFFFFF), NULL);
+	if (mappingHandle == NULL)
+		throw FileException("Failed to memory map file. Exiting program.\n");
+	data = (byte*)MapViewOfFile((HANDLE)mappingHandle, FILE_MAP_WRITE, 0, 0, 0);
+	if (data == nullptr)
+		throw FileException("Failed to memory map file. Exiting program.\n");
+#else
+	// create file
+	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		throw FileException("Failed to open file. Exiting program.\n");
+
+	// presize file
+	if (ftruncate(fd, (off_t)size) != 0)
+		throw FileException("Failed to write file. Exiting program.\n");
+
+	// map file
+	void* mapping = mmap(nullptr, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mapping == MAP_FAILED)
+		throw FileException("Failed to memory map file. Exiting program.\n");
+	data = (byte*)mapping;
+#endif
+
+	adviseSequential();
+
+}
+
+/**
+Unmap and close file. Safe to call on an unmapped file.
+*/
+void MappedFile::unmap() {
+
+#ifdef _WIN32
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+	if (mappingHandle != NULL)
+		CloseHandle((HANDLE)mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle((HANDLE)fileHandle);
+	mappingHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (data != nullptr)
+		munmap(data, (size_t)size);
+	if (fd >= 0)
+		close(fd);
+	fd = -1;
+#endif
+	data = nullptr;
+	size = 0;
+
+}
+
+/**
+Get mapped contents.
+
+@return Pointer to first byte of file.
+*/
+byte* MappedFile::getData() const {
+	return data;
+}
+
+/**
+Get mapped size.
+
+@return Size of file in bytes.
+*/
+_saes64 MappedFile::getSize() const {
+	return size;
+}
+
+/**
+Check a file of given size can be mapped whole. Always true for 64-bit processes.
+
+@param fileSize (IN) Size of file in bytes.
+
+@return True if file fits in address space.
+*/
+bool MappedFile::fitsAddressSpace(const _saes64 fileSize) {
+
+	if (sizeof(void*) >= sizeof(_saes64))
+		return true;
+
+	return fileSize <= MAPPEDFILE_MAX_SIZE_32BIT;
+
+}
+
+/**
+Hint kernel that mapping is streamed front to back once, and back it with huge pages where supported.
+*/
+void MappedFile::adviseSequential() {
+
+#ifndef _WIN32
+#ifdef MADV_SEQUENTIAL
+	madvise(data, (size_t)size, MADV_SEQUENTIAL);
+#endif
+#ifdef MADV_HUGEPAGE
+	madvise(data, (size_t)size, MADV_HUGEPAGE);
+#endif
+#endif
+
+}
@@ -0,0 +1,53 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#ifdef __linux__
+#include <inttypes.h>
+#endif
+#include "SAESconstants.h"
+#include "Exceptions.h"
+
+// memory-mapped view of a whole file
+class MappedFile {
+
+public:
+
+	// constructor
+	MappedFile();
+
+	// destructor
+	~MappedFile();
+
+	// map/unmap
+	void mapInput(const char*);
+	void mapOutput(const char*, const _saes64);
+	void unmap();
+
+	// mapped contents
+	byte* getData() const;
+	_saes64 getSize() const;
+
+	// check file can be mapped by this process
+	static bool fitsAddressSpace(const _saes64);
+
+private:
+
+	// not copyable, owns the mapping
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	// access pattern hints
+	void adviseSequential();
+
+	byte* data;
+	_saes64 size;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fd;
+#endif
+
+};
+
+#endif
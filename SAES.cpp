@@ -1,4 +1,10 @@
 #include "SAES.h"
+#include "SAEStables.h"
+#include "FastXOR.h"
+#include "FileIO.h"
+#include "SAESChunkIndex.h"
+#include "SAESAuth.h"
+#include <algorithm>
 
 // constructor
 SAES::SAES(int _keyLen, byte* _key) {
@@ -16,6 +22,12 @@ SAES::SAES(int _keyLen, byte* _key) {
 
 	// expand key
 	keyExpansion();
+	tableKeyExpansion();
+
+	// select hardware backend if available
+	aesniEnabled = AESNI::isSupported();
+	if (aesniEnabled)
+		aesni.loadRoundKeys(roundKey, numRounds);
 }
 
 /* GENERAL FUNCTIONS */
@@ -105,21 +117,6 @@ void SAES::calculateNonce(byte* nonce, const byte* password) {
 
 }
 
-/**
-Set nonce counters for all SAES file blocks.
-
-@param nonceCounterBlocks (OUT) Buffer of concatenated nonce counters.
-@param nonce (IN) Nonce derived from password.
-@param numFileBlocks (IN) Number of blocks in file.
-*/
-void SAES::setNonceCounters(std::unique_ptr<byte[]>& nonceCounterBlocks, const byte* nonce, const _saes64 numFileBlocks) {
-
-	// for all file blocks
-	for (int i = 0; i < numFileBlocks; i++)
-		concatNonceCounter(nonceCounterBlocks.get() + (i * SAES_BLOCK_BYTES), (const byte*)nonce, i);
-
-}
-
 /**
 Get file size of given stream.
 
@@ -159,24 +156,181 @@ Extract SAES file header data.
 */
 void SAES::extractFileSAESHeader(std::fstream& inFile, const _saes64 fileSize, byte* padding, byte* filenameFormat, byte* keylength) {
 
+	byte headers[SAES_HEADERS * SAES_BLOCK_BYTES];
 
-	// extract padding
-	inFile.seekg(fileSize - (SAES_BLOCK_BYTES * (SAES_HEADERS - 0)), inFile.beg);
-	inFile.read((char*)padding, SAES_BLOCK_BYTES);
-	if (inFile.gcount() != SAES_BLOCK_BYTES)
+	if (fileSize < (SAES_HEADERS * SAES_BLOCK_BYTES))
+		throw FileException("Error reading SAES header padding. Exiting program.\n");
+
+	// read all headers at once
+	inFile.seekg(fileSize - (SAES_HEADERS * SAES_BLOCK_BYTES), inFile.beg);
+	inFile.read((char*)headers, SAES_HEADERS * SAES_BLOCK_BYTES);
+	if (inFile.gcount() != (SAES_HEADERS * SAES_BLOCK_BYTES))
+		throw FileException("Error reading SAES header padding. Exiting program.\n");
+
+	// split headers
+	extractFileSAESHeader(headers, SAES_HEADERS * SAES_BLOCK_BYTES, padding, filenameFormat, keylength);
+
+}
+
+/**
+Extract SAES file header data from file contents held in memory.
+
+@param fileData (IN) File contents, such as a memory mapping of the file.
+@param fileSize (IN) Size of file held by fileData.
+@param padding (OUT) File padding needed up to SAES block size.
+@param filenameFormat (OUT) File format of original file (ie., .txt, .jpg).
+@param keylength (OUT) Key length used in encryption of original file.
+
+@throw Throws FileException() if file is too small to hold header data.
+*/
+void SAES::extractFileSAESHeader(const byte* fileData, const _saes64 fileSize, byte* padding, byte* filenameFormat, byte* keylength) {
+
+	const byte* headers = nullptr;
+
+	if (fileSize < (SAES_HEADERS * SAES_BLOCK_BYTES))
 		throw FileException("Error reading SAES header padding. Exiting program.\n");
+	headers = fileData + fileSize - (SAES_HEADERS * SAES_BLOCK_BYTES);
+
+	// extract padding
+	memcpy(padding, headers, SAES_MAX_PADDING_BYTES);
 
 	// extract file format
-	inFile.seekg(fileSize - (SAES_BLOCK_BYTES * (SAES_HEADERS - 1)), inFile.beg);
-	inFile.read((char*)filenameFormat, SAES_BLOCK_BYTES);
-	if (inFile.gcount() != SAES_BLOCK_BYTES)
-		throw FileException("Error reading SAES header file format. Exiting program.\n");
+	memcpy(filenameFormat, headers + SAES_MAX_PADDING_BYTES, SAES_MAX_FILENAME_BYTES);
 
 	// extract key length
-	inFile.seekg(fileSize - (SAES_BLOCK_BYTES * (SAES_HEADERS - 2)), inFile.beg);
-	inFile.read((char*)keylength, SAES_BLOCK_BYTES);
-	if (inFile.gcount() != SAES_BLOCK_BYTES)
-		throw FileException("Error reading SAES header key length. Exiting program.\n");
+	memcpy(keylength, headers + SAES_MAX_PADDING_BYTES + SAES_MAX_FILENAME_BYTES, SAES_MAX_KEYLENGTH_BYTES);
+
+}
+
+/**
+Extract SAES file header data through a file descriptor, checking the header fits the file. Both trailing-header
+versions are read; SAESChunkIndex::isChunked(padding) tells them apart, SAESAuth::hasAuthBlocks(padding) marks a
+version 1 file with salt and tag blocks or a checksum block.
+
+@param fd (IN) Descriptor of SAES file, in a trailing-header format.
+@param padding (OUT) File padding needed up to SAES block size, or the version 2 chunk layout.
+@param filenameFormat (OUT) File format of original file (ie., .txt, .jpg).
+@param keylength (OUT) Key length used in encryption of original file.
+
+@return Bytes of plaintext, excluding padding, salt, tag or checksum blocks and headers.
+
+@throw Throws FileException() if there was a problem reading header data, or the file is a framed stream.
+*/
+_saes64 SAES::extractFileSAESHeader(const int fd, byte* padding, byte* filenameFormat, byte* keylength) {
+
+	byte headers[SAES_HEADERS * SAES_BLOCK_BYTES];
+	_saes64 fileSize = FileIO::getFileSize(fd);
+
+	// framed streams have no trailer to read
+	if ((fileSize >= SAES_STREAM_MAGIC_BYTES) && (FileIO::readAt(fd, headers, SAES_STREAM_MAGIC_BYTES, 0) == SAES_STREAM_MAGIC_BYTES) && (memcmp(headers, SAES_STREAM_MAGIC, SAES_STREAM_MAGIC_BYTES) == 0))
+		throw FileException("Random access needs an SAES file, not a stream. Exiting program.\n");
+
+	// read all headers at once
+	if (fileSize < (SAES_HEADERS * SAES_BLOCK_BYTES))
+		throw FileException("Error reading SAES header padding. Exiting program.\n");
+	FileIO::readAt(fd, headers, SAES_HEADERS * SAES_BLOCK_BYTES, fileSize - (SAES_HEADERS * SAES_BLOCK_BYTES));
+	extractFileSAESHeader(headers, SAES_HEADERS * SAES_BLOCK_BYTES, padding, filenameFormat, keylength);
+
+	// version 2 stores plaintext size, chunks are never padded; compressed chunks may hold more plaintext than the file
+	// size, the chunk index read bounds it instead
+	if (SAESChunkIndex::isChunked(padding)) {
+		if (padding[0] != 0)
+			throw FileException("Error reading SAES header padding. Exiting program.\n");
+		return SAESChunkIndex::getPlainSize(padding);
+	}
+
+	// authenticated and checksummed files hold their blocks before the headers
+	if ((padding[0] >= SAES_BLOCK_BYTES) || (fileSize < (SAES_HEADERS * SAES_BLOCK_BYTES) + SAESAuth::getAuthBytes(padding) + padding[0]))
+		throw FileException("Error reading SAES header padding. Exiting program.\n");
+
+	return fileSize - (SAES_HEADERS * SAES_BLOCK_BYTES) - SAESAuth::getAuthBytes(padding) - padding[0];
+
+}
+
+/**
+Decrypt a byte range of an SAES file without decrypting the rest. CTR mode is seekable, so only the blocks covering the
+range are read and deciphered. The source file is left in place. The tag or checksum of a version 1 file covers the
+whole body, so it is not checked here; version 2 chunks read whole are checked against their checksums.
+
+@param filename (IN) Name of SAES file, in the legacy trailing-header format.
+@param password (IN) Password, SAES_MAX_KEY_BYTES bytes zero-padded past its end.
+@param offset (IN) Plaintext offset of first byte.
+@param length (IN) Bytes requested.
+@param out (OUT) Buffer receiving plaintext, length bytes.
+
+@return Bytes decrypted, less than length if the range reaches past the end of the plaintext.
+
+@throw Throws FileException() if file could not be read, is not an SAES file, has an unsupported key length or a chunk
+checksum does not match.
+*/
+_saes64 SAES::decryptRange(const char* filename, byte* password, const _saes64 offset, const _saes64 length, byte* out) {
+
+	byte padding[SAES_MAX_PADDING_BYTES] = { 0x00 };
+	byte filenameFormat[SAES_MAX_FILENAME_BYTES] = { 0x00 };
+	byte keylength[SAES_MAX_KEYLENGTH_BYTES] = { 0x00 };
+	byte nonce[SAES_NONCE_SIZE_BYTES] = { 0x00 };
+	byte block[SAES_BLOCK_BYTES] = { 0x00 };
+	_saes64 plainSize, rangeLen, headLen;
+	SAESChunkIndex index;
+	bool chunked;
+	int iKeylength;
+	int fd = FileIO::openFile(filename, FILECODE::FILE_INPUT);
+
+	try {
+		// extract SAES file header data
+		plainSize = extractFileSAESHeader(fd, padding, filenameFormat, keylength);
+		chunked = SAESChunkIndex::isChunked(padding);
+
+		// clamp range to plaintext, padding is never returned
+		if (offset >= plainSize) {
+			FileIO::closeFile(fd);
+			return 0;
+		}
+		rangeLen = std::min(length, plainSize - offset);
+
+		// key length comes from the file, never size a key schedule from it unchecked
+		iKeylength = (keylength[1] << 8) | (keylength[0] << 0);
+		if ((iKeylength != SAES_KEY_SIZE_128) && (iKeylength != SAES_KEY_SIZE_192) && (iKeylength != SAES_KEY_SIZE_256))
+			throw FileException("Unsupported SAES key length. Exiting program.\n");
+
+		SAES saes(iKeylength, password);
+		saes.calculateNonce(nonce, password);
+
+		// version 2 reads through the index entries of the range only
+		if (chunked) {
+			index.read(fd, FileIO::getFileSize(fd), padding, offset, rangeLen);
+			index.decryptRange(fd, saes, nonce, offset, out, rangeLen);
+			FileIO::closeFile(fd);
+			return rangeLen;
+		}
+		auto readCiphertext = [&](byte* buffer, const _saes64 len, const _saes64 pos) {
+			if (FileIO::readAt(fd, buffer, len, pos) != len)
+				throw FileException("Failed to read file. Exiting program.\n");
+		};
+
+		// leading partial block, deciphered whole on the stack
+		headLen = 0;
+		if (offset % SAES_BLOCK_BYTES) {
+			headLen = std::min((_saes64)(SAES_BLOCK_BYTES - (offset % SAES_BLOCK_BYTES)), rangeLen);
+			readCiphertext(block + (offset % SAES_BLOCK_BYTES), headLen, offset);
+			saes.applyKeystream(nonce, offset / SAES_BLOCK_BYTES, block, SAES_BLOCK_BYTES);
+			memcpy(out, block + (offset % SAES_BLOCK_BYTES), (size_t)headLen);
+		}
+
+		// remaining blocks start aligned, decipher in place
+		if (rangeLen > headLen) {
+			readCiphertext(out + headLen, rangeLen - headLen, offset + headLen);
+			saes.applyKeystream(nonce, (offset + headLen) / SAES_BLOCK_BYTES, out + headLen, rangeLen - headLen);
+		}
+	}
+	catch (FileException&) {
+		FileIO::closeFile(fd);
+		throw;
+	}
+
+	FileIO::closeFile(fd);
+
+	return rangeLen;
 
 }
 
@@ -198,17 +352,44 @@ void SAES::writeHeaders(
 	byte* keylength,
 	const int iKeylength) {
 
+	byte headers[SAES_HEADERS * SAES_BLOCK_BYTES];
+
+	// build and store headers
+	writeHeaders(headers, padding, paddingLen, filenameFormat, keylength, iKeylength);
+	outFile.write((const char*)headers, SAES_HEADERS * SAES_BLOCK_BYTES);
+
+}
+
+/**
+Writes SAES file header data to a buffer, laid out as at the end of an SAES file.
+
+@param headers (OUT) Buffer of SAES_HEADERS * SAES_BLOCK_BYTES bytes.
+@param padding (IN) Array which will be written to buffer. Bytes after the padding length are zero in version 1 and hold
+the chunk layout in version 2, see SAESChunkIndex::storeTrailer().
+@param paddingLen (OUT) Length of padding up to SAES_BLOCK_SIZE.
+@param filenameFormat (OUT) File format of original file (ie., .txt, .jpg).
+@param keylength (OUT) Key length used in encryption of original file.
+@param iKeylength (IN) Key size in integer form.
+*/
+void SAES::writeHeaders(
+	byte* headers,
+	byte* padding,
+	const int paddingLen,
+	const byte* filenameFormat,
+	byte* keylength,
+	const int iKeylength) {
+
 	// store padding
 	padding[0] = (paddingLen & 0x00FF);
-	outFile.write((const char*)padding, SAES_MAX_PADDING_BYTES);
+	memcpy(headers, padding, SAES_MAX_PADDING_BYTES);
 
 	// store file format
-	outFile.write((const char*)filenameFormat, SAES_MAX_FILENAME_BYTES);
+	memcpy(headers + SAES_MAX_PADDING_BYTES, filenameFormat, SAES_MAX_FILENAME_BYTES);
 
 	// store key length
 	keylength[0] = (iKeylength & 0x00FF) >> 0;
 	keylength[1] = (iKeylength & 0xFF00) >> 8;
-	outFile.write((const char*)keylength, SAES_MAX_KEYLENGTH_BYTES);
+	memcpy(headers + SAES_MAX_PADDING_BYTES + SAES_MAX_FILENAME_BYTES, keylength, SAES_MAX_KEYLENGTH_BYTES);
 
 }
 
@@ -259,6 +440,30 @@ void SAES::setNewFilename(byte* filename, byte* newFilename, byte* filenameForma
 
 }
 
+/**
+Set decrypted filename from SAES filename and the file format stored in its header.
+
+@param filename (IN) SAES filename.
+@param newFilename (OUT) Filename up to the first '.' followed by filenameFormat.
+@param filenameFormat (IN) File format of original file, SAES_MAX_FILENAME_BYTES.
+
+@throw Throws FileException() if filename has no '.'.
+*/
+void SAES::setDecryptedFilename(const byte* filename, byte* newFilename, const byte* filenameFormat) {
+
+	const char* tempPeriodPos = strchr((const char*)filename, '.');
+	size_t formatLen = strnlen((const char*)filenameFormat, SAES_MAX_FILENAME_BYTES - 1);
+
+	if (!tempPeriodPos)
+		throw FileException("Error cannot find '.' in filename to extract file format. Exiting program.\n");
+
+	// stem of SAES filename followed by original file format
+	memmove(newFilename, filename, (int)(tempPeriodPos - (const char*)filename));
+	memcpy(newFilename + (int)(tempPeriodPos - (const char*)filename), filenameFormat, formatLen);
+	newFilename[(int)(tempPeriodPos - (const char*)filename) + formatLen] = 0x00;
+
+}
+
 /**
 Set new file size by calculating and adding padding.
 
@@ -349,81 +554,78 @@ int* SAES::getNumRounds() {
 }
 
 /**
-Add round key to current state.
+Pack round keys into T-table column words.
 
-@param round (IN) Index of round key to be added.
+The state is held row-major (row i = block bytes 4i..4i+3), so column c of a round key gathers bytes c, c+4, c+8 and c+12.
+Decryption keys have inverse mix columns applied to the inner rounds (equivalent inverse cipher).
 */
-void SAES::addRoundKey(const int round)
+void SAES::tableKeyExpansion()
 {
-	int i, j;
-	for (i = 0; i < SAES_STATE_ROW_COL_SIZE; i++)
-		for (j = 0; j < SAES_STATE_ROW_COL_SIZE; j++)
-			state[i][j] ^= roundKey[round * SAES_STATE_ROW_COL_SIZE * SAES_STATE_ROW_COL_SIZE + i * SAES_STATE_ROW_COL_SIZE + j];
+	int round, col;
+
+	for (round = 0; round <= numRounds; round++)
+	{
+		for (col = 0; col < SAES_STATE_ROW_COL_SIZE; col++)
+		{
+			const byte* rk = roundKey + (round * SAES_STATE_SIZE) + col;
+			byte r0 = rk[0], r1 = rk[4], r2 = rk[8], r3 = rk[12];
+
+			encRoundKeys[round * SAES_STATE_ROW_COL_SIZE + col] = packColumn(r0, r1, r2, r3);
+			if (round == 0 || round == numRounds)
+				decRoundKeys[round * SAES_STATE_ROW_COL_SIZE + col] = packColumn(r0, r1, r2, r3);
+			else
+				decRoundKeys[round * SAES_STATE_ROW_COL_SIZE + col] = packColumn(
+					gfMultiply(r0, 0x0e) ^ gfMultiply(r1, 0x0b) ^ gfMultiply(r2, 0x0d) ^ gfMultiply(r3, 0x09),
+					gfMultiply(r0, 0x09) ^ gfMultiply(r1, 0x0e) ^ gfMultiply(r2, 0x0b) ^ gfMultiply(r3, 0x0d),
+					gfMultiply(r0, 0x0d) ^ gfMultiply(r1, 0x09) ^ gfMultiply(r2, 0x0e) ^ gfMultiply(r3, 0x0b),
+					gfMultiply(r0, 0x0b) ^ gfMultiply(r1, 0x0d) ^ gfMultiply(r2, 0x09) ^ gfMultiply(r3, 0x0e));
+		}
+	}
 }
 
 /* DECRYPT FUNCTIONS */
 
 /**
-Shift rows in state to the left with different offsets where offset is the row number.
-*/
-void SAES::invShiftRows()
-{
-	byte temp;
-
-	// rotate first row 1 columns to right
-	temp = state[1][3];
-	state[1][3] = state[1][2];
-	state[1][2] = state[1][1];
-	state[1][1] = state[1][0];
-	state[1][0] = temp;
-
-	// rotate second row 2 columns to right
-	temp = state[2][0];
-	state[2][0] = state[2][2];
-	state[2][2] = temp;
-
-	temp = state[2][1];
-	state[2][1] = state[2][3];
-	state[2][3] = temp;
-
-	// rotate third row 3 columns to right
-	temp = state[3][0];
-	state[3][0] = state[3][1];
-	state[3][1] = state[3][2];
-	state[3][2] = state[3][3];
-	state[3][3] = temp;
-}
+Decrypt one block with the decryption T-tables.
 
-/**
-Substitute bytes in current state with those at the same index in inverse s-box.
+@param in (IN) 16-byte ciphertext block, loaded column-major.
+@param out (OUT) 16-byte plaintext block.
 */
-void SAES::invSubBytes()
+void SAES::decryptBlock(const byte* in, byte* out) const
 {
-	int i, j;
-	for (i = 0; i < SAES_STATE_ROW_COL_SIZE; i++)
-		for (j = 0; j < SAES_STATE_ROW_COL_SIZE; j++)
-			state[i][j] = rsbox[state[i][j]];
-}
+	const uint32_t* rk = decRoundKeys + (numRounds * SAES_STATE_ROW_COL_SIZE);
+	uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
+	int round;
 
-/**
-Mix columns of the current state.
-*/
-void SAES::invMixColumns()
-{
-	int i;
-	byte a, b, c, d;
-	for (i = 0; i < SAES_STATE_ROW_COL_SIZE; i++)
+	// load state and add the last round key
+	s0 = packColumn(in[0], in[1], in[2], in[3]) ^ rk[0];
+	s1 = packColumn(in[4], in[5], in[6], in[7]) ^ rk[1];
+	s2 = packColumn(in[8], in[9], in[10], in[11]) ^ rk[2];
+	s3 = packColumn(in[12], in[13], in[14], in[15]) ^ rk[3];
+
+	// inverse shift rows, inverse sub bytes, add round key and inverse mix columns for all rounds except the last
+	for (round = numRounds - 1; round > 0; round--)
 	{
-		a = state[0][i];
-		b = state[1][i];
-		c = state[2][i];
-		d = state[3][i];
-
-		state[0][i] = Multiply(a, 0x0e) ^ Multiply(b, 0x0b) ^ Multiply(c, 0x0d) ^ Multiply(d, 0x09);
-		state[1][i] = Multiply(a, 0x09) ^ Multiply(b, 0x0e) ^ Multiply(c, 0x0b) ^ Multiply(d, 0x0d);
-		state[2][i] = Multiply(a, 0x0d) ^ Multiply(b, 0x09) ^ Multiply(c, 0x0e) ^ Multiply(d, 0x0b);
-		state[3][i] = Multiply(a, 0x0b) ^ Multiply(b, 0x0d) ^ Multiply(c, 0x09) ^ Multiply(d, 0x0e);
+		rk -= SAES_STATE_ROW_COL_SIZE;
+		t0 = td[0][s0 & 0xFF] ^ td[1][(s3 >> 8) & 0xFF] ^ td[2][(s2 >> 16) & 0xFF] ^ td[3][s1 >> 24] ^ rk[0];
+		t1 = td[0][s1 & 0xFF] ^ td[1][(s0 >> 8) & 0xFF] ^ td[2][(s3 >> 16) & 0xFF] ^ td[3][s2 >> 24] ^ rk[1];
+		t2 = td[0][s2 & 0xFF] ^ td[1][(s1 >> 8) & 0xFF] ^ td[2][(s0 >> 16) & 0xFF] ^ td[3][s3 >> 24] ^ rk[2];
+		t3 = td[0][s3 & 0xFF] ^ td[1][(s2 >> 8) & 0xFF] ^ td[2][(s1 >> 16) & 0xFF] ^ td[3][s0 >> 24] ^ rk[3];
+		s0 = t0; s1 = t1; s2 = t2; s3 = t3;
 	}
+
+	// perform last round of decryption
+	rk -= SAES_STATE_ROW_COL_SIZE;
+	t0 = packColumn(rsbox[s0 & 0xFF], rsbox[(s3 >> 8) & 0xFF], rsbox[(s2 >> 16) & 0xFF], rsbox[s1 >> 24]) ^ rk[0];
+	t1 = packColumn(rsbox[s1 & 0xFF], rsbox[(s0 >> 8) & 0xFF], rsbox[(s3 >> 16) & 0xFF], rsbox[s2 >> 24]) ^ rk[1];
+	t2 = packColumn(rsbox[s2 & 0xFF], rsbox[(s1 >> 8) & 0xFF], rsbox[(s0 >> 16) & 0xFF], rsbox[s3 >> 24]) ^ rk[2];
+	t3 = packColumn(rsbox[s3 & 0xFF], rsbox[(s2 >> 8) & 0xFF], rsbox[(s1 >> 16) & 0xFF], rsbox[s0 >> 24]) ^ rk[3];
+
+	// store state column-major
+	out[0] = t0; out[1] = t0 >> 8; out[2] = t0 >> 16; out[3] = t0 >> 24;
+	out[4] = t1; out[5] = t1 >> 8; out[6] = t1 >> 16; out[7] = t1 >> 24;
+	out[8] = t2; out[9] = t2 >> 8; out[10] = t2 >> 16; out[11] = t2 >> 24;
+	out[12] = t3; out[13] = t3 >> 8; out[14] = t3 >> 16; out[15] = t3 >> 24;
 }
 
 /**
@@ -431,137 +633,155 @@ Decrypt cipher block.
 */
 void SAES::invCipher()
 {
-	int i, j, round = 0;
+	decryptBlock(encryptCiphertext, decryptPlain);
+}
 
-	// copy the input ciphertext to state array.
-	for (i = 0; i < SAES_STATE_ROW_COL_SIZE; i++)
-		for (j = 0; j < SAES_STATE_ROW_COL_SIZE; j++)
-			state[j][i] = encryptCiphertext[i * SAES_STATE_ROW_COL_SIZE + j];
+/* ENCRYPT FUNCTIONS */
 
-	// add the 1st round key to the state before starting rounds
-	addRoundKey(numRounds);
+/**
+Encrypt one block with the encryption T-tables.
 
-	// perform inverse cipher for all rounds except the last
-	for (round = numRounds - 1; round > 0; round--)
+@param in (IN) 16-byte plaintext block, loaded row-major.
+@param out (OUT) 16-byte ciphertext block.
+*/
+void SAES::encryptBlock(const byte* in, byte* out) const
+{
+	const uint32_t* rk = encRoundKeys;
+	uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
+	int round;
+
+	// load state and add the 1st round key
+	s0 = packColumn(in[0], in[4], in[8], in[12]) ^ rk[0];
+	s1 = packColumn(in[1], in[5], in[9], in[13]) ^ rk[1];
+	s2 = packColumn(in[2], in[6], in[10], in[14]) ^ rk[2];
+	s3 = packColumn(in[3], in[7], in[11], in[15]) ^ rk[3];
+
+	// sub bytes, shift rows, mix columns and add round key for all rounds except the last
+	for (round = 1; round < numRounds; round++)
 	{
-		invShiftRows();
-		invSubBytes();
-		addRoundKey(round);
-		invMixColumns();
+		rk += SAES_STATE_ROW_COL_SIZE;
+		t0 = te[0][s0 & 0xFF] ^ te[1][(s1 >> 8) & 0xFF] ^ te[2][(s2 >> 16) & 0xFF] ^ te[3][s3 >> 24] ^ rk[0];
+		t1 = te[0][s1 & 0xFF] ^ te[1][(s2 >> 8) & 0xFF] ^ te[2][(s3 >> 16) & 0xFF] ^ te[3][s0 >> 24] ^ rk[1];
+		t2 = te[0][s2 & 0xFF] ^ te[1][(s3 >> 8) & 0xFF] ^ te[2][(s0 >> 16) & 0xFF] ^ te[3][s1 >> 24] ^ rk[2];
+		t3 = te[0][s3 & 0xFF] ^ te[1][(s0 >> 8) & 0xFF] ^ te[2][(s1 >> 16) & 0xFF] ^ te[3][s2 >> 24] ^ rk[3];
+		s0 = t0; s1 = t1; s2 = t2; s3 = t3;
 	}
 
-	// perform last round of decryption
-	invShiftRows();
-	invSubBytes();
-	addRoundKey(0);
-
-	// copy result to internal buffer
-	for (i = 0; i < SAES_STATE_ROW_COL_SIZE; i++)
-		for (j = 0; j < SAES_STATE_ROW_COL_SIZE; j++)
-			decryptPlain[i * SAES_STATE_ROW_COL_SIZE + j] = state[j][i];
+	// perform last round of encryption
+	rk += SAES_STATE_ROW_COL_SIZE;
+	t0 = packColumn(sbox[s0 & 0xFF], sbox[(s1 >> 8) & 0xFF], sbox[(s2 >> 16) & 0xFF], sbox[s3 >> 24]) ^ rk[0];
+	t1 = packColumn(sbox[s1 & 0xFF], sbox[(s2 >> 8) & 0xFF], sbox[(s3 >> 16) & 0xFF], sbox[s0 >> 24]) ^ rk[1];
+	t2 = packColumn(sbox[s2 & 0xFF], sbox[(s3 >> 8) & 0xFF], sbox[(s0 >> 16) & 0xFF], sbox[s1 >> 24]) ^ rk[2];
+	t3 = packColumn(sbox[s3 & 0xFF], sbox[(s0 >> 8) & 0xFF], sbox[(s1 >> 16) & 0xFF], sbox[s2 >> 24]) ^ rk[3];
+
+	// store state row-major
+	out[0] = t0; out[4] = t0 >> 8; out[8] = t0 >> 16; out[12] = t0 >> 24;
+	out[1] = t1; out[5] = t1 >> 8; out[9] = t1 >> 16; out[13] = t1 >> 24;
+	out[2] = t2; out[6] = t2 >> 8; out[10] = t2 >> 16; out[14] = t2 >> 24;
+	out[3] = t3; out[7] = t3 >> 8; out[11] = t3 >> 16; out[15] = t3 >> 24;
 }
 
-/* ENCRYPT FUNCTIONS */
-
 /**
-Substitute bytes in current state with those at the same index in s-box.
+Encrypt plaintext block.
+
+@param plaintextBlocks (IN) Buffer holding plaintext file data.
 */
-void SAES::subBytes()
+void SAES::cipher(const byte* plaintextBlocks)
 {
-	int i, j;
-	for (i = 0; i < SAES_STATE_ROW_COL_SIZE; i++)
-		for (j = 0; j < SAES_STATE_ROW_COL_SIZE; j++)
-			state[i][j] = sbox[state[i][j]];
+	// copy plaintext to internal cipherblock buffer
+	memcpy(encryptPlain, plaintextBlocks, SAES_BLOCK_BYTES);
+
+	// encrypt to internal buffer
+	cipherBlocks(encryptPlain, encryptCiphertext, 1);
 }
 
 /**
-Shift rows in state to the left with different offsets where offset is row number.
+Encrypt consecutive plaintext blocks with the hardware backend if available, otherwise with the T-table engine.
+
+@param plaintextBlocks (IN) Buffer holding plaintext blocks.
+@param cipherBlocks (OUT) Buffer receiving ciphertext blocks.
+@param numBlocks (IN) Number of 16-byte blocks.
 */
-void SAES::shiftRows()
+void SAES::cipherBlocks(const byte* plaintextBlocks, byte* cipherBlocks, const _saes64 numBlocks) const
 {
-	byte temp;
-
-	// rotate first row 1 columns to left
-	temp = state[1][0];
-	state[1][0] = state[1][1];
-	state[1][1] = state[1][2];
-	state[1][2] = state[1][3];
-	state[1][3] = temp;
-
-	// rotate second row 2 columns to left
-	temp = state[2][0];
-	state[2][0] = state[2][2];
-	state[2][2] = temp;
-
-	temp = state[2][1];
-	state[2][1] = state[2][3];
-	state[2][3] = temp;
-
-	// rotate third row 3 columns to left
-	temp = state[3][0];
-	state[3][0] = state[3][3];
-	state[3][3] = state[3][2];
-	state[3][2] = state[3][1];
-	state[3][1] = temp;
+	// hardware
+	if (aesniEnabled) {
+		aesni.encryptBlocks(plaintextBlocks, cipherBlocks, numBlocks);
+		return;
+	}
+
+	// software
+	for (_saes64 i = 0; i < numBlocks; i++)
+		encryptBlock(plaintextBlocks + (i * SAES_BLOCK_BYTES), cipherBlocks + (i * SAES_BLOCK_BYTES));
 }
 
 /**
-Mix columns of the current state.
+Generate CTR keystream for consecutive counters straight into a caller buffer. Keystream block i is the
+encryption of concatNonceCounter(nonce, startCounter + i). No per-object state is written, so a single SAES
+object may generate keystream from several threads at once.
+
+@param nonce (IN) Nonce derived from password.
+@param startCounter (IN) Counter of first block.
+@param numBlocks (IN) Number of 16-byte keystream blocks.
+@param keystream (OUT) Buffer receiving numBlocks * SAES_BLOCK_BYTES bytes of keystream.
 */
-void SAES::mixColumns()
+void SAES::generateKeystream(const byte* nonce, const _saes64 startCounter, const _saes64 numBlocks, byte* keystream) const
 {
-	int i;
-	byte Tmp, Tm, t;
-	for (i = 0; i < SAES_STATE_ROW_COL_SIZE; i++)
-	{
-		t = state[0][i];
-		Tmp = state[0][i] ^ state[1][i] ^ state[2][i] ^ state[3][i];
-		Tm = state[0][i] ^ state[1][i]; Tm = xtime(Tm); state[0][i] ^= Tm ^ Tmp;
-		Tm = state[1][i] ^ state[2][i]; Tm = xtime(Tm); state[1][i] ^= Tm ^ Tmp;
-		Tm = state[2][i] ^ state[3][i]; Tm = xtime(Tm); state[2][i] ^= Tm ^ Tmp;
-		Tm = state[3][i] ^ t; Tm = xtime(Tm); state[3][i] ^= Tm ^ Tmp;
+	byte nonceCounter[SAES_BLOCK_BYTES];
+
+	// hardware
+	if (aesniEnabled) {
+		aesni.generateKeystream(nonce, startCounter, numBlocks, keystream);
+		return;
+	}
+
+	// software
+	for (_saes64 i = 0; i < numBlocks; i++) {
+		concatNonceCounter(nonceCounter, nonce, startCounter + i);
+		encryptBlock(nonceCounter, keystream + (i * SAES_BLOCK_BYTES));
 	}
 }
 
 /**
-Encrypt plaintext block.
+Encrypt/decrypt data in place in CTR mode. Keystream is produced SAES_PIPELINE_BLOCKS at a time and XORed into
+the data while hot in cache (in registers on the hardware path); no keystream buffer is allocated.
 
-@param plaintextBlocks (IN) Buffer holding plaintext file data.
+@param nonce (IN) Nonce derived from password.
+@param startCounter (IN) Counter of the block at data[0].
+@param data (IN/OUT) Data to XOR with keystream.
+@param len (IN) Bytes of data, need not be a multiple of SAES_BLOCK_BYTES.
 */
-void SAES::cipher(const byte* plaintextBlocks)
+void SAES::applyKeystream(const byte* nonce, const _saes64 startCounter, byte* data, const _saes64 len) const
 {
-	int i, j, round = 0;
-	byte* cipherBlocks = 0;
-
-	// copy plaintext to internal cipherblock buffer
-	memcpy(encryptPlain, plaintextBlocks, SAES_BLOCK_BYTES);
-
-	/* CIPHER */
+	applyKeystream(nonce, startCounter, data, data, len);
+}
 
-	// copy plaintext to state array
-	for (i = 0; i < SAES_STATE_ROW_COL_SIZE; i++)
-		for (j = 0; j < SAES_STATE_ROW_COL_SIZE; j++)
-			state[i][j] = encryptPlain[i * SAES_STATE_ROW_COL_SIZE + j];
+/**
+Encrypt/decrypt data in CTR mode from one buffer into another, such as between two file mappings.
 
-	// add the 1st round key to the state before starting the rounds
-	addRoundKey(0);
+@param nonce (IN) Nonce derived from password.
+@param startCounter (IN) Counter of the block at in[0].
+@param in (IN) Data to XOR with keystream.
+@param out (OUT) Result, may be the same buffer as in.
+@param len (IN) Bytes of data, need not be a multiple of SAES_BLOCK_BYTES.
+*/
+void SAES::applyKeystream(const byte* nonce, const _saes64 startCounter, const byte* in, byte* out, const _saes64 len) const
+{
+	byte keystream[SAES_PIPELINE_BLOCKS * SAES_BLOCK_BYTES];
+	_saes64 offset = 0;
 
-	// perform cipher for all rounds except the last
-	for (round = 1; round < numRounds; round++)
-	{
-		subBytes();
-		shiftRows();
-		mixColumns();
-		addRoundKey(round);
+	// hardware
+	if (aesniEnabled) {
+		aesni.applyKeystream(nonce, startCounter, in, out, len);
+		return;
 	}
 
-	// perform last round of encryption
-	subBytes();
-	shiftRows();
-	addRoundKey(round);
-
-	// copy result to internal buffer
-	for (i = 0; i < SAES_STATE_ROW_COL_SIZE; i++)
-		for (j = 0; j < SAES_STATE_ROW_COL_SIZE; j++)
-			encryptCiphertext[i * SAES_STATE_ROW_COL_SIZE + j] = state[i][j];
+	// software
+	while (offset < len) {
+		_saes64 batchLen = std::min((_saes64)sizeof(keystream), len - offset);
+		_saes64 numBlocks = (batchLen + SAES_BLOCK_BYTES - 1) / SAES_BLOCK_BYTES;
+		generateKeystream(nonce, startCounter + (offset / SAES_BLOCK_BYTES), numBlocks, keystream);
+		FastXOR::xorBuffer(in + offset, keystream, out + offset, batchLen);
+		offset += batchLen;
+	}
 }
@@ -7,14 +7,13 @@
 #endif
 #include "SAESconstants.h"
 #include "Exceptions.h"
+#include "AESNI.h"
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <memory>
 #include <fstream>
 
-#define xtime(x) ((x<<1) ^ (((x>>7) & 1) * 0x1b))
-#define Multiply(x,y) (((y & 1) * x) ^ ((y>>1 & 1) * xtime(x)) ^ ((y>>2 & 1) * xtime(xtime(x))) ^ ((y>>3 & 1) * xtime(xtime(xtime(x)))) ^ ((y>>4 & 1) * xtime(xtime(xtime(xtime(x))))))
-
 // SAES crypto class
 class SAES {
 
@@ -25,17 +24,21 @@ public:
 
 	// general purpose
 	void storeCipherBlockAtOffset(byte*);
-	void calculateNonce(byte*, const byte*);
-	void setNonceCounters(std::unique_ptr<byte[]>&, const byte*, const _saes64);
+	static void calculateNonce(byte*, const byte*);
 	static _saes64 getFileSize(std::fstream&);
 	static void extractFileSAESHeader(std::fstream&, const _saes64, byte*, byte*, byte*);
+	static void extractFileSAESHeader(const byte*, const _saes64, byte*, byte*, byte*);
+	static _saes64 extractFileSAESHeader(const int, byte*, byte*, byte*);
+	static SAES_API _saes64 decryptRange(const char*, byte*, const _saes64, const _saes64, byte*);
 	void writeHeaders(std::fstream&, byte*, const int, const byte*, byte*, const int);
-	void concatNonceCounter(byte*, const byte*, const _saes64);
-	void setNewFilename(byte*, byte*, byte*);
-	void setNewFilesize(const _saes64, int&, _saes64&);
+	static void writeHeaders(byte*, byte*, const int, const byte*, byte*, const int);
+	static void concatNonceCounter(byte*, const byte*, const _saes64);
+	static void setNewFilename(byte*, byte*, byte*);
+	static void setDecryptedFilename(const byte*, byte*, const byte*);
+	static void setNewFilesize(const _saes64, int&, _saes64&);
 	static void openFile(std::fstream&, const char*, const FILECODE);
 	void closeFile(std::fstream&);
-	void deleteFile(const char*);
+	static void deleteFile(const char*);
 	byte* getRoundKeys();
 	int* getNumRounds();
 
@@ -44,28 +47,31 @@ public:
 
 	// encryption
 	void cipher(const byte*);
+	void cipherBlocks(const byte*, byte*, const _saes64) const;
+	void generateKeystream(const byte*, const _saes64, const _saes64, byte*) const;
+	void applyKeystream(const byte*, const _saes64, byte*, const _saes64) const;
+	void applyKeystream(const byte*, const _saes64, const byte*, byte*, const _saes64) const;
 
 private:
 
 	// general purpose
-	void addRoundKey(const int);
 	void keyExpansion();
+	void tableKeyExpansion();
 
 	// decryption
-	void invShiftRows();
-	void invSubBytes();
-	void invMixColumns();
+	void decryptBlock(const byte*, byte*) const;
 
 	// encryption
-	void subBytes();
-	void shiftRows();
-	void mixColumns();
+	void encryptBlock(const byte*, byte*) const;
 
 	int numRounds;
 	int numKeyWords;
 	int keyLen;
 	byte encryptPlain[SAES_BLOCK_BYTES], encryptCiphertext[SAES_BLOCK_BYTES], decryptPlain[SAES_BLOCK_BYTES];
-	byte key[SAES_MAX_KEY_BYTES], roundKey[SAES_MAX_ROUND_KEY_BYTES], state[SAES_STATE_ROW_COL_SIZE][SAES_STATE_ROW_COL_SIZE];
+	byte key[SAES_MAX_KEY_BYTES], roundKey[SAES_MAX_ROUND_KEY_BYTES];
+	uint32_t encRoundKeys[SAES_MAX_ROUND_KEY_WORDS], decRoundKeys[SAES_MAX_ROUND_KEY_WORDS];
+	AESNI aesni;
+	bool aesniEnabled;
 
 };
 
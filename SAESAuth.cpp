@@ -0,0 +1,266 @@
+#include "SAESAuth.h"
+#include <algorithm>
+#include <random>
+
+// first salt byte is forced to at least this, nonce bytes never reach it
+#define SAES_AUTH_SALT_MARK 0xC0
+
+// checksum state and block: CRC32C of plaintext, then of ciphertext
+#define SAES_CHECKSUM_PLAIN 0
+#define SAES_CHECKSUM_CIPHER 4
+
+// load little-endian 32-bit word
+static uint32_t loadLE(const byte* in) {
+	return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+// store little-endian 32-bit word
+static void storeLE(byte* out, const uint32_t value) {
+
+	for (int i = 0; i < 4; i++)
+		out[i] = (byte)(value >> (8 * i));
+
+}
+
+/**
+Derive hash key and tag mask from the salt and hash the headers. A checksum file needs neither.
+
+@param _saes (IN) Cipher context, kept for the life of this object.
+@param _status (IN) Encryption hashes ciphertext after ciphering, decryption before.
+@param salt (IN) Salt block of the file, or its checksum block.
+@param headers (IN) SAES_HEADERS blocks of the file, hashed ahead of the body. The padding block selects tag or checksum.
+*/
+SAESAuth::SAESAuth(const SAES& _saes, const OPCODE _status, const byte* salt, const byte* headers) :
+	saes(_saes),
+	status(_status),
+	checksum(((headers[2] & SAES_HEADER_FLAG_AUTH) == 0) && ((headers[2] & SAES_HEADER_FLAG_CHECKSUM) != 0)),
+	dataLen(0)
+{
+
+	byte blocks[2 * SAES_BLOCK_BYTES];
+	byte keys[2 * SAES_BLOCK_BYTES];
+
+	memset(state, 0, SAES_BLOCK_BYTES);
+	memset(tagMask, 0, SAES_BLOCK_BYTES);
+
+	// ciphertext checksum starts with the headers
+	if (checksum) {
+		storeLE(state + SAES_CHECKSUM_CIPHER, CRC32C::update(0, headers, SAES_HEADERS * SAES_BLOCK_BYTES));
+		return;
+	}
+
+	// hash key and tag mask blocks differ in their last bit
+	memcpy(blocks, salt, SAES_BLOCK_BYTES);
+	blocks[0] |= SAES_AUTH_SALT_MARK;
+	blocks[SAES_BLOCK_BYTES - 1] &= 0xFE;
+	memcpy(blocks + SAES_BLOCK_BYTES, blocks, SAES_BLOCK_BYTES);
+	blocks[(2 * SAES_BLOCK_BYTES) - 1] |= 0x01;
+	saes.cipherBlocks(blocks, keys, 2);
+
+	ghash.loadKey(keys);
+	memcpy(tagMask, keys + SAES_BLOCK_BYTES, SAES_BLOCK_BYTES);
+
+	// headers first
+	ghash.update(state, headers, SAES_HEADERS * SAES_BLOCK_BYTES);
+
+}
+
+/**
+Check padding block for an authenticated or checksummed file.
+
+@param padding (IN) Padding block.
+
+@return True if salt and tag blocks, or a checksum block, precede the headers.
+*/
+bool SAESAuth::hasAuthBlocks(const byte* padding) {
+
+	return (padding[1] == 0) && ((padding[2] & (SAES_HEADER_FLAG_AUTH | SAES_HEADER_FLAG_CHECKSUM)) != 0);
+
+}
+
+/**
+Get bytes of salt and tag blocks, or of the checksum block.
+
+@param padding (IN) Padding block.
+
+@return SAES_AUTH_BLOCKS * SAES_BLOCK_BYTES for an authenticated file, SAES_CHECKSUM_BLOCKS * SAES_BLOCK_BYTES for a
+checksummed one, else 0.
+*/
+_saes64 SAESAuth::getAuthBytes(const byte* padding) {
+
+	if (!hasAuthBlocks(padding))
+		return 0;
+	return (padding[2] & SAES_HEADER_FLAG_AUTH) ? (SAES_AUTH_BLOCKS * SAES_BLOCK_BYTES) : (SAES_CHECKSUM_BLOCKS * SAES_BLOCK_BYTES);
+
+}
+
+/**
+Generate a random salt for a new file.
+
+@param salt (OUT) Salt block.
+*/
+void SAESAuth::generateSalt(byte* salt) {
+
+	std::random_device random;
+
+	for (int i = 0; i < SAES_BLOCK_BYTES; i += sizeof(unsigned int)) {
+		unsigned int word = random();
+		memcpy(salt + i, &word, sizeof(unsigned int));
+	}
+
+}
+
+/**
+Get bytes of the blocks this object stores or checks.
+
+@return Bytes between body and headers.
+*/
+_saes64 SAESAuth::getAuthBytes() const {
+	return (checksum ? SAES_CHECKSUM_BLOCKS : SAES_AUTH_BLOCKS) * SAES_BLOCK_BYTES;
+}
+
+/**
+Cipher and hash the next part of the body, in order.
+
+@param nonce (IN) Nonce derived from password.
+@param startCounter (IN) Counter of the block at in[0].
+@param in (IN) Data to cipher.
+@param out (OUT) Result, may be the same buffer as in.
+@param len (IN) Bytes of data, a multiple of SAES_BLOCK_BYTES except in the last call.
+*/
+void SAESAuth::applyKeystream(const byte* nonce, const _saes64 startCounter, const byte* in, byte* out, const _saes64 len) {
+
+	applyKeystream(nonce, startCounter, in, out, len, state);
+	dataLen += len;
+
+}
+
+/**
+Cipher and hash a chunk of the body into a state of its own, for chunks run on several threads. Join the chunk states in
+order with append().
+
+@param nonce (IN) Nonce derived from password.
+@param startCounter (IN) Counter of the block at in[0].
+@param in (IN) Data to cipher.
+@param out (OUT) Result, may be the same buffer as in.
+@param len (IN) Bytes of data, a multiple of SAES_BLOCK_BYTES unless the chunk ends the body.
+@param chunkState (IN/OUT) Hash state of the chunk, zero to start.
+*/
+void SAESAuth::applyKeystream(const byte* nonce, const _saes64 startCounter, const byte* in, byte* out, const _saes64 len, byte* chunkState) const {
+
+	for (_saes64 offset = 0; offset < len; offset += SAES_AUTH_SLICE_BYTES) {
+
+		_saes64 sliceLen = std::min((_saes64)SAES_AUTH_SLICE_BYTES, len - offset);
+
+		// ciphertext is hashed before deciphering or after enciphering, checksums also cover the plaintext
+		if (status == OPCODE::DECRYPTION)
+			hashCiphertext(chunkState, in + offset, sliceLen);
+		else if (checksum)
+			hashPlaintext(chunkState, in + offset, sliceLen);
+		saes.applyKeystream(nonce, startCounter + (offset / SAES_BLOCK_BYTES), in + offset, out + offset, sliceLen);
+		if (status == OPCODE::ENCRYPTION)
+			hashCiphertext(chunkState, out + offset, sliceLen);
+		else if (checksum)
+			hashPlaintext(chunkState, out + offset, sliceLen);
+
+	}
+
+}
+
+/**
+Append the state of the next chunk of the body.
+
+@param chunkState (IN) Hash state of the chunk.
+@param chunkLen (IN) Bytes of the chunk.
+*/
+void SAESAuth::append(const byte* chunkState, const _saes64 chunkLen) {
+
+	if (checksum) {
+		storeLE(state + SAES_CHECKSUM_PLAIN, CRC32C::combine(loadLE(state + SAES_CHECKSUM_PLAIN), loadLE(chunkState + SAES_CHECKSUM_PLAIN), chunkLen));
+		storeLE(state + SAES_CHECKSUM_CIPHER, CRC32C::combine(loadLE(state + SAES_CHECKSUM_CIPHER), loadLE(chunkState + SAES_CHECKSUM_CIPHER), chunkLen));
+	}
+	else
+		ghash.combine(state, chunkState, chunkLen);
+	dataLen += chunkLen;
+
+}
+
+/**
+Store tag of the headers and all body data so far, or the checksum block.
+
+@param authBlocks (IN/OUT) Blocks between body and headers, salt block already set for a tag.
+*/
+void SAESAuth::storeTag(byte* authBlocks) const {
+
+	byte digest[SAES_BLOCK_BYTES];
+
+	if (checksum) {
+		memcpy(authBlocks, state, SAES_BLOCK_BYTES);
+		return;
+	}
+
+	memcpy(digest, state, SAES_BLOCK_BYTES);
+	ghash.finish(digest, SAES_HEADERS * SAES_BLOCK_BYTES, dataLen);
+	for (int i = 0; i < SAES_BLOCK_BYTES; i++)
+		authBlocks[SAES_BLOCK_BYTES + i] = digest[i] ^ tagMask[i];
+
+}
+
+/**
+Compare tag of the headers and body with the stored tag, in constant time, or the checksums with the stored checksums.
+
+@param authBlocks (IN) Blocks between body and headers, read from file.
+
+@throw Throws FileException() if the tags or checksums differ.
+*/
+void SAESAuth::verifyTag(const byte* authBlocks) const {
+
+	byte tag[2 * SAES_BLOCK_BYTES];
+	byte difference = 0;
+
+	// stored body first, a good body with a bad plaintext means a wrong password
+	if (checksum) {
+		if (loadLE(state + SAES_CHECKSUM_CIPHER) != loadLE(authBlocks + SAES_CHECKSUM_CIPHER))
+			throw FileException("SAES checksum mismatch, file is corrupted. Exiting program.\n");
+		if (loadLE(state + SAES_CHECKSUM_PLAIN) != loadLE(authBlocks + SAES_CHECKSUM_PLAIN))
+			throw FileException("SAES plaintext checksum mismatch, wrong password or corrupted file. Exiting program.\n");
+		return;
+	}
+
+	storeTag(tag);
+	for (int i = 0; i < SAES_BLOCK_BYTES; i++)
+		difference |= tag[SAES_BLOCK_BYTES + i] ^ authBlocks[SAES_BLOCK_BYTES + i];
+
+	if (difference != 0)
+		throw FileException("SAES authentication failed, file is corrupted or was modified. Exiting program.\n");
+
+}
+
+/**
+Hash stored body bytes into a state.
+
+@param chunkState (IN/OUT) Hash state.
+@param data (IN) Ciphertext.
+@param len (IN) Bytes of data.
+*/
+void SAESAuth::hashCiphertext(byte* chunkState, const byte* data, const _saes64 len) const {
+
+	if (checksum)
+		storeLE(chunkState + SAES_CHECKSUM_CIPHER, CRC32C::update(loadLE(chunkState + SAES_CHECKSUM_CIPHER), data, len));
+	else
+		ghash.update(chunkState, data, len);
+
+}
+
+/**
+Checksum padded plaintext bytes into a state.
+
+@param chunkState (IN/OUT) Checksum state.
+@param data (IN) Plaintext.
+@param len (IN) Bytes of data.
+*/
+void SAESAuth::hashPlaintext(byte* chunkState, const byte* data, const _saes64 len) const {
+
+	storeLE(chunkState + SAES_CHECKSUM_PLAIN, CRC32C::update(loadLE(chunkState + SAES_CHECKSUM_PLAIN), data, len));
+
+}
@@ -0,0 +1,58 @@
+#ifndef SAESAUTH_H
+#define SAESAUTH_H
+
+#ifdef __linux__
+#include <inttypes.h>
+#endif
+#include "SAESconstants.h"
+#include "Exceptions.h"
+#include "SAES.h"
+#include "GHASH.h"
+#include "CRC32C.h"
+
+// single-pass authentication of a version 1 SAES file, in the manner of GCM, or a CRC32C integrity check.
+// Layout: body, salt block, tag block, then the SAES_HEADERS blocks with SAES_HEADER_FLAG_AUTH set in the padding block.
+// The hash key and tag mask are ciphered from the random salt with its first byte above any nonce byte, so they never
+// repeat a keystream block. The tag is GHASH over the headers, the stored body and the lengths, XORed with the mask.
+// With SAES_HEADER_FLAG_CHECKSUM a single checksum block holds CRC32C of the padded plaintext and of the headers and
+// stored body instead; it catches corruption and wrong passwords, not tampering.
+// Bodies are ciphered and hashed SAES_AUTH_SLICE_BYTES at a time, so each slice is hashed while still in cache.
+class SAESAuth {
+
+public:
+
+	// constructor
+	SAESAuth(const SAES&, const OPCODE, const byte*, const byte*);
+
+	// file layout
+	static bool hasAuthBlocks(const byte*);
+	static _saes64 getAuthBytes(const byte*);
+	static void generateSalt(byte*);
+	_saes64 getAuthBytes() const;
+
+	// single pass
+	void applyKeystream(const byte*, const _saes64, const byte*, byte*, const _saes64);
+	void applyKeystream(const byte*, const _saes64, const byte*, byte*, const _saes64, byte*) const;
+	void append(const byte*, const _saes64);
+
+	// tag or checksum block
+	void storeTag(byte*) const;
+	void verifyTag(const byte*) const;
+
+private:
+
+	// hash one slice into a state
+	void hashCiphertext(byte*, const byte*, const _saes64) const;
+	void hashPlaintext(byte*, const byte*, const _saes64) const;
+
+	const SAES& saes;
+	OPCODE status;
+	bool checksum;
+	GHASH ghash;
+	byte tagMask[SAES_BLOCK_BYTES];
+	byte state[SAES_BLOCK_BYTES];
+	_saes64 dataLen;
+
+};
+
+#endif
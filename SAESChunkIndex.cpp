@@ -0,0 +1,607 @@
+#include "SAESChunkIndex.h"
+#include "FileIO.h"
+#include "CRC32C.h"
+#include "LZ4Codec.h"
+#include <algorithm>
+#include <memory>
+#include <string.h>
+
+/**
+Store little-endian integer.
+
+@param out (OUT) Destination of numBytes bytes.
+@param value (IN) Value to store.
+@param numBytes (IN) Bytes to store, at most 8.
+*/
+static void storeLE(byte* out, const _saes64 value, const int numBytes) {
+	for (int i = 0; i < numBytes; i++)
+		out[i] = (byte)((value >> (8 * i)) & 0xFF);
+}
+
+/**
+Load little-endian integer.
+
+@param in (IN) Source of numBytes bytes.
+@param numBytes (IN) Bytes to load, at most 8.
+
+@return Loaded value.
+*/
+static _saes64 loadLE(const byte* in, const int numBytes) {
+
+	_saes64 value = 0;
+
+	for (int i = numBytes - 1; i >= 0; i--)
+		value = (value << 8) | in[i];
+
+	return value;
+
+}
+
+/**
+Decipher data at any plaintext offset, the leading partial block through a block on the stack.
+
+@param saes (IN) Cipher context.
+@param nonce (IN) Nonce derived from password.
+@param pos (IN) Plaintext offset of data[0].
+@param data (IN/OUT) Ciphertext, deciphered in place.
+@param len (IN) Bytes of data.
+*/
+static void applyKeystreamAt(const SAES& saes, const byte* nonce, const _saes64 pos, byte* data, const _saes64 len) {
+
+	byte block[SAES_BLOCK_BYTES] = { 0x00 };
+	_saes64 headLen = 0;
+
+	if (pos % SAES_BLOCK_BYTES) {
+		headLen = std::min((_saes64)(SAES_BLOCK_BYTES - (pos % SAES_BLOCK_BYTES)), len);
+		memcpy(block + (pos % SAES_BLOCK_BYTES), data, (size_t)headLen);
+		saes.applyKeystream(nonce, pos / SAES_BLOCK_BYTES, block, SAES_BLOCK_BYTES);
+		memcpy(data, block + (pos % SAES_BLOCK_BYTES), (size_t)headLen);
+	}
+
+	if (len > headLen)
+		saes.applyKeystream(nonce, (pos + headLen) / SAES_BLOCK_BYTES, data + headLen, len - headLen);
+
+}
+
+// constructor, empty index to be read from a file
+SAESChunkIndex::SAESChunkIndex() :
+	chunkSize(SAES_CHUNK_SIZE),
+	plainSize(0),
+	storedSize(0),
+	numChunks(0),
+	firstChunk(0)
+{}
+
+/**
+Build index of a contiguous layout, every chunk stored as plain CTR ciphertext at its plaintext offset.
+
+@param _plainSize (IN) Bytes of plaintext.
+@param _chunkSize (IN) Plaintext bytes per chunk, a multiple of SAES_BLOCK_BYTES.
+*/
+SAESChunkIndex::SAESChunkIndex(const _saes64 _plainSize, const unsigned int _chunkSize) :
+	chunkSize(_chunkSize),
+	plainSize(_plainSize),
+	storedSize(_plainSize),
+	numChunks((_plainSize / _chunkSize) + ((_plainSize % _chunkSize) ? 1 : 0)),
+	firstChunk(0)
+{
+
+	chunks.resize((size_t)numChunks);
+	for (_saes64 i = 0; i < numChunks; i++) {
+		chunks[i].offset = getPlainOffset(i);
+		chunks[i].plainLen = (unsigned int)std::min((_saes64)chunkSize, plainSize - chunks[i].offset);
+		chunks[i].storedLen = chunks[i].plainLen;
+		chunks[i].checksum = 0;
+		chunks[i].flags = 0;
+	}
+
+}
+
+/**
+Check SAES trailer padding block for a version 2 file.
+
+@param padding (IN) Padding block of the SAES headers.
+
+@return True if the file is chunked, false if it is version 1.
+
+@throw Throws FileException() if the file is from a newer format version.
+*/
+bool SAESChunkIndex::isChunked(const byte* padding) {
+
+	// version 1 leaves the padding block zero after the padding length
+	if (padding[1] == 0)
+		return false;
+	if (padding[1] != SAES_FORMAT_VERSION_2)
+		throw FileException("Unsupported SAES file version. Exiting program.\n");
+
+	return true;
+
+}
+
+/**
+Get plaintext size from a version 2 trailer padding block.
+
+@param padding (IN) Padding block of the SAES headers.
+
+@return Bytes of plaintext.
+*/
+_saes64 SAESChunkIndex::getPlainSize(const byte* padding) {
+	return loadLE(padding + 8, 8);
+}
+
+/**
+Fill trailer padding block with version, chunk size and plaintext size. SAES::writeHeaders() adds the padding length.
+
+@param padding (OUT) Padding block of SAES_MAX_PADDING_BYTES.
+*/
+void SAESChunkIndex::storeTrailer(byte* padding) const {
+
+	memset(padding, 0, SAES_MAX_PADDING_BYTES);
+	padding[1] = SAES_FORMAT_VERSION_2;
+	storeLE(padding + 4, chunkSize, 4);
+	storeLE(padding + 8, plainSize, 8);
+
+}
+
+/**
+Read index of a version 2 file through a file descriptor.
+
+@param fd (IN) Descriptor of SAES file.
+@param fileSize (IN) Size of file.
+@param padding (IN) Padding block of the SAES headers.
+
+@throw Throws FileException() if the index could not be read or does not fit the file.
+*/
+void SAESChunkIndex::read(const int fd, const _saes64 fileSize, const byte* padding) {
+
+	setLayout(padding, fileSize);
+	readEntries(fd, 0, numChunks);
+
+}
+
+/**
+Read only the index entries covering a plaintext range, so a small read of a large file stays small.
+
+@param fd (IN) Descriptor of SAES file.
+@param fileSize (IN) Size of file.
+@param padding (IN) Padding block of the SAES headers.
+@param plainOffset (IN) Plaintext offset of range, less than the plaintext size.
+@param plainLen (IN) Bytes of range, at least 1 and not past the plaintext size.
+
+@throw Throws FileException() if the index could not be read or does not fit the file.
+*/
+void SAESChunkIndex::read(const int fd, const _saes64 fileSize, const byte* padding, const _saes64 plainOffset, const _saes64 plainLen) {
+
+	setLayout(padding, fileSize);
+	if ((plainOffset >= plainSize) || (plainLen == 0) || (plainLen > plainSize - plainOffset))
+		throw FileException("Error reading SAES chunk index. Exiting program.\n");
+	readEntries(fd, findChunk(plainOffset), findChunk(plainOffset + plainLen - 1) + 1 - findChunk(plainOffset));
+
+}
+
+/**
+Read index of a version 2 file held in memory.
+
+@param fileData (IN) File contents, such as a memory mapping of the file.
+@param fileSize (IN) Size of file held by fileData.
+@param padding (IN) Padding block of the SAES headers.
+
+@throw Throws FileException() if the index does not fit the file.
+*/
+void SAESChunkIndex::read(const byte* fileData, const _saes64 fileSize, const byte* padding) {
+
+	setLayout(padding, fileSize);
+	firstChunk = 0;
+	chunks.resize((size_t)numChunks);
+	parse(fileData + storedSize);
+
+}
+
+/**
+Write index entries, laid out as in front of the SAES headers.
+
+@param out (OUT) Buffer of getIndexBytes() bytes.
+*/
+void SAESChunkIndex::write(byte* out) const {
+
+	for (const SAESChunk& chunk : chunks) {
+		storeLE(out, chunk.offset, 8);
+		storeLE(out + 8, chunk.storedLen, 4);
+		storeLE(out + 12, chunk.plainLen, 4);
+		storeLE(out + 16, chunk.checksum, 4);
+		storeLE(out + 20, chunk.flags, 4);
+		out += SAES_CHUNK_ENTRY_BYTES;
+	}
+
+}
+
+/**
+Record where and how a chunk is stored, once it has been encoded. Chunks are set in file order; the stored chunk region
+ends with the last one set.
+
+@param chunk (IN) Chunk number.
+@param offset (IN) File offset of stored bytes.
+@param storedLen (IN) Stored bytes.
+@param checksum (IN) CRC32C of stored bytes.
+@param flags (IN) Chunk encoding, 0, SAES_CHUNK_FLAG_LZ4 or SAES_CHUNK_FLAG_HOLE.
+*/
+void SAESChunkIndex::setChunk(const _saes64 chunk, const _saes64 offset, const unsigned int storedLen, const unsigned int checksum, const unsigned int flags) {
+
+	SAESChunk& entry = chunks[(size_t)(chunk - firstChunk)];
+
+	entry.offset = offset;
+	entry.storedLen = storedLen;
+	entry.checksum = checksum;
+	entry.flags = flags;
+	storedSize = offset + storedLen;
+
+}
+
+/**
+Record the checksum of a chunk stored in place, such as one kept from a previous encryption.
+
+@param chunk (IN) Chunk number.
+@param checksum (IN) CRC32C of stored bytes.
+*/
+void SAESChunkIndex::setChecksum(const _saes64 chunk, const unsigned int checksum) {
+	chunks[(size_t)(chunk - firstChunk)].checksum = checksum;
+}
+
+/**
+Fold stored bytes of a contiguous layout into the checksums of the chunks they fall in, as the body is ciphered. The
+pieces of one chunk must come in order and from one thread at a time; different chunks may be checksummed concurrently.
+
+@param offset (IN) File offset of stored bytes.
+@param stored (IN) Stored bytes.
+@param len (IN) Bytes of stored, not past the stored chunk region.
+*/
+void SAESChunkIndex::updateChecksums(const _saes64 offset, const byte* stored, const _saes64 len) {
+
+	_saes64 done = 0;
+
+	while (done < len) {
+		SAESChunk& entry = chunks[(size_t)(findChunk(offset + done) - firstChunk)];
+		_saes64 partLen = std::min(entry.offset + entry.storedLen - (offset + done), len - done);
+		entry.checksum = CRC32C::update(entry.checksum, stored + done, partLen);
+		done += partLen;
+	}
+
+}
+
+/**
+Mark chunks of a sparse file that lie wholly in holes. Only the file system's extent map is consulted, no data is read.
+
+@param fd (IN) Descriptor of plaintext file.
+*/
+void SAESChunkIndex::findHoles(const int fd) {
+
+	_saes64 chunk = 0;
+
+	while (chunk < numChunks) {
+
+		// every chunk ending at or before the next data is a hole
+		_saes64 data = FileIO::seekData(fd, getPlainOffset(chunk), plainSize);
+		for (; (chunk < numChunks) && (getPlainOffset(chunk) + chunks[(size_t)chunk].plainLen <= data); chunk++) {
+			chunks[(size_t)chunk].storedLen = 0;
+			chunks[(size_t)chunk].flags = SAES_CHUNK_FLAG_HOLE;
+		}
+
+		// chunk holding the data
+		chunk++;
+
+	}
+
+}
+
+/**
+Get size of index entries.
+
+@return Bytes of index, excluding the SAES headers.
+*/
+_saes64 SAESChunkIndex::getIndexBytes() const {
+	return numChunks * SAES_CHUNK_ENTRY_BYTES;
+}
+
+/**
+Get number of chunks.
+
+@return Number of chunks.
+*/
+_saes64 SAESChunkIndex::getNumChunks() const {
+	return numChunks;
+}
+
+/**
+Get plaintext chunk size.
+
+@return Plaintext bytes per chunk, all but the last chunk.
+*/
+unsigned int SAESChunkIndex::getChunkSize() const {
+	return chunkSize;
+}
+
+/**
+Get plaintext size.
+
+@return Bytes of plaintext.
+*/
+_saes64 SAESChunkIndex::getPlainSize() const {
+	return plainSize;
+}
+
+/**
+Get size of the stored chunk region, which is also the file offset of the index.
+
+@return Bytes of stored chunks.
+*/
+_saes64 SAESChunkIndex::getStoredSize() const {
+	return storedSize;
+}
+
+/**
+Find chunk holding a plaintext offset.
+
+@param plainOffset (IN) Plaintext offset, less than getPlainSize().
+
+@return Chunk number.
+*/
+_saes64 SAESChunkIndex::findChunk(const _saes64 plainOffset) const {
+	return plainOffset / chunkSize;
+}
+
+/**
+Get plaintext offset of a chunk.
+
+@param chunk (IN) Chunk number.
+
+@return Plaintext offset of first byte of chunk.
+*/
+_saes64 SAESChunkIndex::getPlainOffset(const _saes64 chunk) const {
+	return chunk * chunkSize;
+}
+
+/**
+Get CTR counter of a chunk.
+
+@param chunk (IN) Chunk number.
+
+@return Counter of first block of chunk.
+*/
+_saes64 SAESChunkIndex::getCounter(const _saes64 chunk) const {
+	return getPlainOffset(chunk) / SAES_BLOCK_BYTES;
+}
+
+/**
+Get chunk entry.
+
+@param chunk (IN) Chunk number, its entry loaded.
+
+@return Chunk entry.
+*/
+const SAESChunk& SAESChunkIndex::getChunk(const _saes64 chunk) const {
+	return chunks[(size_t)(chunk - firstChunk)];
+}
+
+/**
+Check for hole chunks among the loaded entries.
+
+@return True if any loaded chunk is a hole.
+*/
+bool SAESChunkIndex::hasHoles() const {
+
+	for (const SAESChunk& chunk : chunks)
+		if (chunk.flags == SAES_CHUNK_FLAG_HOLE)
+			return true;
+
+	return false;
+
+}
+
+/**
+Check whether a plaintext range lies wholly in hole chunks. Loaded entries must cover the range.
+
+@param plainOffset (IN) Plaintext offset of range.
+@param len (IN) Bytes of range, at least 1 and not past the plaintext size.
+
+@return True if every chunk the range touches is a hole.
+*/
+bool SAESChunkIndex::isHole(const _saes64 plainOffset, const _saes64 len) const {
+
+	for (_saes64 chunk = findChunk(plainOffset); chunk <= findChunk(plainOffset + len - 1); chunk++)
+		if (getChunk(chunk).flags != SAES_CHUNK_FLAG_HOLE)
+			return false;
+
+	return true;
+
+}
+
+/**
+Decrypt a plaintext range, split at chunk boundaries. Plain CTR chunks read only the bytes of the range; a compressed
+chunk is read and decoded whole; holes are zero filled. Loaded entries must cover the range. Chunks the range covers
+whole, and compressed chunks, are checked against their checksums; part of a plain chunk is not.
+
+@param fd (IN) Descriptor of SAES file.
+@param saes (IN) Cipher context.
+@param nonce (IN) Nonce derived from password.
+@param plainOffset (IN) Plaintext offset of range.
+@param out (OUT) Buffer of len bytes receiving plaintext.
+@param len (IN) Bytes of range, not past the plaintext size.
+
+@throw Throws FileException() if a read comes up short, a checksum does not match or a chunk does not decode.
+*/
+void SAESChunkIndex::decryptRange(const int fd, const SAES& saes, const byte* nonce, const _saes64 plainOffset, byte* out, const _saes64 len) const {
+
+	std::unique_ptr<byte[]> decoded = nullptr;
+	_saes64 done = 0;
+
+	while (done < len) {
+		_saes64 pos = plainOffset + done;
+		_saes64 i = findChunk(pos);
+		const SAESChunk& chunk = getChunk(i);
+		_saes64 within = pos - getPlainOffset(i);
+		_saes64 partLen = std::min((_saes64)chunk.plainLen - within, len - done);
+
+		if (chunk.flags == SAES_CHUNK_FLAG_HOLE)
+			memset(out + done, 0, (size_t)partLen);
+		else if (chunk.flags == 0) {
+			if (FileIO::readAt(fd, out + done, partLen, chunk.offset + within) != partLen)
+				throw FileException("Failed to read file. Exiting program.\n");
+			if (partLen == chunk.plainLen)
+				checkChunk(i, out + done);
+			applyKeystreamAt(saes, nonce, pos, out + done, partLen);
+		}
+		else {
+			// stored block, then plaintext of the whole chunk unless the range covers it
+			if (!decoded)
+				decoded = std::unique_ptr<byte[]>(new byte[(size_t)chunkSize * 2]);
+			byte* target = (partLen == chunk.plainLen) ? out + done : decoded.get() + chunkSize;
+			if (FileIO::readAt(fd, decoded.get(), chunk.storedLen, chunk.offset) != chunk.storedLen)
+				throw FileException("Failed to read file. Exiting program.\n");
+			decryptChunk(saes, nonce, i, decoded.get(), target);
+			if (target != out + done)
+				memcpy(out + done, target + within, (size_t)partLen);
+		}
+
+		done += partLen;
+	}
+
+}
+
+/**
+Decrypt one stored chunk. out may overlap stored, as when decoding a buffer in place.
+
+@param saes (IN) Cipher context.
+@param nonce (IN) Nonce derived from password.
+@param chunk (IN) Chunk number, its entry loaded.
+@param stored (IN) Stored bytes of chunk.
+@param out (OUT) Buffer of the chunk's plaintext bytes.
+
+@throw Throws FileException() if the checksum does not match or a compressed chunk does not decode.
+*/
+void SAESChunkIndex::decryptChunk(const SAES& saes, const byte* nonce, const _saes64 chunk, const byte* stored, byte* out) const {
+
+	// block buffer allocated once per thread
+	static thread_local std::unique_ptr<byte[]> blockBuffer = nullptr;
+	static thread_local _saes64 blockBufferSize = 0;
+	const SAESChunk& entry = getChunk(chunk);
+
+	if (entry.flags == SAES_CHUNK_FLAG_HOLE) {
+		memset(out, 0, entry.plainLen);
+		return;
+	}
+	checkChunk(chunk, stored);
+	if (entry.flags == 0) {
+		memmove(out, stored, entry.plainLen);
+		saes.applyKeystream(nonce, getCounter(chunk), out, entry.plainLen);
+		return;
+	}
+
+	if (entry.storedLen > blockBufferSize) {
+		blockBuffer = std::unique_ptr<byte[]>(new byte[entry.storedLen]);
+		blockBufferSize = entry.storedLen;
+	}
+
+	// a wrong password deciphers to a block that fails to decode
+	saes.applyKeystream(nonce, getCounter(chunk), stored, blockBuffer.get(), entry.storedLen);
+	if (!LZ4Codec::decompress(blockBuffer.get(), entry.storedLen, out, entry.plainLen))
+		throw FileException("SAES chunk does not decompress, wrong password or corrupted file. Exiting program.\n");
+
+}
+
+/**
+Check stored bytes of a chunk against its checksum.
+
+@param chunk (IN) Chunk number, its entry loaded.
+@param stored (IN) Stored bytes of chunk.
+
+@throw Throws FileException() if the checksum does not match.
+*/
+void SAESChunkIndex::checkChunk(const _saes64 chunk, const byte* stored) const {
+
+	const SAESChunk& entry = getChunk(chunk);
+
+	if (CRC32C::update(0, stored, entry.storedLen) != entry.checksum)
+		throw FileException("SAES chunk checksum does not match, corrupted file. Exiting program.\n");
+
+}
+
+/**
+Take chunk size and plaintext size from the padding block and place the index in front of the SAES headers.
+
+@param padding (IN) Padding block of the SAES headers.
+@param fileSize (IN) Size of file.
+
+@throw Throws FileException() if the layout does not fit the file.
+*/
+void SAESChunkIndex::setLayout(const byte* padding, const _saes64 fileSize) {
+
+	chunkSize = (unsigned int)loadLE(padding + 4, 4);
+	plainSize = getPlainSize(padding);
+	if ((chunkSize == 0) || (chunkSize % SAES_BLOCK_BYTES) || (chunkSize > SAES_CPU_BUFFER_MAX_SIZE))
+		throw FileException("Error reading SAES chunk size. Exiting program.\n");
+
+	// index and headers must fit the file
+	numChunks = (plainSize / chunkSize) + ((plainSize % chunkSize) ? 1 : 0);
+	if ((fileSize < (SAES_HEADERS * SAES_BLOCK_BYTES)) || (numChunks > (fileSize - (SAES_HEADERS * SAES_BLOCK_BYTES)) / SAES_CHUNK_ENTRY_BYTES))
+		throw FileException("Error reading SAES chunk index. Exiting program.\n");
+
+	storedSize = fileSize - (SAES_HEADERS * SAES_BLOCK_BYTES) - (numChunks * SAES_CHUNK_ENTRY_BYTES);
+
+}
+
+/**
+Read and parse a run of index entries.
+
+@param fd (IN) Descriptor of SAES file.
+@param first (IN) First chunk to load.
+@param count (IN) Chunks to load.
+
+@throw Throws FileException() if the entries could not be read or are invalid.
+*/
+void SAESChunkIndex::readEntries(const int fd, const _saes64 first, const _saes64 count) {
+
+	std::unique_ptr<byte[]> entries = std::unique_ptr<byte[]>(new byte[(size_t)(count * SAES_CHUNK_ENTRY_BYTES)]);
+
+	if (FileIO::readAt(fd, entries.get(), count * SAES_CHUNK_ENTRY_BYTES, storedSize + (first * SAES_CHUNK_ENTRY_BYTES)) != count * SAES_CHUNK_ENTRY_BYTES)
+		throw FileException("Error reading SAES chunk index. Exiting program.\n");
+
+	firstChunk = first;
+	chunks.resize((size_t)count);
+	parse(entries.get());
+
+}
+
+/**
+Parse loaded index entries, checking each chunk lies within the stored chunk region.
+
+@param entries (IN) Index entries of the loaded chunks.
+
+@throw Throws FileException() if an entry is out of range or uses an unknown encoding.
+*/
+void SAESChunkIndex::parse(const byte* entries) {
+
+	for (_saes64 i = 0; i < chunks.size(); i++) {
+
+		SAESChunk& chunk = chunks[(size_t)i];
+		const byte* entry = entries + (i * SAES_CHUNK_ENTRY_BYTES);
+
+		chunk.offset = loadLE(entry, 8);
+		chunk.storedLen = (unsigned int)loadLE(entry + 8, 4);
+		chunk.plainLen = (unsigned int)loadLE(entry + 12, 4);
+		chunk.checksum = (unsigned int)loadLE(entry + 16, 4);
+		chunk.flags = (unsigned int)loadLE(entry + 20, 4);
+
+		if (chunk.plainLen != std::min((_saes64)chunkSize, plainSize - getPlainOffset(firstChunk + i)))
+			throw FileException("Error reading SAES chunk index. Exiting program.\n");
+		if ((chunk.offset > storedSize) || (chunk.storedLen > storedSize - chunk.offset))
+			throw FileException("Error reading SAES chunk index. Exiting program.\n");
+		if ((chunk.flags == 0) && (chunk.storedLen == chunk.plainLen))
+			continue;
+		if ((chunk.flags == SAES_CHUNK_FLAG_HOLE) && (chunk.storedLen == 0))
+			continue;
+		if ((chunk.flags != SAES_CHUNK_FLAG_LZ4) || (chunk.storedLen == 0) || (chunk.storedLen >= chunk.plainLen))
+			throw FileException("Unsupported SAES chunk encoding. Exiting program.\n");
+
+	}
+
+}
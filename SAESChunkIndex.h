@@ -0,0 +1,86 @@
+#ifndef SAESCHUNKINDEX_H
+#define SAESCHUNKINDEX_H
+
+#ifdef __linux__
+#include <inttypes.h>
+#endif
+#include "SAESconstants.h"
+#include "Exceptions.h"
+#include "SAES.h"
+#include <vector>
+
+// chunk of a version 2 SAES file
+struct SAESChunk {
+	_saes64 offset; // file offset of stored bytes
+	unsigned int storedLen; // stored bytes
+	unsigned int plainLen; // plaintext bytes, the chunk size for all but the last chunk
+	unsigned int checksum; // CRC32C of stored bytes, 0 for a hole
+	unsigned int flags; // chunk encoding, 0 for plain CTR ciphertext, SAES_CHUNK_FLAG_LZ4 or SAES_CHUNK_FLAG_HOLE
+};
+
+// chunk index of a version 2 SAES file.
+// Layout: stored chunks, then SAES_CHUNK_ENTRY_BYTES of index per chunk, then the SAES_HEADERS blocks of version 1. The
+// padding block carries the version, chunk size and plaintext size, so the index sits at a known distance from the end.
+// Chunk i holds plaintext [i * chunk size, (i + 1) * chunk size) ciphered from counter i * chunk size / SAES_BLOCK_BYTES;
+// any chunk deciphers on its own, and a plaintext offset maps to its chunk by one division. Only the entries a read
+// needs have to be loaded. A compressed chunk stores an LZ4 block of its plaintext, ciphered from the same counter, and
+// is decoded whole. A hole chunk, all zero in a sparse input, stores nothing and is left a hole when decrypted.
+// Every chunk read whole is checked against the CRC32C of its stored bytes before it is deciphered.
+class SAESChunkIndex {
+
+public:
+
+	// constructor
+	SAESChunkIndex();
+	SAESChunkIndex(const _saes64, const unsigned int);
+
+	// trailer padding block
+	static bool isChunked(const byte*);
+	static _saes64 getPlainSize(const byte*);
+	void storeTrailer(byte*) const;
+
+	// index
+	void read(const int, const _saes64, const byte*);
+	void read(const int, const _saes64, const byte*, const _saes64, const _saes64);
+	void read(const byte*, const _saes64, const byte*);
+	void write(byte*) const;
+	void setChunk(const _saes64, const _saes64, const unsigned int, const unsigned int, const unsigned int);
+	void setChecksum(const _saes64, const unsigned int);
+	void updateChecksums(const _saes64, const byte*, const _saes64);
+	void findHoles(const int);
+	_saes64 getIndexBytes() const;
+
+	// lookup
+	_saes64 getNumChunks() const;
+	unsigned int getChunkSize() const;
+	_saes64 getPlainSize() const;
+	_saes64 getStoredSize() const;
+	_saes64 findChunk(const _saes64) const;
+	_saes64 getPlainOffset(const _saes64) const;
+	_saes64 getCounter(const _saes64) const;
+	const SAESChunk& getChunk(const _saes64) const;
+	bool hasHoles() const;
+	bool isHole(const _saes64, const _saes64) const;
+
+	// decryption
+	void decryptRange(const int, const SAES&, const byte*, const _saes64, byte*, const _saes64) const;
+	void decryptChunk(const SAES&, const byte*, const _saes64, const byte*, byte*) const;
+
+private:
+
+	// index
+	void setLayout(const byte*, const _saes64);
+	void readEntries(const int, const _saes64, const _saes64);
+	void parse(const byte*);
+	void checkChunk(const _saes64, const byte*) const;
+
+	std::vector<SAESChunk> chunks;
+	unsigned int chunkSize;
+	_saes64 plainSize;
+	_saes64 storedSize;
+	_saes64 numChunks;
+	_saes64 firstChunk;
+
+};
+
+#endif
@@ -0,0 +1,289 @@
+#include "SAESDecryptBuf.h"
+#include "FileIO.h"
+#include <algorithm>
+
+namespace saes {
+
+/**
+Open SAES file for decrypted reading.
+
+@param filename (IN) Name of SAES file, in a trailing-header format.
+@param password (IN) Password, SAES_MAX_KEY_BYTES bytes zero-padded past its end.
+@param cachePages (IN) Deciphered pages kept in the cache, at least 1.
+@param pageBytes (IN) Bytes per page, rounded up to SAES_BLOCK_BYTES. A random seek deciphers one page.
+
+@throw Throws FileException() if file could not be opened, is not an SAES file or has an unsupported key length.
+*/
+idecryptbuf::idecryptbuf(const char* filename, byte* password, const size_t cachePages, const size_t pageBytes) :
+	fd(-1),
+	chunked(false),
+	plainSize(0),
+	pageSize(((pageBytes + SAES_BLOCK_BYTES - 1) / SAES_BLOCK_BYTES) * SAES_BLOCK_BYTES),
+	pages(cachePages ? cachePages : 1),
+	current(nullptr),
+	seekPosition(0),
+	useClock(0),
+	lastIndex((_saes64)-1),
+	prefetchedUntil(0),
+	chunkDataIndex((_saes64)-1)
+{
+
+	byte padding[SAES_MAX_PADDING_BYTES] = { 0x00 };
+	byte filenameFormat[SAES_MAX_FILENAME_BYTES] = { 0x00 };
+	byte keylength[SAES_MAX_KEYLENGTH_BYTES] = { 0x00 };
+	int iKeylength;
+
+	if (pageSize == 0)
+		pageSize = SAES_BLOCK_BYTES;
+
+	// open file and extract SAES file header data
+	fd = FileIO::openFile(filename, FILECODE::FILE_INPUT);
+	try {
+		plainSize = SAES::extractFileSAESHeader(fd, padding, filenameFormat, keylength);
+		chunked = SAESChunkIndex::isChunked(padding);
+		if (chunked)
+			chunkIndex.read(fd, FileIO::getFileSize(fd), padding);
+	}
+	catch (FileException&) {
+		FileIO::closeFile(fd);
+		throw;
+	}
+
+	// cipher context, key length comes from the file and is checked before sizing a key schedule
+	iKeylength = (keylength[1] << 8) | (keylength[0] << 0);
+	if ((iKeylength != SAES_KEY_SIZE_128) && (iKeylength != SAES_KEY_SIZE_192) && (iKeylength != SAES_KEY_SIZE_256)) {
+		FileIO::closeFile(fd);
+		throw FileException("Unsupported SAES key length. Exiting program.\n");
+	}
+	saes = std::unique_ptr<SAES>(new SAES(iKeylength, password));
+	saes->calculateNonce(nonce, password);
+
+	// empty cache, pages allocated on first use
+	for (Page& page : pages) {
+		page.index = 0;
+		page.len = 0;
+		page.lastUse = 0;
+	}
+
+}
+
+// destructor
+idecryptbuf::~idecryptbuf() {
+
+	FileIO::closeFile(fd);
+
+}
+
+/**
+Get plaintext size, excluding padding and headers.
+
+@return Bytes of plaintext.
+*/
+_saes64 idecryptbuf::size() const {
+	return plainSize;
+}
+
+/**
+Make the page holding the read position current.
+
+@return Next character, or eof at end of plaintext.
+
+@throw Throws FileException() if file read fails.
+*/
+idecryptbuf::int_type idecryptbuf::underflow() {
+
+	_saes64 pos;
+
+	if (gptr() < egptr())
+		return traits_type::to_int_type(*gptr());
+
+	pos = position();
+	if (pos >= plainSize)
+		return traits_type::eof();
+
+	// expose page from read position on
+	current = &loadPage(pos / pageSize);
+	char* data = (char*)current->data.get();
+	setg(data, data + (pos - (current->index * pageSize)), data + current->len);
+
+	return traits_type::to_int_type(*gptr());
+
+}
+
+/**
+Move read position. Positions inside the current page need no I/O; others are deciphered on the next read.
+
+@param off (IN) Offset from dir.
+@param dir (IN) Base position.
+@param which (IN) Must include std::ios_base::in.
+
+@return New position, or -1 if outside the plaintext.
+*/
+idecryptbuf::pos_type idecryptbuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+
+	off_type base, target;
+
+	if (!(which & std::ios_base::in))
+		return pos_type(off_type(-1));
+
+	// resolve target
+	if (dir == std::ios_base::beg)
+		base = 0;
+	else if (dir == std::ios_base::cur)
+		base = (off_type)position();
+	else
+		base = (off_type)plainSize;
+	target = base + off;
+	if ((target < 0) || ((_saes64)target > plainSize))
+		return pos_type(off_type(-1));
+
+	// stay in current page, else defer to next read
+	if (current && ((_saes64)target >= current->index * pageSize) && ((_saes64)target < (current->index * pageSize) + current->len))
+		setg(eback(), eback() + ((_saes64)target - (current->index * pageSize)), egptr());
+	else {
+		current = nullptr;
+		setg(nullptr, nullptr, nullptr);
+		seekPosition = (_saes64)target;
+	}
+
+	return pos_type(target);
+
+}
+
+/**
+Move read position from the start of the plaintext.
+
+@param pos (IN) New position.
+@param which (IN) Must include std::ios_base::in.
+
+@return New position, or -1 if outside the plaintext.
+*/
+idecryptbuf::pos_type idecryptbuf::seekpos(pos_type pos, std::ios_base::openmode which) {
+	return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+/**
+Count characters left before end of plaintext.
+
+@return Characters left, or -1 at end of plaintext.
+*/
+std::streamsize idecryptbuf::showmanyc() {
+
+	_saes64 pos = position();
+
+	if (pos >= plainSize)
+		return -1;
+
+	return (std::streamsize)(plainSize - pos);
+
+}
+
+/**
+Find page in cache, deciphering it into the least recently used slot on a miss.
+
+@param index (IN) Page index, plaintext offset / page size.
+
+@return Cached page.
+
+@throw Throws FileException() if file read fails.
+*/
+idecryptbuf::Page& idecryptbuf::loadPage(const _saes64 index) {
+
+	Page* victim = &pages[0];
+	_saes64 offset = index * pageSize;
+	bool sequential = (index == lastIndex + 1);
+
+	lastIndex = index;
+
+	// cache hit
+	for (Page& page : pages) {
+		if (page.data && (page.index == index)) {
+			page.lastUse = ++useClock;
+			return page;
+		}
+		if (!page.data || (victim->data && (page.lastUse < victim->lastUse)))
+			victim = &page;
+	}
+
+	// sequential reads keep the next stretch of file on its way into the page cache
+	if (sequential && (offset + pageSize + (SAES_DECRYPTBUF_READAHEAD / 2) > prefetchedUntil)) {
+		_saes64 from = (prefetchedUntil > offset) ? prefetchedUntil : offset;
+		FileIO::prefetch(fd, from, offset + pageSize + SAES_DECRYPTBUF_READAHEAD - from);
+		prefetchedUntil = offset + pageSize + SAES_DECRYPTBUF_READAHEAD;
+	}
+
+	// decipher page, only the blocks it spans
+	if (!victim->data)
+		victim->data = std::unique_ptr<byte[]>(new byte[pageSize]);
+	victim->index = index;
+	victim->len = (pageSize < plainSize - offset) ? pageSize : plainSize - offset;
+	victim->lastUse = ++useClock;
+	try {
+		if (chunked)
+			readChunked(offset, victim->data.get(), victim->len);
+		else if (FileIO::readAt(fd, victim->data.get(), victim->len, offset) != victim->len)
+			throw FileException("Failed to read file. Exiting program.\n");
+	}
+	catch (FileException&) {
+		victim->data = nullptr;
+		throw;
+	}
+	if (!chunked)
+		saes->applyKeystream(nonce, offset / SAES_BLOCK_BYTES, victim->data.get(), victim->len);
+
+	return *victim;
+
+}
+
+/**
+Decrypt a plaintext range of a version 2 file. Holes read as zeros; any other chunk is read whole once, checked
+against its checksum, decoded and copied from while reads stay in it.
+
+@param offset (IN) Plaintext offset of range.
+@param out (OUT) Buffer of len bytes.
+@param len (IN) Bytes of range, not past the plaintext size.
+
+@throw Throws FileException() if file read fails, a checksum does not match or a chunk does not decode.
+*/
+void idecryptbuf::readChunked(const _saes64 offset, byte* out, const _saes64 len) {
+
+	_saes64 done = 0;
+
+	while (done < len) {
+		_saes64 chunk = chunkIndex.findChunk(offset + done);
+		_saes64 within = offset + done - chunkIndex.getPlainOffset(chunk);
+		_saes64 partLen = std::min((_saes64)chunkIndex.getChunk(chunk).plainLen - within, len - done);
+
+		if (chunkIndex.getChunk(chunk).flags == SAES_CHUNK_FLAG_HOLE)
+			chunkIndex.decryptRange(fd, *saes, nonce, offset + done, out + done, partLen);
+		else {
+			if (chunkDataIndex != chunk) {
+				if (!chunkData)
+					chunkData = std::unique_ptr<byte[]>(new byte[chunkIndex.getChunkSize()]);
+				chunkDataIndex = (_saes64)-1;
+				chunkIndex.decryptRange(fd, *saes, nonce, chunkIndex.getPlainOffset(chunk), chunkData.get(), chunkIndex.getChunk(chunk).plainLen);
+				chunkDataIndex = chunk;
+			}
+			memcpy(out + done, chunkData.get() + within, (size_t)partLen);
+		}
+
+		done += partLen;
+	}
+
+}
+
+/**
+Get read position.
+
+@return Plaintext offset of next character.
+*/
+_saes64 idecryptbuf::position() const {
+
+	if (current)
+		return (current->index * pageSize) + (gptr() - eback());
+
+	return seekPosition;
+
+}
+
+}
@@ -0,0 +1,83 @@
+#ifndef SAESDECRYPTBUF_H
+#define SAESDECRYPTBUF_H
+
+#ifdef __linux__
+#include <inttypes.h>
+#endif
+#include "SAESconstants.h"
+#include "Exceptions.h"
+#include "SAES.h"
+#include "SAESChunkIndex.h"
+#include <memory>
+#include <streambuf>
+#include <vector>
+
+namespace saes {
+
+// read-only, seekable plaintext view of an SAES file for std::istream.
+// Plaintext is deciphered in pages on demand and kept in a least recently used cache, so a random seek costs only the
+// page it lands in, or for version 2 the chunk; sequential reads also prefetch ahead in the page cache. Usage: saes::idecryptbuf buf(path, pw); std::istream in(&buf);
+// The password is the key: SAES_MAX_KEY_BYTES bytes, zero-padded past its end.
+// Version 1 tags and checksums cover whole bodies and are not checked by page reads. A version 2 chunk is read whole on
+// its first page, checked against its chunk checksum, decoded and kept for the pages after it.
+class SAES_API idecryptbuf : public std::streambuf {
+
+public:
+
+	// constructor
+	idecryptbuf(const char*, byte*, const size_t = SAES_DECRYPTBUF_CACHE_PAGES, const size_t = SAES_DECRYPTBUF_PAGE_SIZE);
+
+	// destructor
+	~idecryptbuf();
+
+	// plaintext size
+	_saes64 size() const;
+
+protected:
+
+	// std::streambuf
+	int_type underflow() override;
+	pos_type seekoff(off_type, std::ios_base::seekdir, std::ios_base::openmode = std::ios_base::in) override;
+	pos_type seekpos(pos_type, std::ios_base::openmode = std::ios_base::in) override;
+	std::streamsize showmanyc() override;
+
+private:
+
+	// deciphered page held by the cache
+	struct Page {
+		_saes64 index;
+		_saes64 len;
+		_saes64 lastUse;
+		std::unique_ptr<byte[]> data;
+	};
+
+	// not copyable, owns file
+	idecryptbuf(const idecryptbuf&);
+	idecryptbuf& operator=(const idecryptbuf&);
+
+	// cache
+	Page& loadPage(const _saes64);
+	void readChunked(const _saes64, byte*, const _saes64);
+	_saes64 position() const;
+
+	int fd;
+	SAESChunkIndex chunkIndex;
+	bool chunked;
+	std::unique_ptr<SAES> saes;
+	byte nonce[SAES_NONCE_SIZE_BYTES];
+	_saes64 plainSize;
+	_saes64 pageSize;
+	std::vector<Page> pages;
+	Page* current;
+	_saes64 seekPosition;
+	_saes64 useClock;
+	_saes64 lastIndex;
+	_saes64 prefetchedUntil;
+	std::unique_ptr<byte[]> chunkData;
+	_saes64 chunkDataIndex;
+
+};
+
+}
+
+#endif
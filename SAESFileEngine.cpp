@@ -0,0 +1,1545 @@
+#include "SAESFileEngine.h"
+#include "SAESStream.h"
+#include "BatchScheduler.h"
+#include "MappedFile.h"
+#include "FileIO.h"
+#include "CTimer.h"
+#include "GPUKernel.h"
+#include "LZ4Codec.h"
+#include "CRC32C.h"
+#include "SAESManifest.h"
+#include <atomic>
+#include <algorithm>
+
+/**
+Round length up to SAES_DIRECT_IO_ALIGNMENT.
+
+@param len (IN) Length in bytes.
+
+@return Aligned length.
+*/
+static _saes64 alignDirect(const _saes64 len) {
+	return (len + SAES_DIRECT_IO_ALIGNMENT - 1) & ~(_saes64)(SAES_DIRECT_IO_ALIGNMENT - 1);
+}
+
+/**
+Round buffer address up to SAES_DIRECT_IO_ALIGNMENT. The buffer needs SAES_DIRECT_IO_ALIGNMENT spare bytes.
+
+@param buffer (IN) Allocated buffer.
+
+@return Aligned address within buffer.
+*/
+static byte* alignDirect(byte* buffer) {
+	return (byte*)(((uintptr_t)buffer + SAES_DIRECT_IO_ALIGNMENT - 1) & ~(uintptr_t)(SAES_DIRECT_IO_ALIGNMENT - 1));
+}
+
+/**
+Build engine backend: GPU if requested and available for version 1 encryption, and CPU worker pool or asynchronous
+I/O pipeline for everything else. The GPU program is built on the first file encrypted on the GPU, so runs that never
+use it do not pay for it.
+
+@param _options (IN) Engine settings.
+*/
+SAESFileEngine::SAESFileEngine(const SAESEngineOptions& _options) :
+	options(_options),
+	gpu(nullptr),
+	gpuEnabled(false),
+	pool(nullptr),
+	aio(nullptr),
+	cipher(nullptr),
+	cipherKeylength(-1)
+{
+
+	std::unique_ptr<byte[]> gpuName = nullptr;
+
+	memset(cipherPassword, 0, sizeof(cipherPassword));
+
+	/* Find device and set GPU/CPU execution mode */
+	if (options.useGPU) {
+		gpu = std::unique_ptr<GPU>(new GPU(gpuKernelSource, sizeof(gpuKernelSource) - 1));
+		try {
+			gpu->findDevice(gpuName);
+			if (options.verbose)
+				printf("Using GPU device: '%s' \n", gpuName.get());
+			gpuEnabled = true;
+		}
+		catch (GPUException& e) {
+			if (options.verbose) {
+				printf(e.getError());
+				printf("Defaulting to CPU execution.\n");
+			}
+			gpuEnabled = false;
+		}
+	}
+
+	// report CPU cipher backend, decryption and version 2 always run on the CPU
+	if (options.verbose) {
+		if (AESNI::isSupported())
+			printf("Using AES-NI hardware cipher.\n");
+		else
+			printf("Using T-table software cipher.\n");
+	}
+
+	// start CPU worker pool, files encrypted on the GPU do not use it
+	if (options.numThreads != 1) {
+		pool = std::unique_ptr<ThreadPool>(new ThreadPool(options.numThreads));
+		if (options.verbose)
+			printf("Using %u CPU threads.\n", pool->getNumThreads());
+	}
+
+	// start single-threaded I/O pipeline, decryption always runs on the CPU
+	if (!pool) {
+		aio = std::unique_ptr<AsyncIO>(new AsyncIO(SAES_IO_QUEUE_DEPTH));
+		if (options.verbose) {
+			if (aio->usingIOUring())
+				printf("Using io_uring asynchronous I/O.\n");
+			else
+				printf("Using threaded asynchronous I/O.\n");
+		}
+	}
+
+}
+
+// destructor
+SAESFileEngine::~SAESFileEngine() {}
+
+/**
+Encrypt file into filename stem + SAES_FILE_FORMAT and remove the input. Version 2, authenticated and checksummed
+output always run on the CPU.
+
+@param filename (IN) Name of file, must contain a '.'.
+@param password (IN) Password.
+@param iKeylength (IN) Key size in integer form.
+
+@throw Throws FileException() if a file could not be read or written, GPUException() if the GPU failed. Partial output
+is removed and the input kept.
+*/
+void SAESFileEngine::encryptFile(const char* filename, byte* password, const int iKeylength) {
+
+	std::fstream inFile = {};
+	std::fstream outFile = {};
+	int paddingLen = -1;
+	int inFd = -1, outFd = -1;
+	_saes64 inputFilesize = -1;
+	_saes64 outputFilesize = -1;
+	_saes64 bufferSize = -1;
+	byte filenameFormat[SAES_MAX_FILENAME_BUFFER_SIZE] = { 0x00 };
+	byte padding[SAES_MAX_PADDING_BYTES] = { 0x00 };
+	byte newFilename[SAES_MAX_FILENAME_BUFFER_SIZE] = { 0x00 };
+	byte nonce[SAES_NONCE_SIZE_BYTES] = { 0x00 };
+	byte keylength[SAES_MAX_KEYLENGTH_BYTES] = { 0x00 };
+	CTimer timer = {};
+	char timerDescription[SAES_MAX_FILENAME_BUFFER_SIZE] = { 0x00 };
+	MappedFile inMap, outMap;
+	bool memoryMapped = false;
+	bool outputCreated = false;
+	bool chunked = (options.formatVersion == SAES_FORMAT_VERSION_2);
+	bool onGPU = encryptsOnGPU() && prepareGPU();
+	SAESChunkIndex index;
+	_saes64 trailerSize;
+	std::unique_ptr<byte[]> trailer = nullptr;
+	std::unique_ptr<SAESAuth> auth = nullptr;
+	byte* headers;
+	SAES& saes = getCipher(password, iKeylength);
+
+	if (chunked && (getAuthFlag() != 0))
+		throw FileException("Authentication and checksums need SAES file format version 1. Exiting program.\n");
+	if (options.authenticate && options.checksum)
+		throw FileException("Authentication already covers the checksum. Exiting program.\n");
+	if (options.compress && !chunked)
+		throw FileException("Compression needs SAES file format version 2. Exiting program.\n");
+	if (options.incremental && (!chunked || options.compress))
+		throw FileException("Incremental encryption needs SAES file format version 2 without compression. Exiting program.\n");
+
+	// start timer
+	timer.start();
+
+	// extract input file format and set output filename
+	SAES::setNewFilename((byte*)filename, newFilename, filenameFormat);
+
+	// get file size, version 2 also maps the holes of a sparse input
+	inFd = FileIO::openFile(filename, FILECODE::FILE_INPUT);
+	try {
+		inputFilesize = FileIO::getFileSize(inFd);
+		if (chunked) {
+			index = SAESChunkIndex(inputFilesize, SAES_CHUNK_SIZE);
+			index.findHoles(inFd);
+		}
+	}
+	catch (FileException&) {
+		FileIO::closeFile(inFd);
+		throw;
+	}
+	FileIO::closeFile(inFd);
+	inFd = -1;
+
+	// calculate file information, version 2 chunks are not padded
+	SAES::setNewFilesize(inputFilesize, paddingLen, outputFilesize);
+	if (chunked) {
+		index.storeTrailer(padding);
+		if (options.incremental)
+			SAESManifest::storeRunId(keylength);
+		paddingLen = 0;
+		outputFilesize = inputFilesize;
+	}
+	bufferSize = selectBufferSize(outputFilesize);
+
+	// chunk index, salt and tag blocks or checksum block, then SAES headers following the body
+	padding[2] = getAuthFlag();
+	trailerSize = (chunked ? index.getIndexBytes() : 0) + SAESAuth::getAuthBytes(padding) + (SAES_HEADERS * SAES_BLOCK_BYTES);
+	trailer = std::unique_ptr<byte[]>(new byte[trailerSize]);
+	headers = trailer.get() + trailerSize - (SAES_HEADERS * SAES_BLOCK_BYTES);
+	SAES::writeHeaders(headers, padding, paddingLen, filenameFormat, keylength, iKeylength);
+
+	// tag or checksums, filled in once the body is ciphered
+	if (options.authenticate)
+		SAESAuth::generateSalt(trailer.get());
+	if (SAESAuth::hasAuthBlocks(padding))
+		auth = std::unique_ptr<SAESAuth>(new SAESAuth(saes, OPCODE::ENCRYPTION, trailer.get(), headers));
+
+	// calculate nonce
+	SAES::calculateNonce(nonce, password);
+	memoryMapped = !onGPU && !options.compress && !options.incremental && !index.hasHoles() && options.memoryMap && MappedFile::fitsAddressSpace(outputFilesize + trailerSize);
+	describeRun(timerDescription, sizeof(timerDescription), onGPU, memoryMapped, bufferSize);
+
+	// on failure close everything and remove partial output, the input is kept
+	auto removeOutput = [&]() {
+		if (inFile.is_open())
+			saes.closeFile(inFile);
+		if (outFile.is_open())
+			saes.closeFile(outFile);
+		inMap.unmap();
+		outMap.unmap();
+		if (inFd >= 0)
+			FileIO::closeFile(inFd);
+		if (outFd >= 0)
+			FileIO::closeFile(outFd);
+		if (outputCreated)
+			SAES::deleteFile((const char*)newFilename);
+	};
+
+	try {
+		// incremental, unchanged chunks of the existing output are kept, so it is not removed on failure
+		if (options.incremental) {
+			_saes64 numWritten = updateChunks(saes, nonce, index, filename, (const char*)newFilename, trailer.get(), trailerSize);
+			snprintf(timerDescription, sizeof(timerDescription), "%llu of %llu chunks rewritten", (unsigned long long)numWritten, (unsigned long long)index.getNumChunks());
+		}
+		// GPU/CPU execution
+		else if (onGPU) {
+
+			// open files
+			SAES::openFile(inFile, filename, FILECODE::FILE_INPUT);
+			SAES::openFile(outFile, (const char*)newFilename, FILECODE::FILE_OUTPUT);
+			outputCreated = true;
+
+			// cipher body on device
+			gpuCipherFile(saes, nonce, inFile, outFile, inputFilesize, outputFilesize);
+
+			// Write SAES headers to end of file, a stream that failed anywhere in the body fails here
+			outFile.write((const char*)trailer.get(), trailerSize);
+			if (!outFile.flush())
+				throw FileException("Failed to write file. Exiting program.\n");
+
+			// close files
+			saes.closeFile(inFile);
+			saes.closeFile(outFile);
+
+		}
+		else if (memoryMapped) {
+
+			// output exists once mapOutput() starts, even if sizing it fails
+			inMap.mapInput(filename);
+			outputCreated = true;
+			outMap.mapOutput((const char*)newFilename, outputFilesize + trailerSize);
+
+			// cipher body between mappings
+			cipherMemory(saes, nonce, inMap.getData(), outMap.getData(), inputFilesize, outputFilesize, auth.get(), chunked ? &index : nullptr);
+
+			// Write SAES headers to end of file, the chunk index carries the checksums taken while ciphering
+			if (auth)
+				auth->storeTag(trailer.get());
+			if (chunked)
+				index.write(trailer.get());
+			memcpy(outMap.getData() + outputFilesize, trailer.get(), (size_t)trailerSize);
+
+			inMap.unmap();
+			outMap.unmap();
+
+		}
+		else {
+
+			inFd = FileIO::openFile(filename, FILECODE::FILE_INPUT, options.cacheMode);
+			outFd = FileIO::openFile((const char*)newFilename, FILECODE::FILE_OUTPUT, options.cacheMode);
+			outputCreated = true;
+
+			// cipher all chunks, compressed chunks and holes move the index to the end of the smaller body
+			if (options.compress || index.hasHoles()) {
+				packChunks(saes, nonce, index, inFd, outFd);
+				outputFilesize = index.getStoredSize();
+			}
+			else if (pool)
+				parallelCipherFile(saes, nonce, inFd, outFd, inputFilesize, outputFilesize, auth.get(), chunked ? &index : nullptr);
+			else
+				pipelinedCipherFile(saes, nonce, inFd, outFd, inputFilesize, outputFilesize, bufferSize, auth.get(), chunked ? &index : nullptr);
+
+			// Write SAES headers to end of file, the chunk index carries the checksums taken while ciphering
+			if (auth)
+				auth->storeTag(trailer.get());
+			if (chunked)
+				index.write(trailer.get());
+			FileIO::writeAt(outFd, trailer.get(), trailerSize, outputFilesize);
+
+			FileIO::closeFile(inFd);
+			FileIO::closeFile(outFd);
+			inFd = -1;
+			outFd = -1;
+
+		}
+	}
+	catch (FileException&) {
+		removeOutput();
+		throw;
+	}
+	catch (GPUException&) {
+		removeOutput();
+		throw;
+	}
+
+	// remove input file, incremental runs read it again next time
+	if (!options.incremental)
+		SAES::deleteFile(filename);
+
+	// end timer
+	timer.end();
+
+	// print timer
+	if (options.verbose)
+		timer.printTime(timerDescription);
+
+}
+
+/**
+Decrypt SAES file, version 1, version 2 or framed, into filename stem + original file format and remove the input. The
+tag or checksums of a version 1 file are checked in the same pass; on any failure the partial output is removed and the
+input kept.
+
+@param filename (IN) Name of SAES file, must contain a '.'.
+@param password (IN) Password.
+
+@throw Throws FileException() if a file could not be read or written, the input is not an SAES file or its tag or
+checksums do not match.
+*/
+void SAESFileEngine::decryptFile(const char* filename, byte* password) {
+
+	int paddingLen = -1;
+	int iKeylength = -1;
+	int inFd = -1, outFd = -1;
+	_saes64 inputFilesize = -1;
+	_saes64 outputFilesize = -1;
+	_saes64 bufferSize = -1;
+	byte streamHeader[SAES_STREAM_HEADER_BYTES] = { 0x00 };
+	byte filenameFormat[SAES_MAX_FILENAME_BYTES] = { 0x00 };
+	byte padding[SAES_MAX_PADDING_BYTES] = { 0x00 };
+	byte newFilename[SAES_MAX_FILENAME_BUFFER_SIZE] = { 0x00 };
+	byte nonce[SAES_NONCE_SIZE_BYTES] = { 0x00 };
+	byte keylength[SAES_MAX_KEYLENGTH_BYTES] = { 0x00 };
+	CTimer timer = {};
+	char timerDescription[SAES_MAX_FILENAME_BUFFER_SIZE] = { 0x00 };
+	MappedFile inMap, outMap;
+	bool memoryMapped = false;
+	bool framed = false;
+	bool chunked = false;
+	bool outputCreated = false;
+	SAESChunkIndex index;
+	std::unique_ptr<SAESAuth> auth = nullptr;
+	byte authBlocks[(SAES_AUTH_BLOCKS + SAES_HEADERS) * SAES_BLOCK_BYTES];
+	_saes64 authBytes = 0;
+
+	// start timer
+	timer.start();
+
+	try {
+		// open input file
+		inFd = FileIO::openFile(filename, FILECODE::FILE_INPUT);
+
+		// get file size
+		inputFilesize = FileIO::getFileSize(inFd);
+
+		// framed files carry their header in front, others at the end
+		if ((inputFilesize >= SAES_STREAM_HEADER_BYTES) && (FileIO::readStream(inFd, streamHeader, SAES_STREAM_HEADER_BYTES) == SAES_STREAM_HEADER_BYTES))
+			framed = SAESStream::readHeader(streamHeader, iKeylength, filenameFormat);
+		if (!framed) {
+			outputFilesize = SAES::extractFileSAESHeader(inFd, padding, filenameFormat, keylength);
+			paddingLen = padding[0];
+			iKeylength = (keylength[1] << 8) | (keylength[0] << 0);
+			chunked = SAESChunkIndex::isChunked(padding);
+		}
+		if (chunked)
+			index.read(inFd, inputFilesize, padding);
+
+		SAES& saes = getCipher(password, iKeylength);
+
+		// salt and tag or checksum blocks, and headers
+		if (!framed && SAESAuth::hasAuthBlocks(padding)) {
+			authBytes = SAESAuth::getAuthBytes(padding);
+			if (FileIO::readAt(inFd, authBlocks, authBytes + (SAES_HEADERS * SAES_BLOCK_BYTES), inputFilesize - authBytes - (SAES_HEADERS * SAES_BLOCK_BYTES)) != authBytes + (SAES_HEADERS * SAES_BLOCK_BYTES))
+				throw FileException("Error reading SAES header padding. Exiting program.\n");
+			auth = std::unique_ptr<SAESAuth>(new SAESAuth(saes, OPCODE::DECRYPTION, authBlocks, authBlocks + authBytes));
+		}
+
+		// set output filename
+		SAES::setDecryptedFilename((const byte*)filename, newFilename, filenameFormat);
+
+		// calculate nonce
+		SAES::calculateNonce(nonce, password);
+		bufferSize = selectBufferSize(outputFilesize);
+		memoryMapped = !framed && !chunked && options.memoryMap && MappedFile::fitsAddressSpace(inputFilesize);
+		describeRun(timerDescription, sizeof(timerDescription), false, memoryMapped, bufferSize);
+
+		// framed file, decrypt front to back
+		if (framed) {
+			outFd = FileIO::openFile((const char*)newFilename, FILECODE::FILE_OUTPUT);
+			outputCreated = true;
+			SAESStream::decrypt(saes, nonce, inFd, outFd);
+			snprintf(timerDescription, sizeof(timerDescription), "framed stream");
+		}
+		// chunked file, chunks decrypt independently
+		else if (chunked) {
+			outFd = FileIO::openFile((const char*)newFilename, FILECODE::FILE_OUTPUT);
+			outputCreated = true;
+			decryptChunks(saes, nonce, index, inFd, outFd);
+			snprintf(timerDescription, sizeof(timerDescription), "%llu chunks, %u threads", (unsigned long long)index.getNumChunks(), pool ? pool->getNumThreads() : 1);
+		}
+		// memory mapped
+		else if (memoryMapped) {
+			FileIO::closeFile(inFd);
+			inFd = -1;
+			inMap.mapInput(filename);
+			outputCreated = true;
+			outMap.mapOutput((const char*)newFilename, outputFilesize);
+
+			// cipher body between mappings
+			cipherMemory(saes, nonce, inMap.getData(), outMap.getData(), outputFilesize + paddingLen, outputFilesize, auth.get());
+			if (auth)
+				auth->verifyTag(authBlocks);
+
+			inMap.unmap();
+			outMap.unmap();
+		}
+		else {
+			// reopen for body I/O in page cache mode
+			FileIO::closeFile(inFd);
+			inFd = -1;
+			inFd = FileIO::openFile(filename, FILECODE::FILE_INPUT, options.cacheMode);
+			outFd = FileIO::openFile((const char*)newFilename, FILECODE::FILE_OUTPUT, options.cacheMode);
+			outputCreated = true;
+
+			// cipher all chunks
+			if (pool)
+				parallelCipherFile(saes, nonce, inFd, outFd, outputFilesize + paddingLen, outputFilesize, auth.get());
+			else
+				pipelinedCipherFile(saes, nonce, inFd, outFd, outputFilesize + paddingLen, outputFilesize, bufferSize, auth.get());
+			if (auth)
+				auth->verifyTag(authBlocks);
+		}
+	}
+	catch (FileException&) {
+		if (inFd >= 0)
+			FileIO::closeFile(inFd);
+		if (outFd >= 0)
+			FileIO::closeFile(outFd);
+		inMap.unmap();
+		outMap.unmap();
+		if (outputCreated)
+			SAES::deleteFile((const char*)newFilename);
+		throw;
+	}
+
+	if (inFd >= 0)
+		FileIO::closeFile(inFd);
+	if (outFd >= 0)
+		FileIO::closeFile(outFd);
+
+	// remove input file
+	SAES::deleteFile(filename);
+
+	// end timer
+	timer.end();
+
+	// print timer
+	if (options.verbose)
+		timer.printTime(timerDescription);
+
+}
+
+/**
+Encrypt/decrypt a list of files. With a worker pool, files run concurrently through BatchScheduler; otherwise one at a
+time. Either way a failing file is skipped, reported if verbose, and the rest go on.
+
+@param status (IN) Encryption or decryption.
+@param numFiles (IN) Number of files.
+@param files (IN) File names.
+@param password (IN) Password.
+@param iKeylength (IN) Key size in integer form, encryption only.
+
+@return Number of files that failed.
+*/
+unsigned int SAESFileEngine::cipherFiles(const OPCODE status, const int numFiles, const byte(*files)[SAES_MAX_FILENAME_BUFFER_SIZE], byte* password, const int iKeylength) {
+
+	unsigned int numFailed = 0;
+
+	// many files concurrently, compressing and incremental encryption spread the chunks of one file instead, and GPU
+	// encryption streams one file at a time through the device
+	if (pool && (numFiles > 1) && !options.memoryMap && (options.cacheMode == CACHECODE::CACHE_DEFAULT) && !((status == OPCODE::ENCRYPTION) && (options.compress || options.incremental || encryptsOnGPU()))) {
+		BatchScheduler scheduler(*pool, status, password, iKeylength, options.formatVersion, getAuthFlag(), options.verbose);
+		scheduler.run(numFiles, files);
+		if (options.verbose)
+			scheduler.printSummary();
+		return scheduler.getNumFailed();
+	}
+
+	// one at a time
+	for (int fileIndex = 0; fileIndex < numFiles; fileIndex++) {
+		try {
+			if (status == OPCODE::ENCRYPTION)
+				encryptFile((const char*)files[fileIndex], password, iKeylength);
+			else
+				decryptFile((const char*)files[fileIndex], password);
+		}
+		catch (FileException& e) {
+			if (options.verbose)
+				BatchScheduler::printSkipped((const char*)files[fileIndex], e.getError());
+			numFailed++;
+		}
+		catch (GPUException& e) {
+			if (options.verbose)
+				BatchScheduler::printSkipped((const char*)files[fileIndex], e.getError());
+			numFailed++;
+		}
+	}
+
+	return numFailed;
+
+}
+
+/**
+Get size of an encrypted buffer.
+
+@param len (IN) Plaintext bytes.
+
+@return Bytes of SAES data, padded body and headers.
+*/
+_saes64 SAESFileEngine::getEncryptedSize(const _saes64 len) {
+
+	int paddingLen;
+	_saes64 bodySize;
+
+	SAES::setNewFilesize(len, paddingLen, bodySize);
+
+	return bodySize + (SAES_HEADERS * SAES_BLOCK_BYTES);
+
+}
+
+/**
+Get size of the plaintext held by a decryptable buffer.
+
+@param in (IN) SAES data, in a trailing-header format.
+@param len (IN) Bytes of SAES data.
+
+@return Plaintext bytes, larger than len for version 2 data with compressed chunks.
+
+@throw Throws FileException() if in is not SAES data.
+*/
+_saes64 SAESFileEngine::getDecryptedSize(const byte* in, const _saes64 len) {
+
+	byte filenameFormat[SAES_MAX_FILENAME_BYTES] = { 0x00 };
+	byte padding[SAES_MAX_PADDING_BYTES] = { 0x00 };
+	byte keylength[SAES_MAX_KEYLENGTH_BYTES] = { 0x00 };
+
+	SAES::extractFileSAESHeader(in, len, padding, filenameFormat, keylength);
+	if (SAESChunkIndex::isChunked(padding))
+		return SAESChunkIndex::getPlainSize(padding);
+	if ((padding[0] >= SAES_BLOCK_BYTES) || (len < (SAES_HEADERS * SAES_BLOCK_BYTES) + SAESAuth::getAuthBytes(padding) + padding[0]))
+		throw FileException("Error reading SAES header padding. Exiting program.\n");
+
+	return len - (SAES_HEADERS * SAES_BLOCK_BYTES) - SAESAuth::getAuthBytes(padding) - padding[0];
+
+}
+
+/**
+Encrypt buffer into the SAES file layout, body followed by headers. in and out may be the same buffer.
+
+@param in (IN) Plaintext.
+@param len (IN) Plaintext bytes.
+@param out (OUT) Buffer of getEncryptedSize(len) bytes.
+@param password (IN) Password.
+@param iKeylength (IN) Key size in integer form.
+@param filenameFormat (IN) File format stored in the header (ie., .txt), null for none.
+
+@return Bytes written to out.
+
+@throw Throws FileException() if key length is not supported.
+*/
+_saes64 SAESFileEngine::encryptBuffer(const byte* in, const _saes64 len, byte* out, byte* password, const int iKeylength, const byte* filenameFormat) {
+
+	int paddingLen;
+	_saes64 bodySize;
+	byte format[SAES_MAX_FILENAME_BYTES] = { 0x00 };
+	byte padding[SAES_MAX_PADDING_BYTES] = { 0x00 };
+	byte nonce[SAES_NONCE_SIZE_BYTES] = { 0x00 };
+	byte keylength[SAES_MAX_KEYLENGTH_BYTES] = { 0x00 };
+	SAES& saes = getCipher(password, iKeylength);
+
+	if (filenameFormat)
+		memcpy(format, filenameFormat, strnlen((const char*)filenameFormat, SAES_MAX_FILENAME_BYTES - 1));
+
+	// cipher body, then headers
+	SAES::setNewFilesize(len, paddingLen, bodySize);
+	SAES::calculateNonce(nonce, password);
+	cipherMemory(saes, nonce, in, out, len, bodySize, nullptr);
+	SAES::writeHeaders(out + bodySize, padding, paddingLen, format, keylength, iKeylength);
+
+	return bodySize + (SAES_HEADERS * SAES_BLOCK_BYTES);
+
+}
+
+/**
+Decrypt buffer in the SAES file layout. in and out may be the same buffer if chunks are stored in order, as this
+library writes them; chunks are decoded last to first so a compressed chunk never overwrites one still to be read.
+
+@param in (IN) SAES data, in a trailing-header format.
+@param len (IN) Bytes of SAES data.
+@param out (OUT) Buffer of getDecryptedSize(in, len) bytes, zeroed if the tag or checksums do not match.
+@param password (IN) Password.
+
+@return Plaintext bytes written to out.
+
+@throw Throws FileException() if in is not SAES data, its tag or checksums do not match or a chunk does not decode.
+*/
+_saes64 SAESFileEngine::decryptBuffer(const byte* in, const _saes64 len, byte* out, byte* password) {
+
+	byte filenameFormat[SAES_MAX_FILENAME_BYTES] = { 0x00 };
+	byte padding[SAES_MAX_PADDING_BYTES] = { 0x00 };
+	byte nonce[SAES_NONCE_SIZE_BYTES] = { 0x00 };
+	byte keylength[SAES_MAX_KEYLENGTH_BYTES] = { 0x00 };
+	_saes64 plainSize;
+	_saes64 authBytes;
+	std::unique_ptr<SAESAuth> auth = nullptr;
+
+	// extract SAES header data
+	if ((len >= SAES_STREAM_MAGIC_BYTES) && (memcmp(in, SAES_STREAM_MAGIC, SAES_STREAM_MAGIC_BYTES) == 0))
+		throw FileException("Buffer decryption needs SAES file data, not a stream. Exiting program.\n");
+	SAES::extractFileSAESHeader(in, len, padding, filenameFormat, keylength);
+	SAES& saes = getCipher(password, (keylength[1] << 8) | (keylength[0] << 0));
+	SAES::calculateNonce(nonce, password);
+
+	// version 2, chunk by chunk
+	if (SAESChunkIndex::isChunked(padding)) {
+		SAESChunkIndex index;
+		index.read(in, len, padding);
+		for (_saes64 i = index.getNumChunks(); i > 0; i--)
+			index.decryptChunk(saes, nonce, i - 1, in + index.getChunk(i - 1).offset, out + index.getPlainOffset(i - 1));
+		return index.getPlainSize();
+	}
+
+	authBytes = SAESAuth::getAuthBytes(padding);
+	if ((padding[0] >= SAES_BLOCK_BYTES) || (len < (SAES_HEADERS * SAES_BLOCK_BYTES) + authBytes + padding[0]))
+		throw FileException("Error reading SAES header padding. Exiting program.\n");
+	plainSize = len - (SAES_HEADERS * SAES_BLOCK_BYTES) - authBytes - padding[0];
+
+	// salt and tag or checksum blocks precede the headers
+	if (authBytes)
+		auth = std::unique_ptr<SAESAuth>(new SAESAuth(saes, OPCODE::DECRYPTION, in + plainSize + padding[0], in + len - (SAES_HEADERS * SAES_BLOCK_BYTES)));
+
+	// cipher body
+	cipherMemory(saes, nonce, in, out, plainSize + padding[0], plainSize, auth.get());
+	if (auth) {
+		try {
+			auth->verifyTag(in + plainSize + padding[0]);
+		}
+		catch (FileException&) {
+			memset(out, 0, (size_t)plainSize);
+			throw;
+		}
+	}
+
+	return plainSize;
+
+}
+
+/**
+Encrypt input descriptor to output descriptor in the framed stream format, one forward pass.
+
+@param inFd (IN) Input file descriptor, read to end.
+@param outFd (IN) Output file descriptor.
+@param password (IN) Password.
+@param iKeylength (IN) Key size in integer form.
+
+@throw Throws FileException() if read or write fails.
+*/
+void SAESFileEngine::encryptStream(const int inFd, const int outFd, byte* password, const int iKeylength) {
+
+	byte nonce[SAES_NONCE_SIZE_BYTES] = { 0x00 };
+	byte filenameFormat[SAES_MAX_FILENAME_BYTES] = { 0x00 };
+	SAES& saes = getCipher(password, iKeylength);
+
+	// piped input has no file format
+	SAES::calculateNonce(nonce, password);
+	SAESStream::writeHeader(outFd, iKeylength, filenameFormat);
+	SAESStream::encrypt(saes, nonce, inFd, outFd, options.bufferSize ? options.bufferSize : SAES_STREAM_FRAME_SIZE);
+
+}
+
+/**
+Decrypt input descriptor to output descriptor. The framed format decrypts as it arrives; a trailing-header file is
+spooled to a temporary file to reach its headers.
+
+@param inFd (IN) Input file descriptor, read to end.
+@param outFd (IN) Output file descriptor.
+@param password (IN) Password.
+
+@throw Throws FileException() if read or write fails, or the input is not SAES data.
+*/
+void SAESFileEngine::decryptStream(const int inFd, const int outFd, byte* password) {
+
+	_saes64 frameSize = options.bufferSize ? options.bufferSize : SAES_STREAM_FRAME_SIZE;
+	byte nonce[SAES_NONCE_SIZE_BYTES] = { 0x00 };
+	byte streamHeader[SAES_STREAM_HEADER_BYTES] = { 0x00 };
+	byte filenameFormat[SAES_MAX_FILENAME_BYTES] = { 0x00 };
+	byte padding[SAES_MAX_PADDING_BYTES] = { 0x00 };
+	byte keylength[SAES_MAX_KEYLENGTH_BYTES] = { 0x00 };
+	int streamKeylength = -1;
+	SAESChunkIndex index;
+	bool chunked;
+
+	SAES::calculateNonce(nonce, password);
+
+	// framed format decrypts as it arrives
+	if (FileIO::readStream(inFd, streamHeader, SAES_STREAM_HEADER_BYTES) != SAES_STREAM_HEADER_BYTES)
+		throw FileException("SAES stream is truncated. Exiting program.\n");
+	if (SAESStream::readHeader(streamHeader, streamKeylength, filenameFormat)) {
+		SAESStream::decrypt(getCipher(password, streamKeylength), nonce, inFd, outFd);
+		return;
+	}
+
+	// trailing-header format, spool input to reach the headers
+	FILE* spool = tmpfile();
+	if (spool == nullptr)
+		throw FileException("Failed to create temporary file. Exiting program.\n");
+	int spoolFd = fileno(spool);
+	std::unique_ptr<byte[]> buffer = std::unique_ptr<byte[]>(new byte[frameSize]);
+	_saes64 spoolSize = SAES_STREAM_HEADER_BYTES;
+	_saes64 len;
+
+	try {
+		FileIO::writeStream(spoolFd, streamHeader, SAES_STREAM_HEADER_BYTES);
+		while ((len = FileIO::readStream(inFd, buffer.get(), frameSize)) != 0) {
+			FileIO::writeStream(spoolFd, buffer.get(), len);
+			spoolSize += len;
+		}
+
+		// extract SAES file header data
+		if (spoolSize < SAES_HEADERS * SAES_BLOCK_BYTES)
+			throw FileException("SAES stream is truncated. Exiting program.\n");
+		_saes64 outputFilesize = SAES::extractFileSAESHeader(spoolFd, padding, filenameFormat, keylength);
+		chunked = SAESChunkIndex::isChunked(padding);
+		if (chunked)
+			index.read(spoolFd, spoolSize, padding);
+		SAES& saes = getCipher(password, (keylength[1] << 8) | (keylength[0] << 0));
+
+		// check tag or checksums over the spooled body before any plaintext is written
+		if (!chunked && SAESAuth::hasAuthBlocks(padding)) {
+			byte authBlocks[(SAES_AUTH_BLOCKS + SAES_HEADERS) * SAES_BLOCK_BYTES];
+			_saes64 authBytes = SAESAuth::getAuthBytes(padding);
+			_saes64 storedSize = outputFilesize + padding[0];
+			if (FileIO::readAt(spoolFd, authBlocks, authBytes + (SAES_HEADERS * SAES_BLOCK_BYTES), spoolSize - authBytes - (SAES_HEADERS * SAES_BLOCK_BYTES)) != authBytes + (SAES_HEADERS * SAES_BLOCK_BYTES))
+				throw FileException("SAES stream is truncated. Exiting program.\n");
+			SAESAuth auth(saes, OPCODE::DECRYPTION, authBlocks, authBlocks + authBytes);
+			for (_saes64 offset = 0; offset < storedSize; offset += frameSize) {
+				len = std::min(frameSize, storedSize - offset);
+				FileIO::readAt(spoolFd, buffer.get(), len, offset);
+				auth.applyKeystream(nonce, offset / SAES_BLOCK_BYTES, buffer.get(), buffer.get(), len);
+			}
+			auth.verifyTag(authBlocks);
+		}
+
+		// decrypt body, dropping padding; chunks go whole so a compressed one decodes once
+		if (chunked && (frameSize < index.getChunkSize())) {
+			frameSize = index.getChunkSize();
+			buffer = std::unique_ptr<byte[]>(new byte[(size_t)frameSize]);
+		}
+		for (_saes64 offset = 0; offset < outputFilesize; offset += frameSize) {
+			len = std::min(frameSize, outputFilesize - offset);
+			if (chunked)
+				index.decryptRange(spoolFd, saes, nonce, offset, buffer.get(), len);
+			else {
+				FileIO::readAt(spoolFd, buffer.get(), len, offset);
+				saes.applyKeystream(nonce, offset / SAES_BLOCK_BYTES, buffer.get(), len);
+			}
+			FileIO::writeStream(outFd, buffer.get(), len);
+		}
+	}
+	catch (FileException&) {
+		fclose(spool);
+		throw;
+	}
+
+	fclose(spool);
+
+}
+
+/**
+Check encryption backend.
+
+@return True if file encryption runs on the GPU.
+*/
+bool SAESFileEngine::usingGPU() const {
+	return gpuEnabled;
+}
+
+/**
+Check if new files are encrypted on the GPU: version 1 without tag or checksum, when a device was found.
+
+@return True if encryptFile() uses the GPU, unless building the program fails.
+*/
+bool SAESFileEngine::encryptsOnGPU() const {
+	return gpuEnabled && (options.formatVersion != SAES_FORMAT_VERSION_2) && (getAuthFlag() == 0);
+}
+
+/**
+Build the GPU program on first use. If it fails, encryption falls back to the CPU for the rest of the engine's life.
+
+@return True if the program is ready.
+*/
+bool SAESFileEngine::prepareGPU() {
+
+	if (gpu->isProgramBuilt())
+		return true;
+
+	try {
+		gpu->buildProgram();
+		gpu->createKernelFromProgram(GPU_KERNEL_FUNC_NAME);
+	}
+	catch (GPUException& e) {
+		if (options.verbose) {
+			printf(e.getError());
+			printf("Defaulting to CPU execution.\n");
+		}
+		gpuEnabled = false;
+	}
+
+	return gpuEnabled;
+
+}
+
+/**
+Get cipher context, reusing the key schedule while password and key length stay the same.
+
+@param password (IN) Password, SAES_MAX_KEY_BYTES bytes zero-padded past its end.
+@param iKeylength (IN) Key size in integer form.
+
+@return Cipher context.
+
+@throw Throws FileException() if key length is not 128, 192 or 256.
+*/
+SAES& SAESFileEngine::getCipher(byte* password, const int iKeylength) {
+
+	if ((iKeylength != SAES_KEY_SIZE_128) && (iKeylength != SAES_KEY_SIZE_192) && (iKeylength != SAES_KEY_SIZE_256))
+		throw FileException("Unsupported SAES key length. Exiting program.\n");
+
+	// rebuild key schedule on change
+	if (!cipher || (iKeylength != cipherKeylength) || (memcmp(password, cipherPassword, SAES_MAX_KEY_BYTES) != 0)) {
+		cipher = std::unique_ptr<SAES>(new SAES(iKeylength, password));
+		memcpy(cipherPassword, password, SAES_MAX_KEY_BYTES);
+		cipherKeylength = iKeylength;
+	}
+
+	return *cipher;
+
+}
+
+/**
+Get padding block flag of new version 1 files.
+
+@return SAES_HEADER_FLAG_AUTH, SAES_HEADER_FLAG_CHECKSUM or 0.
+*/
+byte SAESFileEngine::getAuthFlag() const {
+
+	if (options.authenticate)
+		return SAES_HEADER_FLAG_AUTH;
+	return options.checksum ? SAES_HEADER_FLAG_CHECKSUM : 0;
+
+}
+
+/**
+Encrypt a file body on the GPU, streamed through the device GPU_STREAM_CHUNK_BYTES at a time. The device generates the
+CTR keystream from the nonce and each block's counter and XORs it into the chunk, so only plaintext is uploaded and only
+ciphertext read back. Chunks rotate over GPU_NUM_STREAMS streams: while chunk k computes, chunk k + 1 uploads and chunk
+k - 1 downloads, and host memory stays at a few chunks whatever the file size. Streams, tables and bound parameters
+are kept for the next file.
+
+@param saes (IN) Cipher context.
+@param nonce (IN) Nonce derived from password.
+@param inFile (IN/OUT) Input stream.
+@param outFile (IN/OUT) Output stream.
+@param inputFilesize (IN) Bytes of input.
+@param outputFilesize (IN) Bytes of padded body.
+
+@throw Throws GPUException() if a device operation failed.
+*/
+void SAESFileEngine::gpuCipherFile(SAES& saes, const byte* nonce, std::fstream& inFile, std::fstream& outFile, const _saes64 inputFilesize, const _saes64 outputFilesize) {
+
+	_saes64 chunkBytes = std::min((_saes64)GPU_STREAM_CHUNK_BYTES, outputFilesize);
+	_saes64 offset, chunk;
+	int numStreams;
+
+	// pipeline and parameters persist across files, only a changed key or nonce is uploaded again
+	gpu->createStreams((size_t)chunkBytes, 0);
+	numStreams = gpu->getNumStreams();
+	std::vector<_saes64> pendingLen((size_t)numStreams, 0);
+	gpu->setBufferParam(1, sbox, sizeof(byte) * SAES_LOOKUP_TABLE_SIZE);
+	gpu->setBufferParam(2, saes.getRoundKeys(), sizeof(byte) * SAES_MAX_ROUND_KEY_BYTES);
+	gpu->setScalarParam(3, sizeof(int), saes.getNumRounds());
+	gpu->setBufferParam(4, nonce, sizeof(byte) * SAES_NONCE_SIZE_BYTES);
+
+	// work-group size and blocks per work-item, tuned on the first file or taken from the device's cached result
+	if (!gpu->isLaunchTuned()) {
+		cl_ulong tuneCounter = 0;
+		cl_ulong tuneLen = GPU_TUNE_BYTES;
+		gpu->setStreamParam(0, 5, sizeof(cl_ulong), &tuneCounter);
+		gpu->setStreamParam(0, 6, sizeof(cl_ulong), &tuneLen);
+		gpu->tuneLaunch(GPU_TUNE_BYTES, GPU_TUNE_BYTES / SAES_BLOCK_BYTES);
+	}
+
+	for (offset = 0, chunk = 0; offset < outputFilesize; offset += chunkBytes, chunk++) {
+
+		int stream = (int)(chunk % numStreams);
+		byte* data = gpu->getStreamData(stream);
+		cl_ulong startCounter = offset / SAES_BLOCK_BYTES;
+		cl_ulong len = std::min(chunkBytes, outputFilesize - offset);
+		_saes64 readLen = (offset < inputFilesize) ? std::min((_saes64)len, inputFilesize - offset) : 0;
+
+		// the stream's previous chunk is the oldest in flight, write it out before reusing its buffer
+		if (pendingLen[stream]) {
+			gpu->finishStream(stream);
+			outFile.write((const char*)data, pendingLen[stream]);
+		}
+
+		// read next chunk, zero padding past end of input
+		inFile.read((char*)data, readLen);
+		memset(data + readLen, 0, (size_t)(len - readLen));
+
+		// cipher on device, one unit of work per block
+		gpu->setStreamParam(stream, 5, sizeof(cl_ulong), &startCounter);
+		gpu->setStreamParam(stream, 6, sizeof(cl_ulong), &len);
+		gpu->enqueueStream(stream, (size_t)len, (size_t)((len + SAES_BLOCK_BYTES - 1) / SAES_BLOCK_BYTES));
+		pendingLen[stream] = len;
+
+	}
+
+	// drain remaining chunks in order
+	for (int i = 0; i < numStreams; i++) {
+		int stream = (int)((chunk + i) % numStreams);
+		if (pendingLen[stream]) {
+			gpu->finishStream(stream);
+			outFile.write((const char*)gpu->getStreamData(stream), pendingLen[stream]);
+		}
+	}
+
+}
+
+/**
+Encrypt/decrypt a file body on the worker pool. The body is split into SAES_PARALLEL_CHUNK_SIZE chunks; CTR mode is
+seekable, so each worker generates keystream for its own counter range and writes its chunk at its own offset. With a
+tag or checksums each chunk is hashed into its own state, joined in order once all are done.
+
+@param saes (IN) Cipher context, shared read-only by all workers.
+@param nonce (IN) Nonce derived from password.
+@param inFd (IN) Input file descriptor.
+@param outFd (IN) Output file descriptor.
+@param readSize (IN) Bytes of input body. Blocks reaching past it are zero padded.
+@param writeSize (IN) Bytes of output body.
+@param auth (IN/OUT) Tag or checksums of the body, null for none.
+@param index (IN/OUT) Chunk index of a contiguous version 2 body, receiving chunk checksums, null for none.
+
+@throw Throws FileException() if a worker failed to read or write.
+*/
+void SAESFileEngine::parallelCipherFile(const SAES& saes, const byte* nonce, const int inFd, const int outFd, const _saes64 readSize, const _saes64 writeSize, SAESAuth* auth, SAESChunkIndex* index) {
+
+	CACHECODE cacheCode = options.cacheMode;
+	// checked decryption also deciphers the padding, whose ciphertext is hashed
+	_saes64 cipherSize = auth ? std::max(readSize, writeSize) : writeSize;
+	_saes64 numChunks = (cipherSize + SAES_PARALLEL_CHUNK_SIZE - 1) / SAES_PARALLEL_CHUNK_SIZE;
+	std::unique_ptr<byte[]> chunkStates = nullptr;
+
+	if (auth)
+		chunkStates = std::unique_ptr<byte[]>(new byte[numChunks * SAES_BLOCK_BYTES]());
+
+	// queue all chunks
+	for (_saes64 offset = 0; offset < cipherSize; offset += SAES_PARALLEL_CHUNK_SIZE) {
+
+		byte* chunkState = auth ? chunkStates.get() + ((offset / SAES_PARALLEL_CHUNK_SIZE) * SAES_BLOCK_BYTES) : nullptr;
+
+		pool->submit([&saes, nonce, inFd, outFd, readSize, writeSize, cipherSize, offset, cacheCode, auth, index, chunkState]() {
+
+			_saes64 chunkLen = std::min((_saes64)SAES_PARALLEL_CHUNK_SIZE, cipherSize - offset);
+			_saes64 readLen = std::min(chunkLen, readSize - offset);
+			_saes64 writeLen = std::min(chunkLen, writeSize - offset);
+
+			// chunk buffer allocated once per worker thread, aligned for direct I/O
+			static thread_local std::unique_ptr<byte[]> chunkBuffer = std::unique_ptr<byte[]>(new byte[SAES_PARALLEL_CHUNK_SIZE + SAES_DIRECT_IO_ALIGNMENT]);
+			byte* dataBlocks = alignDirect(chunkBuffer.get());
+
+			// direct I/O moves whole aligned blocks, excess past the body is truncated afterwards
+			if (cacheCode == CACHECODE::CACHE_DIRECT) {
+				readLen = alignDirect(readLen);
+				writeLen = alignDirect(writeLen);
+			}
+
+			// read chunk, zero padding past end of input
+			readLen = std::min(FileIO::readAt(inFd, dataBlocks, readLen, offset), chunkLen);
+			memset(dataBlocks + readLen, 0, (size_t)(std::max(chunkLen, writeLen) - readLen));
+
+			// XOR keystream for chunk counter range in place
+			if (auth)
+				auth->applyKeystream(nonce, offset / SAES_BLOCK_BYTES, dataBlocks, dataBlocks, chunkLen, chunkState);
+			else
+				saes.applyKeystream(nonce, offset / SAES_BLOCK_BYTES, dataBlocks, chunkLen);
+			if (index)
+				index->updateChecksums(offset, dataBlocks, std::min(chunkLen, writeSize - offset));
+
+			// write chunk at its offset
+			FileIO::writeAt(outFd, dataBlocks, writeLen, offset);
+
+			// drop completed chunk from page cache
+			if (cacheCode == CACHECODE::CACHE_DROP_BEHIND) {
+				FileIO::dropCache(inFd, offset, chunkLen, false);
+				FileIO::dropCache(outFd, offset, chunkLen, true);
+			}
+
+		});
+
+	}
+
+	// wait for all chunks
+	pool->wait();
+
+	// join chunk hashes in body order
+	if (auth) {
+		for (_saes64 chunk = 0; chunk < numChunks; chunk++)
+			auth->append(chunkStates.get() + (chunk * SAES_BLOCK_BYTES), std::min((_saes64)SAES_PARALLEL_CHUNK_SIZE, cipherSize - (chunk * SAES_PARALLEL_CHUNK_SIZE)));
+	}
+
+	// trim direct I/O excess, headers are written cached
+	if (cacheCode == CACHECODE::CACHE_DIRECT) {
+		FileIO::setFileSize(outFd, writeSize);
+		FileIO::clearDirect(outFd);
+	}
+
+}
+
+/**
+Encrypt/decrypt a file body through an asynchronous I/O pipeline of SAES_IO_QUEUE_DEPTH buffers. While buffer k is
+ciphered, reads of buffers k+1 and k+2 and the write of buffer k-1 are in flight.
+
+@param saes (IN) Cipher context.
+@param nonce (IN) Nonce derived from password.
+@param inFd (IN) Input file descriptor.
+@param outFd (IN) Output file descriptor.
+@param readSize (IN) Bytes of input body. Blocks reaching past it are zero padded.
+@param writeSize (IN) Bytes of output body.
+@param bufferSize (IN) Bytes per buffer, a multiple of SAES_BLOCK_BYTES.
+@param auth (IN/OUT) Tag or checksums of the body, null for none. Each buffer is hashed in the same pass.
+@param index (IN/OUT) Chunk index of a contiguous version 2 body, receiving chunk checksums, null for none.
+
+@throw Throws FileException() if a read or write failed.
+*/
+void SAESFileEngine::pipelinedCipherFile(const SAES& saes, const byte* nonce, const int inFd, const int outFd, const _saes64 readSize, const _saes64 writeSize, const _saes64 bufferSize, SAESAuth* auth, SAESChunkIndex* index) {
+
+	bool direct = (options.cacheMode == CACHECODE::CACHE_DIRECT);
+	bool dropBehind = (options.cacheMode == CACHECODE::CACHE_DROP_BEHIND);
+	// checked decryption also deciphers the padding, whose ciphertext is hashed
+	_saes64 cipherSize = auth ? std::max(readSize, writeSize) : writeSize;
+	_saes64 slotSize = alignDirect(std::min(bufferSize, cipherSize));
+	_saes64 numBuffers = (cipherSize + bufferSize - 1) / bufferSize;
+	std::unique_ptr<byte[]> allocation = std::unique_ptr<byte[]>(new byte[(SAES_IO_QUEUE_DEPTH * slotSize) + SAES_DIRECT_IO_ALIGNMENT]);
+	byte* buffers = alignDirect(allocation.get());
+	AsyncIO& io = *aio;
+
+	// queue read of a buffer into its slot
+	auto readAhead = [&](const _saes64 bufferIndex) {
+		unsigned int slot = bufferIndex % SAES_IO_QUEUE_DEPTH;
+		_saes64 offset = bufferIndex * bufferSize;
+		_saes64 readLen = std::min(std::min(bufferSize, cipherSize - offset), readSize - offset);
+		io.submitRead(slot, inFd, buffers + (slot * slotSize), direct ? alignDirect(readLen) : readLen, offset);
+	};
+
+	// buffers are freed on return, so a failure first waits out requests still in flight
+	try {
+
+		// prime read-ahead
+		for (_saes64 i = 0; (i < SAES_IO_QUEUE_DEPTH - 1) && (i < numBuffers); i++)
+			readAhead(i);
+
+		// loop all buffers in file
+		for (_saes64 i = 0; i < numBuffers; i++) {
+
+			unsigned int slot = i % SAES_IO_QUEUE_DEPTH;
+			byte* buffer = buffers + (slot * slotSize);
+			_saes64 offset = i * bufferSize;
+			_saes64 bufferLen = std::min(bufferSize, cipherSize - offset);
+			_saes64 writeLen = std::min(bufferLen, writeSize - offset);
+			if (direct)
+				writeLen = alignDirect(writeLen);
+
+			// wait for read, zero padding past end of input
+			_saes64 readLen = std::min(io.wait(slot), bufferLen);
+			memset(buffer + readLen, 0, (size_t)(std::max(bufferLen, writeLen) - readLen));
+
+			// cipher buffer in place
+			if (auth)
+				auth->applyKeystream(nonce, offset / SAES_BLOCK_BYTES, buffer, buffer, bufferLen);
+			else
+				saes.applyKeystream(nonce, offset / SAES_BLOCK_BYTES, buffer, bufferLen);
+			if (index)
+				index->updateChecksums(offset, buffer, std::min(bufferLen, writeSize - offset));
+			if (dropBehind)
+				FileIO::dropCache(inFd, offset, bufferLen, false);
+
+			// write behind, direct I/O excess past the body is truncated afterwards
+			io.submitWrite(slot, outFd, buffer, writeLen, offset);
+
+			// previous buffer written, start its writeback and drop the one before
+			if (i > 0) {
+				io.wait((i - 1) % SAES_IO_QUEUE_DEPTH);
+				if (dropBehind) {
+					FileIO::startWriteback(outFd, (i - 1) * bufferSize, bufferSize);
+					if (i > 1)
+						FileIO::dropCache(outFd, (i - 2) * bufferSize, bufferSize, true);
+				}
+			}
+
+			// read ahead into slot of previous buffer
+			if (i + SAES_IO_QUEUE_DEPTH - 1 < numBuffers)
+				readAhead(i + SAES_IO_QUEUE_DEPTH - 1);
+
+		}
+
+		// wait for remaining writes
+		for (unsigned int slot = 0; slot < SAES_IO_QUEUE_DEPTH; slot++)
+			io.wait(slot);
+
+	}
+	catch (...) {
+		io.drain();
+		throw;
+	}
+
+	if (dropBehind)
+		FileIO::dropCache(outFd, 0, 0, true);
+
+	// trim direct I/O excess, headers are written cached
+	if (direct) {
+		FileIO::setFileSize(outFd, writeSize);
+		FileIO::clearDirect(outFd);
+	}
+
+}
+
+/**
+Encrypt/decrypt a body held in memory, such as a file mapping. Keystream is XORed from input straight into output; only
+a final partial block needing zero padding is staged on the stack.
+
+@param saes (IN) Cipher context, shared read-only by all workers.
+@param nonce (IN) Nonce derived from password.
+@param in (IN) Input body.
+@param out (OUT) Output body, may be in.
+@param readSize (IN) Bytes of input body. Blocks reaching past it are zero padded.
+@param writeSize (IN) Bytes of output body.
+@param auth (IN/OUT) Tag or checksums of the body, null for none.
+@param index (IN/OUT) Chunk index of a contiguous version 2 body, receiving chunk checksums, null for none.
+*/
+void SAESFileEngine::cipherMemory(const SAES& saes, const byte* nonce, const byte* in, byte* out, const _saes64 readSize, const _saes64 writeSize, SAESAuth* auth, SAESChunkIndex* index) {
+
+	_saes64 directLen = (std::min(readSize, writeSize) / SAES_BLOCK_BYTES) * SAES_BLOCK_BYTES;
+	_saes64 numChunks = (directLen + SAES_PARALLEL_CHUNK_SIZE - 1) / SAES_PARALLEL_CHUNK_SIZE;
+	std::unique_ptr<byte[]> chunkStates = nullptr;
+
+	// full blocks between buffers
+	if (pool) {
+		if (auth)
+			chunkStates = std::unique_ptr<byte[]>(new byte[numChunks * SAES_BLOCK_BYTES]());
+		for (_saes64 offset = 0; offset < directLen; offset += SAES_PARALLEL_CHUNK_SIZE) {
+			byte* chunkState = auth ? chunkStates.get() + ((offset / SAES_PARALLEL_CHUNK_SIZE) * SAES_BLOCK_BYTES) : nullptr;
+			pool->submit([&saes, nonce, in, out, directLen, offset, auth, index, chunkState]() {
+				_saes64 chunkLen = std::min((_saes64)SAES_PARALLEL_CHUNK_SIZE, directLen - offset);
+				if (auth)
+					auth->applyKeystream(nonce, offset / SAES_BLOCK_BYTES, in + offset, out + offset, chunkLen, chunkState);
+				else
+					saes.applyKeystream(nonce, offset / SAES_BLOCK_BYTES, in + offset, out + offset, chunkLen);
+				if (index)
+					index->updateChecksums(offset, out + offset, chunkLen);
+			});
+		}
+		pool->wait();
+
+		// join chunk hashes in body order
+		for (_saes64 chunk = 0; auth && (chunk < numChunks); chunk++)
+			auth->append(chunkStates.get() + (chunk * SAES_BLOCK_BYTES), std::min((_saes64)SAES_PARALLEL_CHUNK_SIZE, directLen - (chunk * SAES_PARALLEL_CHUNK_SIZE)));
+	}
+	else {
+		if (auth)
+			auth->applyKeystream(nonce, 0, in, out, directLen);
+		else
+			saes.applyKeystream(nonce, 0, in, out, directLen);
+		if (index)
+			index->updateChecksums(0, out, directLen);
+	}
+
+	// final partial block, zero padded; checked decryption hashes the whole stored block
+	if (directLen < writeSize) {
+		byte lastBlock[SAES_BLOCK_BYTES] = { 0x00 };
+		memcpy(lastBlock, in + directLen, (size_t)(std::min(auth ? readSize : std::min(readSize, writeSize), directLen + SAES_BLOCK_BYTES) - directLen));
+		if (auth)
+			auth->applyKeystream(nonce, directLen / SAES_BLOCK_BYTES, lastBlock, lastBlock, SAES_BLOCK_BYTES);
+		else
+			saes.applyKeystream(nonce, directLen / SAES_BLOCK_BYTES, lastBlock, writeSize - directLen);
+		memcpy(out + directLen, lastBlock, (size_t)(writeSize - directLen));
+		if (index)
+			index->updateChecksums(directLen, lastBlock, writeSize - directLen);
+	}
+
+}
+
+/**
+Encrypt a version 2 file body chunk by chunk, with compression LZ4 compressing each chunk that passes the entropy check
+and shrinks, then ciphering it from the chunk's own counter. Hole chunks are neither read nor stored. Workers encode a
+wave of chunks while the wave before is written back to back behind the chunks already stored, and the index records
+where each chunk went and its checksum.
+
+@param saes (IN) Cipher context, shared read-only by all workers.
+@param nonce (IN) Nonce derived from password.
+@param index (IN/OUT) Chunk index of the plaintext, chunk offsets, stored lengths, checksums and encodings are filled in.
+@param inFd (IN) Input file descriptor.
+@param outFd (IN) Output file descriptor.
+
+@throw Throws FileException() if a chunk failed to read or write.
+*/
+void SAESFileEngine::packChunks(const SAES& saes, const byte* nonce, SAESChunkIndex& index, const int inFd, const int outFd) {
+
+	_saes64 numChunks = index.getNumChunks();
+	_saes64 chunkSize = index.getChunkSize();
+	_saes64 waveSize = pool ? pool->getNumThreads() : 1;
+	_saes64 offset = 0;
+
+	// two waves of stored chunks, one encoding while the other is written
+	std::unique_ptr<byte[]> stored = std::unique_ptr<byte[]>(new byte[(size_t)(2 * waveSize * chunkSize)]);
+	std::vector<unsigned int> storedLens((size_t)(2 * waveSize));
+	std::vector<unsigned int> checksums((size_t)(2 * waveSize));
+	std::vector<unsigned int> flags((size_t)(2 * waveSize));
+
+	auto encodeChunk = [this, &saes, nonce, &index, inFd, chunkSize, waveSize, &stored, &storedLens, &checksums, &flags](const _saes64 chunk) {
+
+		// plaintext buffer allocated once per thread
+		static thread_local std::unique_ptr<byte[]> plainBuffer = nullptr;
+		static thread_local _saes64 plainBufferSize = 0;
+		_saes64 slot = chunk % (2 * waveSize);
+		byte* out = stored.get() + (slot * chunkSize);
+		unsigned int plainLen = index.getChunk(chunk).plainLen;
+		_saes64 storedLen = 0;
+
+		if (index.getChunk(chunk).flags == SAES_CHUNK_FLAG_HOLE) {
+			storedLens[slot] = 0;
+			checksums[slot] = 0;
+			flags[slot] = SAES_CHUNK_FLAG_HOLE;
+			return;
+		}
+		if (plainLen > plainBufferSize) {
+			plainBuffer = std::unique_ptr<byte[]>(new byte[plainLen]);
+			plainBufferSize = plainLen;
+		}
+		if (FileIO::readAt(inFd, plainBuffer.get(), plainLen, index.getPlainOffset(chunk)) != plainLen)
+			throw FileException("Failed to read file. Exiting program.\n");
+
+		// keep the LZ4 block only if it is smaller than the chunk
+		if (options.compress && LZ4Codec::isCompressible(plainBuffer.get(), plainLen))
+			storedLen = LZ4Codec::compress(plainBuffer.get(), plainLen, out, plainLen - 1);
+		if (storedLen) {
+			saes.applyKeystream(nonce, index.getCounter(chunk), out, storedLen);
+			flags[slot] = SAES_CHUNK_FLAG_LZ4;
+		}
+		else {
+			storedLen = plainLen;
+			saes.applyKeystream(nonce, index.getCounter(chunk), plainBuffer.get(), out, storedLen);
+			flags[slot] = 0;
+		}
+		storedLens[slot] = (unsigned int)storedLen;
+		checksums[slot] = CRC32C::update(0, out, storedLen);
+
+	};
+
+	// wave n encodes while wave n - 1 is written, one extra wave writes the last
+	for (_saes64 first = 0; first < numChunks + waveSize; first += waveSize) {
+
+		for (_saes64 chunk = first; chunk < std::min(first + waveSize, numChunks); chunk++) {
+			if (pool)
+				pool->submit([&encodeChunk, chunk]() { encodeChunk(chunk); });
+			else
+				encodeChunk(chunk);
+		}
+
+		// previous wave goes back to back in chunk order
+		for (_saes64 chunk = (first ? first - waveSize : numChunks); chunk < std::min(first, numChunks); chunk++) {
+			_saes64 slot = chunk % (2 * waveSize);
+			const byte* data = stored.get() + (slot * chunkSize);
+			_saes64 chunkOffset = offset;
+			unsigned int storedLen = storedLens[slot];
+			index.setChunk(chunk, chunkOffset, storedLen, checksums[slot], flags[slot]);
+			offset += storedLen;
+			if (storedLen == 0)
+				continue;
+			if (pool)
+				pool->submit([outFd, data, storedLen, chunkOffset]() { FileIO::writeAt(outFd, data, storedLen, chunkOffset); });
+			else
+				FileIO::writeAt(outFd, data, storedLen, chunkOffset);
+		}
+
+		if (pool)
+			pool->wait();
+
+	}
+
+}
+
+/**
+Encrypt a version 2 file in place of its previous encryption, rewriting only chunks whose fingerprint changed since the
+manifest was written. Every chunk deciphers from its own counter range, so a rewritten chunk is ciphered exactly as a
+full run would cipher it. Without an existing file and a manifest matching it, password and chunk size, all chunks are
+written. The manifest is removed before the file is touched and written again once the trailer is in place, so an
+interrupted run leaves no manifest and the next run is a full one.
+
+@param saes (IN) Cipher context, shared read-only by all workers.
+@param nonce (IN) Nonce derived from password.
+@param index (IN/OUT) Chunk index of the plaintext, checksums of kept and rewritten chunks are filled in.
+@param filename (IN) Name of input file, kept.
+@param newFilename (IN) Name of SAES file, updated or created.
+@param trailer (IN/OUT) Chunk index and SAES headers to follow the body, the index is written once the body is.
+@param trailerSize (IN) Bytes of trailer.
+
+@return Number of chunks written.
+
+@throw Throws FileException() if a file could not be read or written.
+*/
+_saes64 SAESFileEngine::updateChunks(const SAES& saes, const byte* nonce, SAESChunkIndex& index, const char* filename, const char* newFilename, byte* trailer, const _saes64 trailerSize) {
+
+	byte manifestFilename[SAES_MAX_FILENAME_BUFFER_SIZE] = { 0x00 };
+	SAESManifest manifest(saes, index.getPlainSize(), index.getChunkSize());
+	SAESChunkIndex existing;
+	std::atomic<_saes64> numWritten(0);
+	bool previous = false;
+	int inFd = -1, outFd = -1;
+
+	SAESManifest::setFilename((const byte*)newFilename, manifestFilename);
+
+	// existing file, its trailer ties it to the manifest
+	try {
+		byte padding[SAES_MAX_PADDING_BYTES] = { 0x00 };
+		byte filenameFormat[SAES_MAX_FILENAME_BYTES] = { 0x00 };
+		byte keylength[SAES_MAX_KEYLENGTH_BYTES] = { 0x00 };
+		outFd = FileIO::openFile(newFilename, FILECODE::FILE_UPDATE);
+		SAES::extractFileSAESHeader(outFd, padding, filenameFormat, keylength);
+		if (SAESChunkIndex::isChunked(padding)) {
+			existing.read(outFd, FileIO::getFileSize(outFd), padding);
+			_saes64 existingLen = existing.getIndexBytes() + (SAES_HEADERS * SAES_BLOCK_BYTES);
+			std::unique_ptr<byte[]> existingTrailer = std::unique_ptr<byte[]>(new byte[(size_t)existingLen]);
+			if (FileIO::readAt(outFd, existingTrailer.get(), existingLen, existing.getStoredSize()) == existingLen)
+				previous = manifest.read((const char*)manifestFilename, existingTrailer.get(), existingLen);
+		}
+	}
+	catch (FileException&) {
+		previous = false;
+	}
+	if (!previous && (outFd >= 0)) {
+		FileIO::closeFile(outFd);
+		outFd = -1;
+	}
+	SAES::deleteFile((const char*)manifestFilename);
+
+	auto updateChunk = [&saes, nonce, &index, &existing, &manifest, &numWritten, previous, &inFd, &outFd](const _saes64 chunk) {
+
+		// chunk buffer allocated once per thread
+		static thread_local std::unique_ptr<byte[]> chunkBuffer = nullptr;
+		static thread_local _saes64 chunkBufferSize = 0;
+		unsigned int plainLen = index.getChunk(chunk).plainLen;
+		uint64_t chunkFingerprint;
+
+		// holes are never stored, their fingerprint marks them
+		if (index.getChunk(chunk).flags == SAES_CHUNK_FLAG_HOLE) {
+			manifest.setFingerprint(chunk, 0);
+			return;
+		}
+		if (plainLen > chunkBufferSize) {
+			chunkBuffer = std::unique_ptr<byte[]>(new byte[plainLen]);
+			chunkBufferSize = plainLen;
+		}
+		if (FileIO::readAt(inFd, chunkBuffer.get(), plainLen, index.getPlainOffset(chunk)) != plainLen)
+			throw FileException("Failed to read file. Exiting program.\n");
+
+		// keep chunks the previous run already stored, with their checksums
+		chunkFingerprint = manifest.fingerprint(chunkBuffer.get(), plainLen);
+		manifest.setFingerprint(chunk, chunkFingerprint);
+		if (previous && manifest.isUnchanged(chunk, plainLen, chunkFingerprint) && (chunk < existing.getNumChunks()) && (existing.getChunk(chunk).flags == 0)) {
+			index.setChecksum(chunk, existing.getChunk(chunk).checksum);
+			return;
+		}
+
+		saes.applyKeystream(nonce, index.getCounter(chunk), chunkBuffer.get(), plainLen);
+		index.setChecksum(chunk, CRC32C::update(0, chunkBuffer.get(), plainLen));
+		FileIO::writeAt(outFd, chunkBuffer.get(), plainLen, index.getChunk(chunk).offset);
+		numWritten++;
+
+	};
+
+	try {
+		inFd = FileIO::openFile(filename, FILECODE::FILE_INPUT);
+		if (outFd < 0)
+			outFd = FileIO::openFile(newFilename, FILECODE::FILE_OUTPUT);
+
+		// one task per chunk
+		if (pool) {
+			for (_saes64 chunk = 0; chunk < index.getNumChunks(); chunk++)
+				pool->submit([&updateChunk, chunk]() { updateChunk(chunk); });
+			pool->wait();
+		}
+		else {
+			for (_saes64 chunk = 0; chunk < index.getNumChunks(); chunk++)
+				updateChunk(chunk);
+		}
+
+		// trailer follows the body, a shrunken file loses its old tail
+		index.write(trailer);
+		FileIO::writeAt(outFd, trailer, trailerSize, index.getStoredSize());
+		FileIO::setFileSize(outFd, index.getStoredSize() + trailerSize);
+	}
+	catch (FileException&) {
+		if (inFd >= 0)
+			FileIO::closeFile(inFd);
+		if (outFd >= 0)
+			FileIO::closeFile(outFd);
+		throw;
+	}
+
+	FileIO::closeFile(inFd);
+	FileIO::closeFile(outFd);
+	manifest.write((const char*)manifestFilename, trailer, trailerSize);
+
+	return numWritten;
+
+}
+
+/**
+Decrypt a version 2 file body chunk by chunk. Each chunk has its own index entry and counter range, so workers take
+chunks with no coordination, decompressing any compressed ones, and write them at their plaintext offsets. Hole chunks
+are not written and the output is sized to the plaintext, so holes stay holes.
+
+@param saes (IN) Cipher context, shared read-only by all workers.
+@param nonce (IN) Nonce derived from password.
+@param index (IN) Chunk index, all entries loaded.
+@param inFd (IN) Input file descriptor.
+@param outFd (IN) Output file descriptor.
+
+@throw Throws FileException() if a chunk failed to read, decode or write.
+*/
+void SAESFileEngine::decryptChunks(const SAES& saes, const byte* nonce, const SAESChunkIndex& index, const int inFd, const int outFd) {
+
+	auto decryptChunk = [&saes, nonce, &index, inFd, outFd](const _saes64 chunk) {
+
+		// chunk buffer allocated once per thread
+		static thread_local std::unique_ptr<byte[]> chunkBuffer = nullptr;
+		static thread_local _saes64 chunkBufferSize = 0;
+		_saes64 plainLen = index.getChunk(chunk).plainLen;
+
+		if (plainLen > chunkBufferSize) {
+			chunkBuffer = std::unique_ptr<byte[]>(new byte[(size_t)plainLen]);
+			chunkBufferSize = plainLen;
+		}
+
+		const SAESChunk& entry = index.getChunk(chunk);
+		if (entry.flags == SAES_CHUNK_FLAG_HOLE)
+			return;
+		if (FileIO::readAt(inFd, chunkBuffer.get(), entry.storedLen, entry.offset) != entry.storedLen)
+			throw FileException("Failed to read file. Exiting program.\n");
+		index.decryptChunk(saes, nonce, chunk, chunkBuffer.get(), chunkBuffer.get());
+		FileIO::writeAt(outFd, chunkBuffer.get(), plainLen, index.getPlainOffset(chunk));
+
+	};
+
+	// one task per chunk
+	if (pool) {
+		for (_saes64 chunk = 0; chunk < index.getNumChunks(); chunk++)
+			pool->submit([&decryptChunk, chunk]() { decryptChunk(chunk); });
+		pool->wait();
+	}
+	else {
+		for (_saes64 chunk = 0; chunk < index.getNumChunks(); chunk++)
+			decryptChunk(chunk);
+	}
+
+	// trailing holes
+	FileIO::setFileSize(outFd, index.getPlainSize());
+
+}
+
+/**
+Select CPU I/O buffer size for a file.
+
+@param fileSize (IN) Bytes of file body.
+
+@return Buffer size in bytes, a power of 2 in [SAES_CPU_BUFFER_MIN_SIZE, SAES_CPU_BUFFER_MAX_SIZE].
+*/
+_saes64 SAESFileEngine::selectBufferSize(const _saes64 fileSize) const {
+
+	_saes64 bufferSize = SAES_CPU_BUFFER_MIN_SIZE;
+
+	// requested size
+	if (options.bufferSize != 0)
+		return options.bufferSize;
+
+	// grow until file fits in target number of buffers
+	while ((bufferSize < SAES_CPU_BUFFER_AUTO_MAX_SIZE) && ((bufferSize * SAES_CPU_BUFFER_AUTO_DIVISOR) < fileSize))
+		bufferSize <<= 1;
+
+	return bufferSize;
+
+}
+
+/**
+Describe the I/O configuration of a run for the timer output.
+
+@param description (OUT) Description string.
+@param descriptionSize (IN) Bytes available in description.
+@param onGPU (IN) True if file body is ciphered on the GPU.
+@param memoryMapped (IN) True if file body is ciphered between memory mappings.
+@param bufferSize (IN) Single-threaded CPU buffer size in bytes.
+*/
+void SAESFileEngine::describeRun(char* description, const size_t descriptionSize, const bool onGPU, const bool memoryMapped, const _saes64 bufferSize) const {
+
+	size_t len;
+
+	if (onGPU)
+		snprintf(description, descriptionSize, "GPU");
+	else if (memoryMapped)
+		snprintf(description, descriptionSize, "memory mapped, %u threads", pool ? pool->getNumThreads() : 1);
+	else if (pool)
+		snprintf(description, descriptionSize, "%u threads, %i KB chunks", pool->getNumThreads(), SAES_PARALLEL_CHUNK_SIZE / 1024);
+	else
+		snprintf(description, descriptionSize, "%i KB buffers, %s", (int)(bufferSize / 1024), aio->usingIOUring() ? "io_uring" : "threaded I/O");
+
+	// page cache mode of streamed I/O
+	len = strlen(description);
+	if (!onGPU && !memoryMapped && (options.cacheMode == CACHECODE::CACHE_DIRECT))
+		snprintf(description + len, descriptionSize - len, ", direct I/O");
+	else if (!onGPU && !memoryMapped && (options.cacheMode == CACHECODE::CACHE_DROP_BEHIND))
+		snprintf(description + len, descriptionSize - len, ", drop-behind");
+
+}
@@ -0,0 +1,103 @@
+#ifndef SAESFILEENGINE_H
+#define SAESFILEENGINE_H
+
+#ifdef __linux__
+#include <inttypes.h>
+#endif
+#include "SAESconstants.h"
+#include "Exceptions.h"
+#include "SAES.h"
+#include "GPU.h"
+#include "AsyncIO.h"
+#include "ThreadPool.h"
+#include "SAESChunkIndex.h"
+#include "SAESAuth.h"
+#include <memory>
+
+// engine settings, fixed for the life of an engine
+struct SAESEngineOptions {
+	bool useGPU = true; // build the OpenCL program for encryption, falls back to the CPU if unavailable
+	int numThreads = 1; // CPU worker threads, 0 = one per hardware thread
+	_saes64 bufferSize = 0; // CPU I/O buffer bytes, 0 = select from file size
+	bool memoryMap = false; // memory map files instead of streaming them
+	CACHECODE cacheMode = CACHECODE::CACHE_DEFAULT; // page cache use of streamed CPU I/O
+	bool verbose = false; // print backend selection and per-file timings
+	int formatVersion = SAES_FORMAT_VERSION_1; // container written by encryption, decryption reads either
+	bool authenticate = false; // store a tag with encrypted version 1 files, decryption checks any tag it finds
+	bool checksum = false; // store CRC32C of plaintext and ciphertext with encrypted version 1 files, decryption checks any it finds
+	bool compress = false; // LZ4 compress chunks of encrypted version 2 files before ciphering, decryption expands any it finds
+	bool incremental = false; // encrypt version 2 files by rewriting only chunks changed since the last run, keeping the input
+};
+
+// SAES file encryption library.
+// An engine is built once with its backend (GPU program, worker pool, asynchronous I/O) and reused across calls; key
+// schedules are kept for the last password and key length used. Calls on one engine must not overlap.
+// A password is the key itself: pass SAES_MAX_KEY_BYTES bytes, zero-padded past the end of the password.
+// Errors throw FileException or GPUException.
+class SAES_API SAESFileEngine {
+
+public:
+
+	// constructor
+	SAESFileEngine(const SAESEngineOptions& = SAESEngineOptions());
+
+	// destructor
+	~SAESFileEngine();
+
+	// files, output replaces input
+	void encryptFile(const char*, byte*, const int);
+	void decryptFile(const char*, byte*);
+	unsigned int cipherFiles(const OPCODE, const int, const byte(*)[SAES_MAX_FILENAME_BUFFER_SIZE], byte*, const int);
+
+	// buffers
+	static _saes64 getEncryptedSize(const _saes64);
+	static _saes64 getDecryptedSize(const byte*, const _saes64);
+	_saes64 encryptBuffer(const byte*, const _saes64, byte*, byte*, const int, const byte* = nullptr);
+	_saes64 decryptBuffer(const byte*, const _saes64, byte*, byte*);
+
+	// pipes, in the framed stream format
+	void encryptStream(const int, const int, byte*, const int);
+	void decryptStream(const int, const int, byte*);
+
+	// backend
+	bool usingGPU() const;
+
+private:
+
+	// not copyable, owns device and threads
+	SAESFileEngine(const SAESFileEngine&);
+	SAESFileEngine& operator=(const SAESFileEngine&);
+
+	// cipher context
+	SAES& getCipher(byte*, const int);
+
+	// padding block flag of new files
+	byte getAuthFlag() const;
+
+	// GPU program, built on first use
+	bool encryptsOnGPU() const;
+	bool prepareGPU();
+
+	// file body backends
+	void gpuCipherFile(SAES&, const byte*, std::fstream&, std::fstream&, const _saes64, const _saes64);
+	void parallelCipherFile(const SAES&, const byte*, const int, const int, const _saes64, const _saes64, SAESAuth*, SAESChunkIndex* = nullptr);
+	void pipelinedCipherFile(const SAES&, const byte*, const int, const int, const _saes64, const _saes64, const _saes64, SAESAuth*, SAESChunkIndex* = nullptr);
+	void cipherMemory(const SAES&, const byte*, const byte*, byte*, const _saes64, const _saes64, SAESAuth*, SAESChunkIndex* = nullptr);
+	void packChunks(const SAES&, const byte*, SAESChunkIndex&, const int, const int);
+	_saes64 updateChunks(const SAES&, const byte*, SAESChunkIndex&, const char*, const char*, byte*, const _saes64);
+	void decryptChunks(const SAES&, const byte*, const SAESChunkIndex&, const int, const int);
+	_saes64 selectBufferSize(const _saes64) const;
+	void describeRun(char*, const size_t, const bool, const bool, const _saes64) const;
+
+	SAESEngineOptions options;
+	std::unique_ptr<GPU> gpu;
+	bool gpuEnabled;
+	std::unique_ptr<ThreadPool> pool;
+	std::unique_ptr<AsyncIO> aio;
+	std::unique_ptr<SAES> cipher;
+	byte cipherPassword[SAES_MAX_KEY_BYTES];
+	int cipherKeylength;
+
+};
+
+#endif
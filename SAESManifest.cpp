@@ -0,0 +1,235 @@
+#include "SAESManifest.h"
+#include "FileIO.h"
+#include "XXHash64.h"
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string.h>
+
+// first byte of the block ciphered into seed and key check, above any nonce byte and below the authentication salt mark
+#define SAES_MANIFEST_KEY_MARK 0x80
+
+/**
+Store little-endian integer.
+
+@param out (OUT) Destination of numBytes bytes.
+@param value (IN) Value to store.
+@param numBytes (IN) Bytes to store, at most 8.
+*/
+static void storeLE(byte* out, const uint64_t value, const int numBytes) {
+	for (int i = 0; i < numBytes; i++)
+		out[i] = (byte)((value >> (8 * i)) & 0xFF);
+}
+
+/**
+Load little-endian integer.
+
+@param in (IN) Source of numBytes bytes.
+@param numBytes (IN) Bytes to load, at most 8.
+
+@return Loaded value.
+*/
+static uint64_t loadLE(const byte* in, const int numBytes) {
+
+	uint64_t value = 0;
+
+	for (int i = numBytes - 1; i >= 0; i--)
+		value = (value << 8) | in[i];
+
+	return value;
+
+}
+
+/**
+Derive fingerprint seed and key check from the cipher and size the manifest for a plaintext.
+
+@param saes (IN) Cipher context of the file.
+@param _plainSize (IN) Bytes of plaintext.
+@param _chunkSize (IN) Plaintext bytes per chunk.
+*/
+SAESManifest::SAESManifest(const SAES& saes, const _saes64 _plainSize, const unsigned int _chunkSize) :
+	chunkSize(_chunkSize),
+	plainSize(_plainSize),
+	previousPlainSize(0)
+{
+
+	byte block[SAES_BLOCK_BYTES] = { SAES_MANIFEST_KEY_MARK };
+	byte keys[SAES_BLOCK_BYTES];
+
+	saes.cipherBlocks(block, keys, 1);
+	seed = loadLE(keys, 8);
+	keyCheck = loadLE(keys + 8, 8);
+
+	fingerprints.resize((size_t)((plainSize / chunkSize) + ((plainSize % chunkSize) ? 1 : 0)));
+
+}
+
+/**
+Set manifest filename, SAES filename + SAES_MANIFEST_SUFFIX.
+
+@param filename (IN) Name of SAES file.
+@param manifestFilename (OUT) Name of manifest file, SAES_MAX_FILENAME_BUFFER_SIZE bytes.
+
+@throw Throws FileException() if the name does not fit.
+*/
+void SAESManifest::setFilename(const byte* filename, byte* manifestFilename) {
+
+	if (strlen((const char*)filename) + strlen(SAES_MANIFEST_SUFFIX) >= SAES_MAX_FILENAME_BUFFER_SIZE)
+		throw FileException("Manifest filename is too long. Exiting program.\n");
+
+	strcpy((char*)manifestFilename, (const char*)filename);
+	strcat((char*)manifestFilename, SAES_MANIFEST_SUFFIX);
+
+}
+
+/**
+Store a random run id in the unused bytes of a key length block, marking the file as written by this run.
+
+@param keylength (IN/OUT) Key length block, SAES::writeHeaders() fills in the key length.
+*/
+void SAESManifest::storeRunId(byte* keylength) {
+
+	std::random_device random;
+
+	for (int i = 0; i < SAES_MANIFEST_RUN_ID_BYTES; i += sizeof(unsigned int)) {
+		unsigned int word = random();
+		memcpy(keylength + SAES_MANIFEST_RUN_ID + i, &word, sizeof(unsigned int));
+	}
+
+}
+
+/**
+Load fingerprints of the previous run, if its manifest belongs to the file as it is now.
+
+@param filename (IN) Name of manifest file.
+@param trailer (IN) Chunk index and SAES headers of the existing SAES file.
+@param trailerLen (IN) Bytes of trailer.
+
+@return True if the manifest was loaded; false if it is missing, damaged, of another password, key length or chunk
+size, or does not match the trailer.
+*/
+bool SAESManifest::read(const char* filename, const byte* trailer, const _saes64 trailerLen) {
+
+	byte header[SAES_MANIFEST_HEADER_BYTES];
+	std::unique_ptr<byte[]> entries = nullptr;
+	_saes64 fileSize, numChunks;
+	int fd;
+
+	try {
+		fd = FileIO::openFile(filename, FILECODE::FILE_INPUT);
+	}
+	catch (FileException&) {
+		return false;
+	}
+
+	try {
+		fileSize = FileIO::getFileSize(fd);
+		if ((fileSize < SAES_MANIFEST_HEADER_BYTES) || (FileIO::readAt(fd, header, SAES_MANIFEST_HEADER_BYTES, 0) != SAES_MANIFEST_HEADER_BYTES))
+			throw FileException("Error reading SAES manifest. Exiting program.\n");
+
+		// same password, chunking and file
+		if ((memcmp(header, SAES_MANIFEST_MAGIC, SAES_MANIFEST_MAGIC_BYTES) != 0) || (loadLE(header + 8, 4) != chunkSize) ||
+			(loadLE(header + 24, 8) != keyCheck) || (loadLE(header + 32, 8) != XXHash64::hash(trailer, trailerLen, seed)))
+			throw FileException("Error reading SAES manifest. Exiting program.\n");
+
+		previousPlainSize = loadLE(header + 16, 8);
+		numChunks = (previousPlainSize / chunkSize) + ((previousPlainSize % chunkSize) ? 1 : 0);
+		if (numChunks != (fileSize - SAES_MANIFEST_HEADER_BYTES) / 8 || ((fileSize - SAES_MANIFEST_HEADER_BYTES) % 8))
+			throw FileException("Error reading SAES manifest. Exiting program.\n");
+
+		entries = std::unique_ptr<byte[]>(new byte[(size_t)(numChunks * 8)]);
+		if (FileIO::readAt(fd, entries.get(), numChunks * 8, SAES_MANIFEST_HEADER_BYTES) != numChunks * 8)
+			throw FileException("Error reading SAES manifest. Exiting program.\n");
+	}
+	catch (FileException&) {
+		FileIO::closeFile(fd);
+		previousPlainSize = 0;
+		return false;
+	}
+	FileIO::closeFile(fd);
+
+	previousFingerprints.resize((size_t)numChunks);
+	for (_saes64 i = 0; i < numChunks; i++)
+		previousFingerprints[(size_t)i] = loadLE(entries.get() + (i * 8), 8);
+
+	return true;
+
+}
+
+/**
+Write manifest of the current fingerprints.
+
+@param filename (IN) Name of manifest file.
+@param trailer (IN) Chunk index and SAES headers of the SAES file just written.
+@param trailerLen (IN) Bytes of trailer.
+
+@throw Throws FileException() if the manifest could not be written.
+*/
+void SAESManifest::write(const char* filename, const byte* trailer, const _saes64 trailerLen) const {
+
+	_saes64 manifestLen = SAES_MANIFEST_HEADER_BYTES + (fingerprints.size() * 8);
+	std::unique_ptr<byte[]> manifest = std::unique_ptr<byte[]>(new byte[(size_t)manifestLen]());
+	int fd;
+
+	memcpy(manifest.get(), SAES_MANIFEST_MAGIC, SAES_MANIFEST_MAGIC_BYTES);
+	storeLE(manifest.get() + 8, chunkSize, 4);
+	storeLE(manifest.get() + 16, plainSize, 8);
+	storeLE(manifest.get() + 24, keyCheck, 8);
+	storeLE(manifest.get() + 32, XXHash64::hash(trailer, trailerLen, seed), 8);
+	for (size_t i = 0; i < fingerprints.size(); i++)
+		storeLE(manifest.get() + SAES_MANIFEST_HEADER_BYTES + (i * 8), fingerprints[i], 8);
+
+	fd = FileIO::openFile(filename, FILECODE::FILE_OUTPUT);
+	try {
+		FileIO::writeAt(fd, manifest.get(), manifestLen, 0);
+	}
+	catch (FileException&) {
+		FileIO::closeFile(fd);
+		throw;
+	}
+	FileIO::closeFile(fd);
+
+}
+
+/**
+Fingerprint a plaintext chunk.
+
+@param data (IN) Plaintext of chunk.
+@param len (IN) Bytes of chunk.
+
+@return Keyed XXHash64 of the chunk.
+*/
+uint64_t SAESManifest::fingerprint(const byte* data, const _saes64 len) const {
+	return XXHash64::hash(data, len, seed);
+}
+
+/**
+Check a chunk against the previous run. A chunk is unchanged if the previous plaintext had the same chunk with the same
+length and fingerprint.
+
+@param chunk (IN) Chunk number.
+@param plainLen (IN) Plaintext bytes of chunk now.
+@param chunkFingerprint (IN) Fingerprint of chunk now.
+
+@return True if the stored chunk can be kept.
+*/
+bool SAESManifest::isUnchanged(const _saes64 chunk, const unsigned int plainLen, const uint64_t chunkFingerprint) const {
+
+	_saes64 chunkOffset = chunk * chunkSize;
+
+	if ((chunk >= previousFingerprints.size()) || (std::min((_saes64)chunkSize, previousPlainSize - chunkOffset) != plainLen))
+		return false;
+
+	return previousFingerprints[(size_t)chunk] == chunkFingerprint;
+
+}
+
+/**
+Record fingerprint of a chunk for the manifest to be written.
+
+@param chunk (IN) Chunk number.
+@param chunkFingerprint (IN) Fingerprint of chunk.
+*/
+void SAESManifest::setFingerprint(const _saes64 chunk, const uint64_t chunkFingerprint) {
+	fingerprints[(size_t)chunk] = chunkFingerprint;
+}
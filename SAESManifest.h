@@ -0,0 +1,50 @@
+#ifndef SAESMANIFEST_H
+#define SAESMANIFEST_H
+
+#ifdef __linux__
+#include <inttypes.h>
+#endif
+#include "SAESconstants.h"
+#include "Exceptions.h"
+#include "SAES.h"
+#include <stdint.h>
+#include <vector>
+
+// chunk fingerprint manifest of a version 2 SAES file, kept next to it for incremental re-encryption.
+// Layout, little-endian: SAES_MANIFEST_MAGIC, chunk size (4), reserved (4), plaintext size (8), key check (8), trailer
+// hash (8), then an XXHash64 fingerprint (8) of each plaintext chunk. The fingerprint seed and key check are ciphered
+// from a fixed block whose first byte is above any nonce byte, so the manifest neither repeats a keystream block nor
+// lets anyone test guesses of chunk contents without the password. The key check rejects a manifest of another password
+// or key length. Each run stores a random run id in the key length block, so the trailer hash, over the chunk index and
+// SAES headers, rejects a manifest whose file was since rewritten or replaced by another of the same size.
+class SAESManifest {
+
+public:
+
+	// constructor
+	SAESManifest(const SAES&, const _saes64, const unsigned int);
+
+	// manifest file
+	static void setFilename(const byte*, byte*);
+	static void storeRunId(byte*);
+	bool read(const char*, const byte*, const _saes64);
+	void write(const char*, const byte*, const _saes64) const;
+
+	// fingerprints
+	uint64_t fingerprint(const byte*, const _saes64) const;
+	bool isUnchanged(const _saes64, const unsigned int, const uint64_t) const;
+	void setFingerprint(const _saes64, const uint64_t);
+
+private:
+
+	uint64_t seed;
+	uint64_t keyCheck;
+	unsigned int chunkSize;
+	_saes64 plainSize;
+	_saes64 previousPlainSize;
+	std::vector<uint64_t> fingerprints;
+	std::vector<uint64_t> previousFingerprints;
+
+};
+
+#endif
@@ -0,0 +1,306 @@
+#include "SAESStream.h"
+#include "FileIO.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+FILE* SAESStream::heldConsole = nullptr;
+int SAESStream::heldStdoutFd = -1;
+
+/**
+Write framed format header.
+
+@param outFd (IN) Output file descriptor.
+@param iKeylength (IN) Key size in integer form.
+@param filenameFormat (IN) File format of original file (ie., .txt, .jpg), SAES_MAX_FILENAME_BYTES.
+
+@throw Throws FileException() if write fails.
+*/
+void SAESStream::writeHeader(const int outFd, const int iKeylength, const byte* filenameFormat) {
+
+	byte header[SAES_STREAM_HEADER_BYTES] = { 0x00 };
+
+	// magic, version and key length
+	memcpy(header, SAES_STREAM_MAGIC, SAES_STREAM_MAGIC_BYTES);
+	header[SAES_STREAM_MAGIC_BYTES] = SAES_STREAM_VERSION;
+	header[SAES_STREAM_MAGIC_BYTES + 1] = (iKeylength & 0x00FF) >> 0;
+	header[SAES_STREAM_MAGIC_BYTES + 2] = (iKeylength & 0xFF00) >> 8;
+
+	// file format
+	memcpy(header + SAES_BLOCK_BYTES, filenameFormat, SAES_MAX_FILENAME_BYTES);
+
+	FileIO::writeStream(outFd, header, SAES_STREAM_HEADER_BYTES);
+
+}
+
+/**
+Parse framed format header.
+
+@param header (IN) First SAES_STREAM_HEADER_BYTES of file.
+@param iKeylength (OUT) Key size in integer form.
+@param filenameFormat (OUT) File format of original file (ie., .txt, .jpg), SAES_MAX_FILENAME_BYTES.
+
+@return True if header is a framed format header, false if file is in the legacy trailing-header format.
+
+@throw Throws FileException() if header is from a newer format version.
+*/
+bool SAESStream::readHeader(const byte* header, int& iKeylength, byte* filenameFormat) {
+
+	// magic
+	if (memcmp(header, SAES_STREAM_MAGIC, SAES_STREAM_MAGIC_BYTES) != 0)
+		return false;
+	if (header[SAES_STREAM_MAGIC_BYTES] != SAES_STREAM_VERSION)
+		throw FileException("Unsupported SAES stream version. Exiting program.\n");
+
+	// key length
+	iKeylength = (header[SAES_STREAM_MAGIC_BYTES + 2] << 8) | (header[SAES_STREAM_MAGIC_BYTES + 1] << 0);
+
+	// file format, always terminated
+	memcpy(filenameFormat, header + SAES_BLOCK_BYTES, SAES_MAX_FILENAME_BYTES);
+	filenameFormat[SAES_MAX_FILENAME_BYTES - 1] = 0x00;
+
+	return true;
+
+}
+
+/**
+Encrypt input into frames in one forward pass. The header must already be written.
+
+@param saes (IN) Cipher context.
+@param nonce (IN) Nonce derived from password.
+@param inFd (IN) Input file descriptor, read sequentially to end.
+@param outFd (IN) Output file descriptor, written sequentially.
+@param frameSize (IN) Plaintext bytes per frame, a multiple of SAES_BLOCK_BYTES.
+
+@throw Throws FileException() if read or write fails.
+*/
+void SAESStream::encrypt(const SAES& saes, const byte* nonce, const int inFd, const int outFd, const _saes64 frameSize) {
+
+	std::unique_ptr<byte[]> frame = std::unique_ptr<byte[]>(new byte[SAES_STREAM_FRAME_LEN_BYTES + frameSize]);
+	byte* frameData = frame.get() + SAES_STREAM_FRAME_LEN_BYTES;
+	_saes64 counter = 0;
+	_saes64 frameLen;
+
+	do {
+
+		// read next frame
+		frameLen = FileIO::readStream(inFd, frameData, frameSize);
+
+		// encrypt in place
+		saes.applyKeystream(nonce, counter, frameData, frameLen);
+		counter += frameLen / SAES_BLOCK_BYTES;
+
+		// length prefix, a zero length frame ends the stream
+		for (int i = 0; i < SAES_STREAM_FRAME_LEN_BYTES; i++)
+			frame[i] = (byte)(frameLen >> (i * SAES_BYTE_SIZE));
+
+		// write frame
+		FileIO::writeStream(outFd, frame.get(), SAES_STREAM_FRAME_LEN_BYTES + frameLen);
+
+		// a short frame means end of input, close stream without another read
+		if ((frameLen != 0) && (frameLen < frameSize)) {
+			frameLen = 0;
+			memset(frame.get(), 0, SAES_STREAM_FRAME_LEN_BYTES);
+			FileIO::writeStream(outFd, frame.get(), SAES_STREAM_FRAME_LEN_BYTES);
+		}
+
+	} while (frameLen != 0);
+
+}
+
+/**
+Decrypt frames in one forward pass. The header must already be consumed.
+
+@param saes (IN) Cipher context.
+@param nonce (IN) Nonce derived from password.
+@param inFd (IN) Input file descriptor, positioned at the first frame.
+@param outFd (IN) Output file descriptor, written sequentially.
+
+@throw Throws FileException() if read or write fails, or the stream is truncated or corrupt.
+*/
+void SAESStream::decrypt(const SAES& saes, const byte* nonce, const int inFd, const int outFd) {
+
+	std::unique_ptr<byte[]> frame = nullptr;
+	byte frameLenBytes[SAES_STREAM_FRAME_LEN_BYTES];
+	_saes64 frameCapacity = 0;
+	_saes64 counter = 0;
+	bool partialBlock = false;
+
+	while (true) {
+
+		_saes64 frameLen = 0;
+
+		// length prefix
+		if (FileIO::readStream(inFd, frameLenBytes, SAES_STREAM_FRAME_LEN_BYTES) != SAES_STREAM_FRAME_LEN_BYTES)
+			throw FileException("SAES stream is truncated. Exiting program.\n");
+		for (int i = 0; i < SAES_STREAM_FRAME_LEN_BYTES; i++)
+			frameLen |= (_saes64)frameLenBytes[i] << (i * SAES_BYTE_SIZE);
+		if (frameLen == 0)
+			break;
+
+		// only the last frame may end mid-block
+		if (partialBlock || (frameLen > SAES_CPU_BUFFER_MAX_SIZE))
+			throw FileException("SAES stream is corrupt. Exiting program.\n");
+		partialBlock = (frameLen % SAES_BLOCK_BYTES) != 0;
+
+		// grow buffer to largest frame
+		if (frameLen > frameCapacity) {
+			frame = std::unique_ptr<byte[]>(new byte[frameLen]);
+			frameCapacity = frameLen;
+		}
+
+		// read frame
+		if (FileIO::readStream(inFd, frame.get(), frameLen) != frameLen)
+			throw FileException("SAES stream is truncated. Exiting program.\n");
+
+		// decrypt in place and write
+		saes.applyKeystream(nonce, counter, frame.get(), frameLen);
+		counter += frameLen / SAES_BLOCK_BYTES;
+		FileIO::writeStream(outFd, frame.get(), frameLen);
+
+	}
+
+}
+
+/**
+Prepare standard input for binary reads.
+
+@return File descriptor of standard input.
+*/
+int SAESStream::claimStdin() {
+
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+	return _fileno(stdin);
+#else
+	return STDIN_FILENO;
+#endif
+
+}
+
+/**
+Take standard output for binary data. Console messages printed afterwards go to standard error.
+
+@return File descriptor of the original standard output.
+
+@throw Throws FileException() if standard output could not be duplicated.
+*/
+int SAESStream::claimStdout() {
+
+	int fd;
+
+	fflush(stdout);
+#ifdef _WIN32
+	fd = _dup(_fileno(stdout));
+	_dup2(_fileno(stderr), _fileno(stdout));
+	if (fd >= 0)
+		_setmode(fd, _O_BINARY);
+#else
+	fd = dup(STDOUT_FILENO);
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+#endif
+	if (fd < 0)
+		throw FileException("Failed to open standard output. Exiting program.\n");
+
+	return fd;
+
+}
+
+/**
+Hold back console messages until it is known whether standard output carries data. Messages printed until
+releaseStdout() are captured in a temporary file; if the program exits first, they go to standard output as usual.
+Without a temporary file nothing is held.
+*/
+void SAESStream::holdStdout() {
+
+	static bool registered = false;
+
+	fflush(stdout);
+	heldConsole = tmpfile();
+	if (!heldConsole)
+		return;
+#ifdef _WIN32
+	heldStdoutFd = _dup(_fileno(stdout));
+	if ((heldStdoutFd < 0) || (_dup2(_fileno(heldConsole), _fileno(stdout)) != 0)) {
+#else
+	heldStdoutFd = dup(STDOUT_FILENO);
+	if ((heldStdoutFd < 0) || (dup2(fileno(heldConsole), STDOUT_FILENO) < 0)) {
+#endif
+		fclose(heldConsole);
+		heldConsole = nullptr;
+		return;
+	}
+
+	// parse errors exit before release
+	if (!registered)
+		atexit(replayHeldStdout);
+	registered = true;
+
+}
+
+/**
+Give standard output back, taking it for binary data if claim is set, and print the messages held since holdStdout()
+to the console: standard output, or standard error once it is claimed.
+
+@param claim (IN) True if standard output carries data.
+
+@return File descriptor of the original standard output if claimed, else -1.
+
+@throw Throws FileException() if standard output could not be duplicated.
+*/
+int SAESStream::releaseStdout(const bool claim) {
+
+	int fd = -1;
+
+	restoreStdout();
+	if (claim)
+		fd = claimStdout();
+	replayHeldStdout();
+
+	return fd;
+
+}
+
+/**
+Point standard output back at the original after holdStdout(), flushing messages still buffered into the capture.
+*/
+void SAESStream::restoreStdout() {
+
+	fflush(stdout);
+	if (heldStdoutFd < 0)
+		return;
+#ifdef _WIN32
+	_dup2(heldStdoutFd, _fileno(stdout));
+	_close(heldStdoutFd);
+#else
+	dup2(heldStdoutFd, STDOUT_FILENO);
+	close(heldStdoutFd);
+#endif
+	heldStdoutFd = -1;
+
+}
+
+/**
+Print held console messages to the console and drop them, restoring standard output first if still held.
+*/
+void SAESStream::replayHeldStdout() {
+
+	char buffer[BUFSIZ];
+	size_t len;
+
+	if (!heldConsole)
+		return;
+	restoreStdout();
+
+	rewind(heldConsole);
+	while ((len = fread(buffer, 1, sizeof(buffer), heldConsole)) > 0)
+		fwrite(buffer, 1, len, stdout);
+	fflush(stdout);
+	fclose(heldConsole);
+	heldConsole = nullptr;
+
+}
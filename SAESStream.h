@@ -0,0 +1,47 @@
+#ifndef SAESSTREAM_H
+#define SAESSTREAM_H
+
+#ifdef __linux__
+#include <inttypes.h>
+#endif
+#include "SAESconstants.h"
+#include "Exceptions.h"
+#include "SAES.h"
+
+// single-pass framed SAES format for pipes.
+// Layout: SAES_STREAM_HEADER_BYTES header (magic, version, key length, file format), then frames of a
+// little-endian SAES_STREAM_FRAME_LEN_BYTES length followed by that many ciphertext bytes, ended by a zero length frame.
+// Every frame but the last holds a multiple of SAES_BLOCK_BYTES, so the CTR counter runs on across frames unpadded.
+class SAESStream {
+
+public:
+
+	// header
+	static void writeHeader(const int, const int, const byte*);
+	static bool readHeader(const byte*, int&, byte*);
+
+	// encryption/decryption
+	static void encrypt(const SAES&, const byte*, const int, const int, const _saes64);
+	static void decrypt(const SAES&, const byte*, const int, const int);
+
+	// standard streams
+	static int claimStdin();
+	static int claimStdout();
+	static void holdStdout();
+	static int releaseStdout(const bool);
+
+private:
+
+	// constructor
+	SAESStream();
+
+	// console messages held back while the arguments are parsed
+	static void restoreStdout();
+	static void replayHeldStdout();
+
+	static FILE* heldConsole;
+	static int heldStdoutFd;
+
+};
+
+#endif
@@ -1,9 +1,47 @@
 #ifndef SAESCONSTANTS_H
 #define SAESCONSTANTS_H
 
-#define SAES_CPU_BUFFER_SIZE 1024 // (i) A power of 2. (ii) In range [64, inf).
+#define SAES_CPU_BUFFER_MIN_SIZE (64 * 1024) // runtime buffer size bounds, sizes are powers of 2
+#define SAES_CPU_BUFFER_MAX_SIZE (64 * 1024 * 1024)
+#define SAES_CPU_BUFFER_AUTO_MAX_SIZE (8 * 1024 * 1024) // largest automatically selected buffer size
+#define SAES_CPU_BUFFER_AUTO_DIVISOR 16 // automatic buffer size aims for this many buffers per file
+#define SAES_IO_QUEUE_DEPTH 4 // buffers in the single-threaded I/O pipeline: read-ahead, cipher and write-behind
+#define SAES_DIRECT_IO_ALIGNMENT 4096 // O_DIRECT buffer address, file offset and length alignment
+#define SAES_PARALLEL_CHUNK_SIZE (4 * 1024 * 1024) // bytes per multi-threaded work item, a multiple of SAES_BLOCK_BYTES
+#define SAES_BATCH_SPLIT_SIZE (2 * SAES_PARALLEL_CHUNK_SIZE) // batch files at least this large are split into chunks
+#define SAES_BATCH_TASK_BYTES SAES_PARALLEL_CHUNK_SIZE // bytes of small files run by one batch task before it yields
+#define SAES_BATCH_TASK_FILES 64 // files handed to one batch task
 #define SAES_FILE_FORMAT ".saes"
+#define SAES_FORMAT_VERSION_1 1 // padded body followed by headers
+#define SAES_FORMAT_VERSION_2 2 // chunked body and chunk index followed by headers
+#define SAES_CHUNK_SIZE SAES_PARALLEL_CHUNK_SIZE // plaintext bytes per version 2 chunk, a multiple of SAES_BLOCK_BYTES
+#define SAES_CHUNK_ENTRY_BYTES 24 // bytes per version 2 chunk index entry
+#define SAES_CHUNK_FLAG_LZ4 0x01 // version 2 chunk index entry flags: chunk is an LZ4 block, then CTR ciphertext
+#define SAES_CHUNK_FLAG_HOLE 0x02 // chunk is a hole of zero plaintext with nothing stored
+#define SAES_COMPRESS_SAMPLE_BYTES (64 * 1024) // bytes of a chunk sampled by the entropy check
+#define SAES_COMPRESS_ENTROPY_LIMIT 7.5 // bits per byte above which a chunk is stored uncompressed
+#define SAES_MANIFEST_SUFFIX ".manifest" // chunk fingerprint manifest, named after its SAES file
+#define SAES_MANIFEST_MAGIC "SAESMANI"
+#define SAES_MANIFEST_MAGIC_BYTES 8
+#define SAES_MANIFEST_HEADER_BYTES 40 // magic, chunk size, plaintext size, key check and trailer hash ahead of the fingerprints
+#define SAES_MANIFEST_RUN_ID 8 // key length block bytes of the random id of the incremental run that wrote a file
+#define SAES_MANIFEST_RUN_ID_BYTES 8
+#define SAES_HEADER_FLAG_AUTH 0x01 // version 1 padding block byte 2: salt and tag blocks precede the headers
+#define SAES_HEADER_FLAG_CHECKSUM 0x02 // version 1 padding block byte 2: checksum block precedes the headers
+#define SAES_AUTH_BLOCKS 2 // salt and tag blocks of an authenticated file
+#define SAES_CHECKSUM_BLOCKS 1 // checksum block: CRC32C of plaintext and of headers and ciphertext, little-endian
+#define SAES_AUTH_SLICE_BYTES (16 * 1024) // bytes ciphered then hashed while still in cache
 #define SAES_FILE_FORMAT_LEN strlen(SAES_FILE_FORMAT)
+#define SAES_PIPE_FILENAME "-" // file argument selecting stdin/stdout
+#define SAES_STREAM_MAGIC "SAESSTRM"
+#define SAES_STREAM_MAGIC_BYTES 8
+#define SAES_STREAM_VERSION 1
+#define SAES_STREAM_HEADER_BYTES (2 * SAES_BLOCK_BYTES)
+#define SAES_STREAM_FRAME_LEN_BYTES 4
+#define SAES_STREAM_FRAME_SIZE (1024 * 1024) // default plaintext bytes per frame
+#define SAES_DECRYPTBUF_PAGE_SIZE 4096 // default decrypted bytes per cache page, the cost of a random seek
+#define SAES_DECRYPTBUF_CACHE_PAGES 256 // default cache pages
+#define SAES_DECRYPTBUF_READAHEAD (1024 * 1024) // bytes prefetched ahead of sequential reads
 #define SAES_BUFFER_MIN_SIZE 64
 #define SAES_LOOKUP_TABLE_SIZE 256
 #define SAES_HEADERS 3
@@ -12,6 +50,7 @@
 #define SAES_MAX_KEYLENGTH_BYTES 16
 #define SAES_MAX_PADDING_BYTES 16
 #define SAES_BLOCK_BYTES 16
+#define SAES_PIPELINE_BLOCKS 8 // blocks in flight per hardware cipher call
 #define SAES_NONCE_SIZE_BYTES (SAES_BLOCK_BYTES / 2)
 #define SAES_COUNTER_SIZE_BYTES (SAES_BLOCK_BYTES / 2)
 #define SAES_MIN_ROUNDS 6
@@ -22,6 +61,7 @@
 #define SAES_KEY_SIZE_256 256
 #define SAES_MAX_KEY_BYTES 32
 #define SAES_MAX_ROUND_KEY_BYTES 240
+#define SAES_MAX_ROUND_KEY_WORDS (SAES_MAX_ROUND_KEY_BYTES / SAES_STATE_ROW_COL_SIZE)
 #define SAES_STATE_ROW_COL_SIZE 4 // row size == col size
 #define SAES_STATE_SIZE SAES_STATE_ROW_COL_SIZE*SAES_STATE_ROW_COL_SIZE // state = 2d 4x4 matrix array
 
@@ -34,9 +74,24 @@ typedef unsigned __int64 _saes64;
 #endif
 
 enum class OPCODE { ENCRYPTION, DECRYPTION };
-enum class FILECODE { FILE_INPUT, FILE_OUTPUT };
+enum class FILECODE { FILE_INPUT, FILE_OUTPUT, FILE_UPDATE };
+enum class CACHECODE { CACHE_DEFAULT, CACHE_DIRECT, CACHE_DROP_BEHIND };
 
-const byte sbox[SAES_LOOKUP_TABLE_SIZE] = {
+// symbol visibility of the shared library API: SAESFileEngine, saes::idecryptbuf and SAES::decryptRange. Define
+// SAES_SHARED when building or using the shared library and SAES_BUILD_LIBRARY when building it
+#if defined(SAES_SHARED) && defined(_WIN32)
+#ifdef SAES_BUILD_LIBRARY
+#define SAES_API __declspec(dllexport)
+#else
+#define SAES_API __declspec(dllimport)
+#endif
+#elif defined(SAES_SHARED) && defined(__GNUC__)
+#define SAES_API __attribute__((visibility("default")))
+#else
+#define SAES_API
+#endif
+
+constexpr byte sbox[SAES_LOOKUP_TABLE_SIZE] = {
 	//0     1    2      3     4    5     6     7      8    9     A      B    C     D     E     F
 	0x63, 0x7f, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76, //0
 	0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0, //1
@@ -56,7 +111,7 @@ const byte sbox[SAES_LOOKUP_TABLE_SIZE] = {
 	0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16  //F
 };
 
-const byte rcon[SAES_LOOKUP_TABLE_SIZE] = {
+constexpr byte rcon[SAES_LOOKUP_TABLE_SIZE] = {
 	0x8d, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36, 0x6c, 0xd8, 0xab, 0x4d, 0x9a,
 	0x2f, 0x5e, 0xbc, 0x63, 0xc6, 0x97, 0x35, 0x6a, 0xd4, 0xb3, 0x7d, 0xfa, 0xef, 0xc5, 0x91, 0x39,
 	0x72, 0xe4, 0xd3, 0xbd, 0x61, 0xc2, 0x9f, 0x25, 0x4a, 0x94, 0x33, 0x66, 0xcc, 0x83, 0x1d, 0x3a,
@@ -75,7 +130,7 @@ const byte rcon[SAES_LOOKUP_TABLE_SIZE] = {
 	0x61, 0xc2, 0x9f, 0x25, 0x4a, 0x94, 0x33, 0x66, 0xcc, 0x83, 0x1d, 0x3a, 0x74, 0xe8, 0xcb, 0x00
 };
 
-const byte rsbox[SAES_LOOKUP_TABLE_SIZE] =
+constexpr byte rsbox[SAES_LOOKUP_TABLE_SIZE] =
 { 0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38, 0xbf, 0x40, 0xa3, 0x9e, 0x81, 0xf3, 0xd7, 0xfb
 , 0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87, 0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb
 , 0x54, 0x7b, 0x94, 0x32, 0xa6, 0xc2, 0x23, 0x3d, 0xee, 0x4c, 0x95, 0x0b, 0x42, 0xfa, 0xc3, 0x4e
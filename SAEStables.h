@@ -0,0 +1,83 @@
+#ifndef SAESTABLES_H
+#define SAESTABLES_H
+
+#include <stdint.h>
+#include <array>
+#include <utility>
+#include "SAESconstants.h"
+
+typedef std::array<std::array<uint32_t, SAES_LOOKUP_TABLE_SIZE>, SAES_STATE_ROW_COL_SIZE> _saesTTable;
+
+/**
+Multiply byte by x in GF(2^8).
+
+@param x (IN) Byte to multiply.
+
+@return Product reduced by the AES polynomial.
+*/
+constexpr byte gfXtime(const byte x) {
+	return (byte)((x << 1) ^ (((x >> 7) & 1) * 0x1b));
+}
+
+/**
+Multiply two bytes in GF(2^8).
+
+@param x (IN) Multiplicand.
+@param y (IN) Multiplier.
+
+@return Product reduced by the AES polynomial.
+*/
+constexpr byte gfMultiply(const byte x, const byte y) {
+	return (y == 0) ? 0 : (byte)(((y & 1) ? x : 0) ^ gfMultiply(gfXtime(x), (byte)(y >> 1)));
+}
+
+/**
+Pack four state rows of one column into a word, row 0 in the low byte.
+
+@return Packed column.
+*/
+constexpr uint32_t packColumn(const byte r0, const byte r1, const byte r2, const byte r3) {
+	return ((uint32_t)r0 << 0) | ((uint32_t)r1 << 8) | ((uint32_t)r2 << 16) | ((uint32_t)r3 << 24);
+}
+
+/**
+Rotate column down by given number of rows.
+
+@param column (IN) Packed column.
+@param rows (IN) Number of rows to rotate, [0, 3].
+
+@return Rotated column.
+*/
+constexpr uint32_t rotateColumn(const uint32_t column, const int rows) {
+	return (rows == 0) ? column : ((column << (rows * SAES_BYTE_SIZE)) | (column >> (SAES_WORD_SIZE - rows * SAES_BYTE_SIZE)));
+}
+
+/**
+Encryption T-table entry: s-box followed by mix columns for a byte entering at row 0, rotated to the given row.
+*/
+constexpr uint32_t teEntry(const size_t index, const int row) {
+	return rotateColumn(packColumn(gfMultiply(sbox[index], 0x02), sbox[index], sbox[index], gfMultiply(sbox[index], 0x03)), row);
+}
+
+/**
+Decryption T-table entry: inverse s-box followed by inverse mix columns for a byte entering at row 0, rotated to the given row.
+*/
+constexpr uint32_t tdEntry(const size_t index, const int row) {
+	return rotateColumn(packColumn(gfMultiply(rsbox[index], 0x0e), gfMultiply(rsbox[index], 0x09), gfMultiply(rsbox[index], 0x0d), gfMultiply(rsbox[index], 0x0b)), row);
+}
+
+template<size_t... I>
+constexpr _saesTTable makeTe(std::index_sequence<I...>) {
+	return {{ {{ teEntry(I, 0)... }}, {{ teEntry(I, 1)... }}, {{ teEntry(I, 2)... }}, {{ teEntry(I, 3)... }} }};
+}
+
+template<size_t... I>
+constexpr _saesTTable makeTd(std::index_sequence<I...>) {
+	return {{ {{ tdEntry(I, 0)... }}, {{ tdEntry(I, 1)... }}, {{ tdEntry(I, 2)... }}, {{ tdEntry(I, 3)... }} }};
+}
+
+// encryption/decryption T-tables, 4 KB each, generated at compile time from sbox/rsbox
+constexpr _saesTTable te = makeTe(std::make_index_sequence<SAES_LOOKUP_TABLE_SIZE>());
+constexpr _saesTTable td = makeTd(std::make_index_sequence<SAES_LOOKUP_TABLE_SIZE>());
+
+#endif
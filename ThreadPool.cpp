@@ -0,0 +1,200 @@
+#include "ThreadPool.h"
+
+// pool and worker index of calling thread, pool is null if not a pool worker
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local unsigned int currentWorker = 0;
+
+// constructor
+ThreadPool::ThreadPool(unsigned int numThreads) :
+	nextQueue(0),
+	firstError(nullptr),
+	queuedTasks(0),
+	pendingTasks(0),
+	stopping(false)
+{
+
+	// size pool to machine
+	if (numThreads == 0)
+		numThreads = std::thread::hardware_concurrency();
+	if (numThreads == 0)
+		numThreads = 1;
+
+	// create queues before any worker can steal
+	for (unsigned int i = 0; i < numThreads; i++)
+		queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+
+	// start workers
+	for (unsigned int i = 0; i < numThreads; i++)
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+
+}
+
+// destructor
+ThreadPool::~ThreadPool() {
+
+	// signal stop
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		stopping = true;
+	}
+	taskAvailable.notify_all();
+
+	// join workers
+	for (std::thread& worker : workers)
+		worker.join();
+
+}
+
+/**
+Queue task. Tasks submitted from a worker go to that worker's own queue, others are spread round-robin.
+
+@param task (IN) Task to run.
+*/
+void ThreadPool::submit(std::function<void()> task) {
+
+	unsigned int queueIndex;
+
+	// select queue
+	if (currentPool == this)
+		queueIndex = currentWorker;
+	else
+		queueIndex = nextQueue++ % queues.size();
+
+	// count task before it can be popped
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		queuedTasks++;
+		pendingTasks++;
+	}
+
+	// push task
+	{
+		std::lock_guard<std::mutex> guard(queues[queueIndex]->lock);
+		queues[queueIndex]->tasks.push_back(std::move(task));
+	}
+	taskAvailable.notify_one();
+
+}
+
+/**
+Wait for all queued tasks to finish.
+
+@throw Rethrows the first exception raised by a task since the last call.
+*/
+void ThreadPool::wait() {
+
+	std::exception_ptr error = nullptr;
+
+	// wait for tasks
+	{
+		std::unique_lock<std::mutex> guard(stateLock);
+		tasksDone.wait(guard, [this]() { return pendingTasks == 0; });
+		std::swap(error, firstError);
+	}
+
+	// rethrow task error
+	if (error)
+		std::rethrow_exception(error);
+
+}
+
+/**
+Get number of worker threads.
+
+@return Number of worker threads.
+*/
+unsigned int ThreadPool::getNumThreads() const {
+	return (unsigned int)workers.size();
+}
+
+/**
+Worker thread body.
+
+@param workerIndex (IN) Index of worker and its queue.
+*/
+void ThreadPool::workerLoop(const unsigned int workerIndex) {
+
+	std::function<void()> task;
+
+	currentPool = this;
+	currentWorker = workerIndex;
+
+	while (true) {
+
+		// run next task
+		if (popTask(workerIndex, task)) {
+
+			std::exception_ptr error = nullptr;
+
+			try {
+				task();
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+			task = nullptr;
+
+			// mark done
+			{
+				std::lock_guard<std::mutex> guard(stateLock);
+				if (error && !firstError)
+					firstError = error;
+				if (--pendingTasks == 0)
+					tasksDone.notify_all();
+			}
+			continue;
+
+		}
+
+		// sleep until work arrives
+		std::unique_lock<std::mutex> guard(stateLock);
+		taskAvailable.wait(guard, [this]() { return stopping || queuedTasks > 0; });
+		if (stopping && queuedTasks == 0)
+			return;
+
+	}
+
+}
+
+/**
+Take newest task from own queue, otherwise steal oldest task from another queue.
+
+@param workerIndex (IN) Index of calling worker.
+@param task (OUT) Task taken.
+
+@return True if a task was taken.
+*/
+bool ThreadPool::popTask(const unsigned int workerIndex, std::function<void()>& task) {
+
+	size_t numQueues = queues.size();
+
+	for (size_t i = 0; i < numQueues; i++) {
+
+		WorkQueue& queue = *queues[(workerIndex + i) % numQueues];
+		std::lock_guard<std::mutex> guard(queue.lock);
+
+		if (queue.tasks.empty())
+			continue;
+
+		// own queue LIFO, victims FIFO
+		if (i == 0) {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+		}
+		else {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+		}
+
+		// uncount task
+		{
+			std::lock_guard<std::mutex> stateGuard(stateLock);
+			queuedTasks--;
+		}
+		return true;
+
+	}
+
+	return false;
+
+}
@@ -0,0 +1,61 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// work-stealing thread pool
+class ThreadPool {
+
+public:
+
+	// constructor
+	ThreadPool(unsigned int);
+
+	// destructor
+	~ThreadPool();
+
+	// queue task
+	void submit(std::function<void()>);
+
+	// wait for all queued tasks
+	void wait();
+
+	// get number of worker threads
+	unsigned int getNumThreads() const;
+
+private:
+
+	// per-worker task queue
+	struct WorkQueue {
+		std::mutex lock;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	// worker thread body
+	void workerLoop(const unsigned int);
+
+	// take task from own queue or steal from another
+	bool popTask(const unsigned int, std::function<void()>&);
+
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::vector<std::thread> workers;
+	std::mutex stateLock;
+	std::condition_variable taskAvailable;
+	std::condition_variable tasksDone;
+	std::atomic<unsigned int> nextQueue;
+	std::exception_ptr firstError;
+	size_t queuedTasks;
+	size_t pendingTasks;
+	bool stopping;
+
+};
+
+#endif
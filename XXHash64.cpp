@@ -0,0 +1,116 @@
+#include "XXHash64.h"
+#include <string.h>
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+// rotate left
+static uint64_t rotl64(const uint64_t value, const int bits) {
+	return (value << bits) | (value >> (64 - bits));
+}
+
+// load little-endian 64-bit word
+static uint64_t read64(const byte* in) {
+
+	uint64_t value = 0;
+	for (int i = 7; i >= 0; i--)
+		value = (value << 8) | in[i];
+	return value;
+
+}
+
+// load little-endian 32-bit word
+static uint32_t read32(const byte* in) {
+	return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+/**
+Hash data.
+
+@param data (IN) Data.
+@param len (IN) Bytes of data.
+@param seed (IN) Seed, selects an independent hash function.
+
+@return 64-bit hash.
+*/
+uint64_t XXHash64::hash(const byte* data, const _saes64 len, const uint64_t seed) {
+
+	const byte* end = data + len;
+	uint64_t h;
+
+	// four lanes over 32-byte stripes
+	if (len >= 32) {
+		uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+		uint64_t v2 = seed + XXH_PRIME64_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - XXH_PRIME64_1;
+		for (; end - data >= 32; data += 32) {
+			v1 = round(v1, read64(data));
+			v2 = round(v2, read64(data + 8));
+			v3 = round(v3, read64(data + 16));
+			v4 = round(v4, read64(data + 24));
+		}
+		h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		h = mergeRound(h, v1);
+		h = mergeRound(h, v2);
+		h = mergeRound(h, v3);
+		h = mergeRound(h, v4);
+	}
+	else
+		h = seed + XXH_PRIME64_5;
+	h += (uint64_t)len;
+
+	// remaining words and bytes
+	for (; end - data >= 8; data += 8)
+		h = (rotl64(h ^ round(0, read64(data)), 27) * XXH_PRIME64_1) + XXH_PRIME64_4;
+	if (end - data >= 4) {
+		h = (rotl64(h ^ ((uint64_t)read32(data) * XXH_PRIME64_1), 23) * XXH_PRIME64_2) + XXH_PRIME64_3;
+		data += 4;
+	}
+	for (; data < end; data++)
+		h = rotl64(h ^ ((uint64_t)*data * XXH_PRIME64_5), 11) * XXH_PRIME64_1;
+
+	// avalanche
+	h ^= h >> 33;
+	h *= XXH_PRIME64_2;
+	h ^= h >> 29;
+	h *= XXH_PRIME64_3;
+	h ^= h >> 32;
+
+	return h;
+
+}
+
+/**
+Mix one word into a lane.
+
+@param acc (IN) Lane.
+@param input (IN) Word.
+
+@return Lane.
+*/
+uint64_t XXHash64::round(uint64_t acc, const uint64_t input) {
+
+	acc += input * XXH_PRIME64_2;
+	acc = rotl64(acc, 31);
+	return acc * XXH_PRIME64_1;
+
+}
+
+/**
+Fold a lane into the converged hash.
+
+@param acc (IN) Hash.
+@param lane (IN) Lane.
+
+@return Hash.
+*/
+uint64_t XXHash64::mergeRound(uint64_t acc, const uint64_t lane) {
+
+	acc ^= round(0, lane);
+	return (acc * XXH_PRIME64_1) + XXH_PRIME64_4;
+
+}
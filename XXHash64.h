@@ -0,0 +1,31 @@
+#ifndef XXHASH64_H
+#define XXHASH64_H
+
+#ifdef __linux__
+#include <inttypes.h>
+#endif
+#include "SAESconstants.h"
+#include <stdint.h>
+
+// xxHash64 non-cryptographic hash.
+// Four independent 64-bit lanes consume 32 bytes per round, several bytes per cycle on any 64-bit CPU. Output matches
+// the reference XXH64() for the same seed.
+class XXHash64 {
+
+public:
+
+	// hash
+	static uint64_t hash(const byte*, const _saes64, const uint64_t);
+
+private:
+
+	// constructor
+	XXHash64();
+
+	// rounds
+	static uint64_t round(uint64_t, const uint64_t);
+	static uint64_t mergeRound(uint64_t, const uint64_t);
+
+};
+
+#endif